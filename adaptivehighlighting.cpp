@@ -0,0 +1,81 @@
+#include "adaptivehighlighting.h"
+
+void AdaptiveHighlighting::setEnabled(const bool enabled)
+{
+    adaptive = enabled;
+    calmWindows = 0;
+}
+
+bool AdaptiveHighlighting::update(const qint64 documentSize, const int64_t now)
+{
+    const auto elapsed = now - windowStart;
+    if (windowStart && elapsed < RATE_WINDOW_NS) {
+        return false;
+    }
+    // The first call only starts the window
+    currentRate = windowStart ? static_cast<qint64>(static_cast<double>(windowBytes) * 1e9 / static_cast<double>(elapsed)) : 0;
+    windowStart = now;
+    windowBytes = 0;
+
+    const auto previous = currentLevel;
+    if (!adaptive) {
+        currentLevel = Level::Full;
+        return currentLevel != previous;
+    }
+
+    if (const auto degraded = levelFor(documentSize, 100); degraded > currentLevel) {
+        calmWindows = 0;
+        currentLevel = degraded;
+        return true;
+    }
+
+    if (const auto recovered = levelFor(documentSize, RECOVERY_PERCENT); recovered < currentLevel) {
+        if (++calmWindows >= CALM_WINDOWS) {
+            calmWindows = 0;
+            currentLevel = recovered;
+            return true;
+        }
+    } else {
+        calmWindows = 0;
+    }
+    return false;
+}
+
+AdaptiveHighlighting::Level AdaptiveHighlighting::levelFor(const qint64 documentSize, const int percent) const
+{
+    const auto over = [percent](const qint64 value, const qint64 threshold) { return value > threshold / 100 * percent; };
+
+    if (over(currentRate, limits.plainRate) || over(documentSize, limits.plainDocumentSize)) {
+        return Level::Plain;
+    }
+    if (over(currentRate, limits.simpleRate) || over(documentSize, limits.simpleDocumentSize)) {
+        return Level::Simple;
+    }
+    return Level::Full;
+}
+
+QString AdaptiveHighlighting::modeName(const Level level)
+{
+    switch (level) {
+    case Level::Full:
+        return "Log File (advanced)";
+    case Level::Simple:
+        return "Log File (simple)";
+    case Level::Plain:
+    default:
+        return "None";
+    }
+}
+
+QString AdaptiveHighlighting::displayName(const Level level)
+{
+    switch (level) {
+    case Level::Full:
+        return "Full highlighting";
+    case Level::Simple:
+        return "Simple highlighting";
+    case Level::Plain:
+    default:
+        return "No highlighting";
+    }
+}
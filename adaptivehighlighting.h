@@ -0,0 +1,70 @@
+#ifndef ADAPTIVEHIGHLIGHTING_H
+#define ADAPTIVEHIGHLIGHTING_H
+
+#include <QString>
+
+#include <cstdint>
+
+// Picks how much highlighting a live document gets from the ingest rate and the document size.
+// KTextEditor highlights every line up to the one shown, so with the view following the end of a
+// fast growing document the full log highlighter ends up being a large share of the GUI thread.
+//
+// The rate is measured over windows of RATE_WINDOW_NS. Highlighting is reduced as soon as one
+// window is over a threshold. It only comes back once the rate and the size have stayed below
+// RECOVERY_PERCENT of the thresholds for CALM_WINDOWS windows in a row, so that bursty traffic
+// doesn't make it flip back and forth.
+class AdaptiveHighlighting {
+public:
+    // Ordered from the most to the least expensive
+    enum class Level {
+        Full,
+        Simple,
+        Plain
+    };
+
+    struct Thresholds {
+        // Bytes per second
+        qint64 simpleRate = 256 * 1024;
+        qint64 plainRate = 2 * 1024 * 1024;
+        // Bytes in the document
+        qint64 simpleDocumentSize = 64 * 1024 * 1024;
+        qint64 plainDocumentSize = 256 * 1024 * 1024;
+    };
+
+    void setEnabled(const bool enabled);
+    [[nodiscard]] bool isEnabled() const { return adaptive; }
+    void setThresholds(const Thresholds& newThresholds) { limits = newThresholds; }
+    [[nodiscard]] const Thresholds& thresholds() const { return limits; }
+
+    // Called with every chunk of live data
+    void record(const size_t bytes) { windowBytes += static_cast<qint64>(bytes); }
+    // Called periodically, `now` is LineTimestamps::now(). Returns true if the level changed.
+    bool update(const qint64 documentSize, const int64_t now);
+
+    [[nodiscard]] Level level() const { return currentLevel; }
+    // Bytes per second over the last complete window
+    [[nodiscard]] qint64 rate() const { return currentRate; }
+
+    // KSyntaxHighlighting definition for a level
+    [[nodiscard]] static QString modeName(const Level level);
+    // For the status bar
+    [[nodiscard]] static QString displayName(const Level level);
+
+private:
+    static inline constexpr int64_t RATE_WINDOW_NS = 1'000'000'000;
+    static inline constexpr int RECOVERY_PERCENT = 50;
+    static inline constexpr int CALM_WINDOWS = 5;
+
+    bool adaptive = true;
+    Thresholds limits {};
+    Level currentLevel = Level::Full;
+
+    qint64 windowBytes {};
+    int64_t windowStart {};
+    qint64 currentRate {};
+    int calmWindows {};
+
+    [[nodiscard]] Level levelFor(const qint64 documentSize, const int percent) const;
+};
+
+#endif // ADAPTIVEHIGHLIGHTING_H
@@ -0,0 +1,121 @@
+#include "archivedictionary.h"
+
+#include <zdict.h>
+
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Enough for any frame header. ZSTD_FRAMEHEADERSIZE_MAX is only in the experimental API.
+constexpr qint64 FRAME_HEADER_SIZE = 18;
+
+ZSTD_DDict* cachedDDict(const QString& path)
+{
+    using DDictPtr = std::unique_ptr<ZSTD_DDict, decltype(&ZSTD_freeDDict)>;
+    static QMutex mutex;
+    static std::map<QString, DDictPtr> cache;
+
+    QMutexLocker locker(&mutex);
+    if (const auto it = cache.find(path); it != cache.end()) {
+        return it->second.get();
+    }
+    const auto dictionary = ArchiveDictionary::load(path);
+    DDictPtr ddict(ZSTD_createDDict(dictionary.data().constData(), static_cast<size_t>(dictionary.data().size())), &ZSTD_freeDDict);
+    if (!ddict) {
+        throw std::runtime_error("Failed to create zstd dictionary");
+    }
+    return cache.emplace(path, std::move(ddict)).first->second.get();
+}
+
+}
+
+ArchiveDictionary ArchiveDictionary::train(const QByteArray& samples)
+{
+    // The trainer looks for what the samples have in common, whole lines make that easiest
+    std::vector<size_t> sampleSizes;
+    for (qsizetype start = 0; start < samples.size();) {
+        auto end = std::min(start + SAMPLE_SIZE, samples.size());
+        if (const auto newline = samples.indexOf('\n', end - 1); newline >= 0 && newline < start + 2 * SAMPLE_SIZE) {
+            end = newline + 1;
+        }
+        sampleSizes.push_back(static_cast<size_t>(end - start));
+        start = end;
+    }
+
+    const auto capacity = std::clamp(static_cast<size_t>(samples.size()) / SIZE_DIVISOR, MIN_SIZE, MAX_SIZE);
+    ArchiveDictionary dictionary;
+    dictionary.contents.resize(static_cast<qsizetype>(capacity));
+    const auto size = ZDICT_trainFromBuffer(dictionary.contents.data(), capacity, samples.constData(), sampleSizes.data(), static_cast<unsigned>(sampleSizes.size()));
+    if (ZDICT_isError(size)) {
+        throw std::runtime_error(std::string("Failed to train a dictionary: ") + ZDICT_getErrorName(size));
+    }
+    dictionary.contents.truncate(static_cast<qsizetype>(size));
+    dictionary.dictionaryId = ZDICT_getDictID(dictionary.contents.constData(), size);
+    return dictionary;
+}
+
+ArchiveDictionary ArchiveDictionary::load(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        throw std::runtime_error(QString("Failed to open %1: %2").arg(path, file.errorString()).toStdString());
+    }
+
+    ArchiveDictionary dictionary;
+    dictionary.contents = file.readAll();
+    // Raw content dictionaries have no ID, so archives compressed with them couldn't name theirs
+    dictionary.dictionaryId = ZDICT_getDictID(dictionary.contents.constData(), static_cast<size_t>(dictionary.contents.size()));
+    if (!dictionary.dictionaryId) {
+        throw std::runtime_error(QString("%1 is not a zstd dictionary").arg(path).toStdString());
+    }
+    return dictionary;
+}
+
+void ArchiveDictionary::save(const QString& directory) const
+{
+    const auto path = filePath(directory, dictionaryId);
+    if (QFile::exists(path)) {
+        return;
+    }
+
+    // Readers never see a partial dictionary
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(contents) != contents.size() || !file.commit()) {
+        throw std::runtime_error(QString("Failed to write %1: %2").arg(path, file.errorString()).toStdString());
+    }
+    qInfo() << "Saved dictionary" << path;
+}
+
+QString ArchiveDictionary::filePath(const QString& directory, const uint32_t id)
+{
+    return QString("%1/dictionary_%2.zdict").arg(directory).arg(id);
+}
+
+void ArchiveDictionary::attach(ZSTD_DCtx* ctx, const QString& archivePath)
+{
+    QFile file(archivePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        throw std::runtime_error(QString("Failed to open %1: %2").arg(archivePath, file.errorString()).toStdString());
+    }
+    const auto header = file.read(FRAME_HEADER_SIZE);
+
+    // 0 for frames without a dictionary, which returns the context to not using one
+    ZSTD_DDict* ddict {};
+    if (const auto id = ZSTD_getDictID_fromFrame(header.constData(), static_cast<size_t>(header.size()))) {
+        ddict = cachedDDict(filePath(QFileInfo(archivePath).absolutePath(), id));
+    }
+    if (const auto result = ZSTD_DCtx_refDDict(ctx, ddict); ZSTD_isError(result)) {
+        throw std::runtime_error(ZSTD_getErrorName(result));
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef ARCHIVEDICTIONARY_H
+#define ARCHIVEDICTIONARY_H
+
+#include <QByteArray>
+#include <QString>
+
+#include <zstd.h>
+
+#include <cstddef>
+#include <cstdint>
+
+// A zstd dictionary the archives of a session are compressed with. Logs of embedded devices
+// repeat the same prefixes, module names and messages over and over; the dictionary holds them so
+// that every frame can refer to them from its first byte on instead of learning them again. That
+// matters most for small archives and frequent rotations.
+//
+// Every frame records the ID of its dictionary, and the dictionary is stored as
+// "dictionary_<ID>.zdict" next to the archives. The readers look it up there through
+// `attach()`, which makes archives with and without a dictionary equally readable.
+class ArchiveDictionary {
+public:
+    // The dictionary reaches MAX_SIZE from about 7 MiB of samples, more only make the training
+    // slower. 16 MiB take about a second of the archive writer's time.
+    static inline constexpr int MAX_TRAINING_MIB = 16;
+    // A referenced dictionary compresses with the parameters it was digested with. Level 1 is the
+    // ZSTD_fast strategy the archives are written with.
+    static inline constexpr int COMPRESSION_LEVEL = 1;
+
+    // Trains a dictionary from `samples`, e.g. the first few MiB of a session, which are cut into
+    // pieces at line ends. Throws std::runtime_error if there isn't enough to train from.
+    [[nodiscard]] static ArchiveDictionary train(const QByteArray& samples);
+    // A dictionary trained by this class or by `zstd --train`. Throws std::runtime_error if the file
+    // can't be read or isn't a zstd dictionary.
+    [[nodiscard]] static ArchiveDictionary load(const QString& path);
+
+    [[nodiscard]] bool isEmpty() const { return dictionaryId == 0; }
+    [[nodiscard]] uint32_t id() const { return dictionaryId; }
+    [[nodiscard]] const QByteArray& data() const { return contents; }
+
+    // Writes the dictionary to `directory` unless it is already there. Throws std::runtime_error.
+    void save(const QString& directory) const;
+    [[nodiscard]] static QString filePath(const QString& directory, const uint32_t id);
+
+    // Sets up `ctx` to decompress the archive at `archivePath`: with its dictionary if its first
+    // frame needs one, without otherwise. Dictionaries are loaded once and kept for the rest of
+    // the process. Can be called from any thread. Throws std::runtime_error if the dictionary
+    // isn't next to the archive.
+    static void attach(ZSTD_DCtx* ctx, const QString& archivePath);
+
+private:
+    // zstd's own default
+    static inline constexpr size_t MAX_SIZE = 112 * 1024;
+    static inline constexpr size_t MIN_SIZE = 4 * 1024;
+    // The dictionary gets at most 1/SIZE_DIVISOR of the size of the samples, a larger one would
+    // mostly hold noise
+    static inline constexpr size_t SIZE_DIVISOR = 64;
+    // Samples are cut at the first line end after this many bytes
+    static inline constexpr qsizetype SAMPLE_SIZE = 4096;
+
+    QByteArray contents {};
+    uint32_t dictionaryId {};
+};
+
+#endif // ARCHIVEDICTIONARY_H
@@ -0,0 +1,235 @@
+#include "archiveindex.h"
+
+#include <QDebug>
+#include <QIODevice>
+#include <QtEndian>
+
+#include <algorithm>
+#include <utility>
+
+template <typename T>
+static void appendLittleEndian(QByteArray& out, const T value)
+{
+    const auto le = qToLittleEndian(value);
+    out.append(reinterpret_cast<const char*>(&le), sizeof(le));
+}
+
+template <typename T>
+static T readLittleEndian(const QByteArray& in, const qsizetype pos)
+{
+    return qFromLittleEndian<T>(in.constData() + pos);
+}
+
+void ArchiveIndex::addFrame(const qint64 compressedSize, const qint64 decompressedSize, const qint64 firstLine, const qint64 timestamp)
+{
+    Frame frame { 0, compressedSize, decompressedSize, 0, firstLine, timestamp };
+    if (!frameList.empty()) {
+        const auto& last = frameList.back();
+        frame.offset = last.offset + last.compressedSize;
+        frame.decompressedOffset = last.decompressedOffset + last.decompressedSize;
+    }
+    frameList.push_back(frame);
+}
+
+QByteArray ArchiveIndex::serializeLineIndex() const
+{
+    QByteArray out;
+    appendLittleEndian<uint32_t>(out, LINE_INDEX_MAGIC);
+    appendLittleEndian<uint32_t>(out, static_cast<uint32_t>(8 + frameList.size() * LINE_INDEX_ENTRY_SIZE));
+    appendLittleEndian<uint32_t>(out, LINE_INDEX_VERSION);
+    appendLittleEndian<uint32_t>(out, static_cast<uint32_t>(frameList.size()));
+    for (const auto& frame : frameList) {
+        appendLittleEndian<quint64>(out, static_cast<quint64>(frame.firstLine));
+        appendLittleEndian<qint64>(out, frame.timestamp);
+    }
+    return out;
+}
+
+QByteArray ArchiveIndex::serialize(const QByteArray& lineTimestamps, const QByteArray& searchIndex) const
+{
+    // The metadata frames are listed in the seek table as frames that decompress to nothing, so
+    // that the frames in the seek table stay contiguous.
+    QByteArray out;
+    std::vector<qsizetype> metadataSizes;
+    for (const auto& [magic, contents] : { std::pair { SEARCH_INDEX_MAGIC, &searchIndex }, std::pair { LINE_TIMESTAMPS_MAGIC, &lineTimestamps } }) {
+        if (contents->isEmpty()) {
+            continue;
+        }
+        appendLittleEndian<uint32_t>(out, magic);
+        appendLittleEndian<uint32_t>(out, static_cast<uint32_t>(contents->size()));
+        out.append(*contents);
+        metadataSizes.push_back(SKIPPABLE_HEADER_SIZE + contents->size());
+    }
+    const auto lineIndexFrame = serializeLineIndex();
+    out.append(lineIndexFrame);
+    metadataSizes.push_back(lineIndexFrame.size());
+
+    const auto entryCount = frameList.size() + metadataSizes.size();
+
+    appendLittleEndian<uint32_t>(out, SEEK_TABLE_MAGIC);
+    appendLittleEndian<uint32_t>(out, static_cast<uint32_t>(entryCount * 8 + SEEK_TABLE_FOOTER_SIZE));
+    for (const auto& frame : frameList) {
+        appendLittleEndian<uint32_t>(out, static_cast<uint32_t>(frame.compressedSize));
+        appendLittleEndian<uint32_t>(out, static_cast<uint32_t>(frame.decompressedSize));
+    }
+    for (const auto size : metadataSizes) {
+        appendLittleEndian<uint32_t>(out, static_cast<uint32_t>(size));
+        appendLittleEndian<uint32_t>(out, 0);
+    }
+
+    appendLittleEndian<uint32_t>(out, static_cast<uint32_t>(entryCount));
+    out.append(char {});
+    appendLittleEndian<uint32_t>(out, SEEKABLE_FOOTER_MAGIC);
+    return out;
+}
+
+ArchiveIndex ArchiveIndex::read(QIODevice& device)
+{
+    const auto fileSize = device.size();
+    if (fileSize < SKIPPABLE_HEADER_SIZE + SEEK_TABLE_FOOTER_SIZE) {
+        return {};
+    }
+
+    if (!device.seek(fileSize - SEEK_TABLE_FOOTER_SIZE)) {
+        return {};
+    }
+    const auto footer = device.read(SEEK_TABLE_FOOTER_SIZE);
+    if (footer.size() != SEEK_TABLE_FOOTER_SIZE || readLittleEndian<uint32_t>(footer, 5) != SEEKABLE_FOOTER_MAGIC) {
+        return {};
+    }
+
+    const auto entryCount = static_cast<qint64>(readLittleEndian<uint32_t>(footer, 0));
+    const qint64 entrySize = (static_cast<uint8_t>(footer[4]) & SEEK_TABLE_CHECKSUM_FLAG) ? 12 : 8;
+    const auto tableSize = SKIPPABLE_HEADER_SIZE + entryCount * entrySize + SEEK_TABLE_FOOTER_SIZE;
+    const auto tableOffset = fileSize - tableSize;
+    if (tableOffset < 0 || !device.seek(tableOffset)) {
+        qWarning() << "Invalid seek table size" << entryCount;
+        return {};
+    }
+
+    const auto table = device.read(tableSize - SEEK_TABLE_FOOTER_SIZE);
+    if (table.size() != tableSize - SEEK_TABLE_FOOTER_SIZE
+        || readLittleEndian<uint32_t>(table, 0) != SEEK_TABLE_MAGIC
+        || readLittleEndian<uint32_t>(table, 4) != tableSize - SKIPPABLE_HEADER_SIZE) {
+        qWarning() << "Invalid seek table";
+        return {};
+    }
+
+    ArchiveIndex index;
+    index.lineIndex = false;
+    for (qint64 i = 0; i < entryCount; i++) {
+        const auto pos = SKIPPABLE_HEADER_SIZE + i * entrySize;
+        index.addFrame(readLittleEndian<uint32_t>(table, pos), readLittleEndian<uint32_t>(table, pos + 4), -1, -1);
+    }
+
+    if (!index.frameList.empty()) {
+        const auto& last = index.frameList.back();
+        if (last.offset + last.compressedSize != tableOffset) {
+            qWarning() << "Seek table doesn't match the archive";
+            return {};
+        }
+    }
+
+    index.readLineIndex(device, tableOffset);
+    return index;
+}
+
+void ArchiveIndex::readLineIndex(QIODevice& device, const qint64 seekTableOffset)
+{
+    // If present the line index is the last entry in the seek table, right before the seek table
+    if (frameList.empty()) {
+        return;
+    }
+    const auto candidate = frameList.back();
+    if (candidate.decompressedSize != 0 || candidate.compressedSize < SKIPPABLE_HEADER_SIZE + 8
+        || candidate.offset + candidate.compressedSize != seekTableOffset || !device.seek(candidate.offset)) {
+        return;
+    }
+
+    const auto data = device.read(candidate.compressedSize);
+    if (data.size() != candidate.compressedSize
+        || readLittleEndian<uint32_t>(data, 0) != LINE_INDEX_MAGIC
+        || readLittleEndian<uint32_t>(data, 8) != LINE_INDEX_VERSION) {
+        return;
+    }
+    const auto dataFrames = static_cast<qint64>(readLittleEndian<uint32_t>(data, 12));
+    const auto totalFrames = static_cast<qint64>(frameList.size());
+    if (candidate.compressedSize != SKIPPABLE_HEADER_SIZE + 8 + dataFrames * LINE_INDEX_ENTRY_SIZE
+        || totalFrames < dataFrames + 1 || totalFrames > dataFrames + 3) {
+        return;
+    }
+
+    // The other metadata frames come right before the line index
+    qint64 timestampsOffset = -1, timestampsSize {}, searchOffset = -1, searchSize {};
+    for (auto i = dataFrames; i < totalFrames - 1; i++) {
+        const auto metadata = frameList[static_cast<size_t>(i)];
+        if (metadata.decompressedSize != 0 || metadata.compressedSize < SKIPPABLE_HEADER_SIZE || !device.seek(metadata.offset)) {
+            return;
+        }
+        const auto header = device.read(SKIPPABLE_HEADER_SIZE);
+        if (header.size() != SKIPPABLE_HEADER_SIZE) {
+            return;
+        }
+        const auto magic = readLittleEndian<uint32_t>(header, 0);
+        if (magic == LINE_TIMESTAMPS_MAGIC) {
+            timestampsOffset = metadata.offset + SKIPPABLE_HEADER_SIZE;
+            timestampsSize = metadata.compressedSize - SKIPPABLE_HEADER_SIZE;
+        } else if (magic == SEARCH_INDEX_MAGIC) {
+            searchOffset = metadata.offset + SKIPPABLE_HEADER_SIZE;
+            searchSize = metadata.compressedSize - SKIPPABLE_HEADER_SIZE;
+        } else {
+            return;
+        }
+    }
+    lineTimestampsOffset = timestampsOffset;
+    lineTimestampsSize = timestampsSize;
+    searchIndexOffset = searchOffset;
+    searchIndexSize = searchSize;
+
+    frameList.resize(static_cast<size_t>(dataFrames));
+    for (qint64 i = 0; i < dataFrames; i++) {
+        const auto pos = SKIPPABLE_HEADER_SIZE + 8 + i * LINE_INDEX_ENTRY_SIZE;
+        auto& frame = frameList[static_cast<size_t>(i)];
+        frame.firstLine = static_cast<qint64>(readLittleEndian<quint64>(data, pos));
+        frame.timestamp = readLittleEndian<qint64>(data, pos + 8);
+    }
+    lineIndex = true;
+}
+
+qsizetype ArchiveIndex::frameForLine(const qint64 line) const
+{
+    if (!lineIndex || line < 0) {
+        return -1;
+    }
+    const auto it = std::upper_bound(frameList.cbegin(), frameList.cend(), line, [](const qint64 l, const Frame& frame) {
+        return l < frame.firstLine;
+    });
+    return std::distance(frameList.cbegin(), it) - 1;
+}
+
+qsizetype ArchiveIndex::frameForOffset(const qint64 offset) const
+{
+    if (frameList.empty() || offset < 0 || offset >= frameList.back().decompressedOffset + frameList.back().decompressedSize) {
+        return -1;
+    }
+    const auto it = std::upper_bound(frameList.cbegin(), frameList.cend(), offset, [](const qint64 o, const Frame& frame) {
+        return o < frame.decompressedOffset;
+    });
+    return std::distance(frameList.cbegin(), it) - 1;
+}
+
+qsizetype ArchiveIndex::frameForTime(const qint64 timestamp) const
+{
+    if (!lineIndex) {
+        return -1;
+    }
+    // Frame timestamps are taken from a wall clock, so they are not guaranteed to be sorted.
+    // Pick the last frame that started at or before the requested time.
+    qsizetype result = -1;
+    for (qsizetype i = 0; i < static_cast<qsizetype>(frameList.size()); i++) {
+        if (frameList[static_cast<size_t>(i)].timestamp <= timestamp) {
+            result = i;
+        }
+    }
+    return result;
+}
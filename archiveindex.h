@@ -0,0 +1,87 @@
+#ifndef ARCHIVEINDEX_H
+#define ARCHIVEINDEX_H
+
+#include <QByteArray>
+
+#include <cstdint>
+#include <vector>
+
+class QIODevice;
+
+// Seek table of a long term run mode archive. Archives are written as a sequence of
+// independently decompressible zstd frames followed by two skippable frames, which the zstd CLI
+// and library skip over:
+//
+// - The line index: the first line number and the wall clock time of every frame.
+// - The seek table of the zstd seekable format (contrib/seekable_format in the zstd repository),
+//   which lists the compressed and decompressed size of every frame. It is always the last
+//   frame in the file so that it can be found from the end.
+//
+// Archives written from live data also have a skippable frame ahead of the line index with the
+// receive time of every line, see LineTimestamps::serialize(). Ahead of that there can be a
+// search index, see ArchiveSearchIndex.
+//
+// Archives without a line index, for example the ones written before it existed or by other
+// tools, can still be seeked by decompressed offset.
+class ArchiveIndex {
+public:
+    struct Frame {
+        qint64 offset {};
+        qint64 compressedSize {};
+        qint64 decompressedSize {};
+        qint64 decompressedOffset {};
+        // -1 if the archive has no line index
+        qint64 firstLine = -1;
+        // Milliseconds since the epoch, -1 if the archive has no line index
+        qint64 timestamp = -1;
+    };
+
+    void addFrame(const qint64 compressedSize, const qint64 decompressedSize, const qint64 firstLine, const qint64 timestamp);
+
+    // The skippable frames, to be appended after the last data frame. `lineTimestamps` and
+    // `searchIndex` are left out if empty.
+    [[nodiscard]] QByteArray serialize(const QByteArray& lineTimestamps = {}, const QByteArray& searchIndex = {}) const;
+    // Returns an empty index if the archive doesn't end in a seek table
+    [[nodiscard]] static ArchiveIndex read(QIODevice& device);
+
+    [[nodiscard]] const std::vector<Frame>& frames() const { return frameList; }
+    [[nodiscard]] bool isEmpty() const { return frameList.empty(); }
+    [[nodiscard]] bool hasLineIndex() const { return lineIndex; }
+    [[nodiscard]] bool hasLineTimestamps() const { return lineTimestampsOffset >= 0; }
+    // Where the serialized line timestamps are in the file, -1 if there are none
+    [[nodiscard]] qint64 lineTimestampsFileOffset() const { return lineTimestampsOffset; }
+    [[nodiscard]] qint64 lineTimestampsFileSize() const { return lineTimestampsSize; }
+    [[nodiscard]] bool hasSearchIndex() const { return searchIndexOffset >= 0; }
+    // Where the serialized ArchiveSearchIndex is in the file, -1 if there is none
+    [[nodiscard]] qint64 searchIndexFileOffset() const { return searchIndexOffset; }
+    [[nodiscard]] qint64 searchIndexFileSize() const { return searchIndexSize; }
+
+    // Index of the frame holding the given line, decompressed offset or time. -1 if there is none.
+    [[nodiscard]] qsizetype frameForLine(const qint64 line) const;
+    [[nodiscard]] qsizetype frameForOffset(const qint64 offset) const;
+    [[nodiscard]] qsizetype frameForTime(const qint64 timestamp) const;
+
+private:
+    static inline constexpr uint32_t SEEK_TABLE_MAGIC = 0x184D2A5E;
+    static inline constexpr uint32_t SEEKABLE_FOOTER_MAGIC = 0x8F92EAB1;
+    static inline constexpr uint8_t SEEK_TABLE_CHECKSUM_FLAG = 0x80;
+    static inline constexpr uint32_t LINE_INDEX_MAGIC = 0x184D2A59;
+    static inline constexpr uint32_t LINE_INDEX_VERSION = 1;
+    static inline constexpr uint32_t LINE_TIMESTAMPS_MAGIC = 0x184D2A5A;
+    static inline constexpr uint32_t SEARCH_INDEX_MAGIC = 0x184D2A5B;
+    static inline constexpr qint64 SKIPPABLE_HEADER_SIZE = 8;
+    static inline constexpr qint64 SEEK_TABLE_FOOTER_SIZE = 9;
+    static inline constexpr qint64 LINE_INDEX_ENTRY_SIZE = 16;
+
+    std::vector<Frame> frameList {};
+    bool lineIndex = true;
+    qint64 lineTimestampsOffset = -1;
+    qint64 lineTimestampsSize {};
+    qint64 searchIndexOffset = -1;
+    qint64 searchIndexSize {};
+
+    [[nodiscard]] QByteArray serializeLineIndex() const;
+    void readLineIndex(QIODevice& device, const qint64 seekTableOffset);
+};
+
+#endif // ARCHIVEINDEX_H
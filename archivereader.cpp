@@ -0,0 +1,224 @@
+#include "archivereader.h"
+#include "archivedictionary.h"
+
+#include <zstd.h>
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QtEndian>
+
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+ArchiveReader::ArchiveReader(const QStringList& archives, QObject* parent)
+    : QThread(parent)
+    , files(archives)
+{
+    setObjectName("ArchiveReader");
+}
+
+ArchiveReader::~ArchiveReader()
+{
+    {
+        QMutexLocker locker(&mutex);
+        cancelled = true;
+        stateChanged.wakeAll();
+    }
+    credits.release(MAX_CHUNKS_IN_FLIGHT);
+    wait();
+}
+
+bool ArchiveReader::isArchive(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    uint32_t magic {};
+    if (file.read(reinterpret_cast<char*>(&magic), sizeof(magic)) != sizeof(magic)) {
+        return false;
+    }
+    // zstd magic numbers are little endian. Skippable frames can be used for metadata ahead of
+    // the data.
+    magic = qFromLittleEndian(magic);
+    return magic == ZSTD_MAGICNUMBER || (magic & ZSTD_MAGIC_SKIPPABLE_MASK) == ZSTD_MAGIC_SKIPPABLE_START;
+}
+
+QStringList ArchiveReader::archivesInDirectory(const QString& directory)
+{
+    // The names start with an ISO date followed by a zero padded counter, so sorting by name
+    // sorts them in the order they were written.
+    QStringList paths;
+    const QDir dir(directory);
+    for (const auto& name : dir.entryList({ "*.txt.zst" }, QDir::Files, QDir::Name)) {
+        paths.append(dir.filePath(name));
+    }
+    return paths;
+}
+
+void ArchiveReader::chunkConsumed(const int count)
+{
+    credits.release(count);
+}
+
+void ArchiveReader::run()
+{
+    decoded.resize(static_cast<size_t>(files.size()));
+
+    // Decoders may work ahead by at most one file per core
+    const auto workerCount = std::min<qsizetype>(std::max(1, QThread::idealThreadCount()), files.size());
+    std::vector<std::thread> workers;
+    for (qsizetype i = 0; i < workerCount; i++) {
+        workers.emplace_back(&ArchiveReader::decodeFiles, this, workerCount);
+    }
+
+    for (qsizetype i = 0; i < files.size() && !cancelled; i++) {
+        while (true) {
+            QByteArray chunk;
+            QString error;
+            bool fileDone {};
+            {
+                QMutexLocker locker(&mutex);
+                auto& file = decoded[static_cast<size_t>(i)];
+                while (file.chunks.empty() && !file.done && !cancelled) {
+                    stateChanged.wait(&mutex);
+                }
+                if (cancelled) {
+                    break;
+                }
+                if (!file.chunks.empty()) {
+                    chunk = std::move(file.chunks.front());
+                    file.chunks.pop_front();
+                } else {
+                    fileDone = true;
+                    error = file.error;
+                    currentFile = i + 1;
+                }
+                stateChanged.wakeAll();
+            }
+
+            if (fileDone) {
+                if (!error.isEmpty()) {
+                    qWarning() << "Failed to read archive" << files[i] << error;
+                    emit errorOccurred(QString("%1: %2").arg(files[i], error));
+                }
+                break;
+            }
+
+            credits.acquire();
+            if (cancelled) {
+                break;
+            }
+            emit chunkDecoded(chunk);
+        }
+    }
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ArchiveReader::decodeFiles(const qsizetype lookahead)
+{
+    while (true) {
+        qsizetype index {};
+        {
+            QMutexLocker locker(&mutex);
+            while (!cancelled && nextFile < files.size() && nextFile >= currentFile + lookahead) {
+                stateChanged.wait(&mutex);
+            }
+            if (cancelled || nextFile >= files.size()) {
+                return;
+            }
+            index = nextFile++;
+        }
+
+        QString error;
+        try {
+            decodeFile(index);
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+
+        QMutexLocker locker(&mutex);
+        auto& file = decoded[static_cast<size_t>(index)];
+        file.error = error;
+        file.done = true;
+        stateChanged.wakeAll();
+    }
+}
+
+void ArchiveReader::decodeFile(const qsizetype index)
+{
+    QFile file(files[index]);
+    if (!file.open(QIODevice::ReadOnly)) {
+        throw std::runtime_error(file.errorString().toStdString());
+    }
+
+    const std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> ctx(ZSTD_createDCtx(), &ZSTD_freeDCtx);
+    if (!ctx) {
+        throw std::runtime_error("Failed to create zstd context");
+    }
+    ArchiveDictionary::attach(ctx.get(), files[index]);
+
+    std::vector<char> input(ZSTD_DStreamInSize());
+    QByteArray chunk(CHUNK_SIZE, Qt::Uninitialized);
+    size_t chunkUsed {};
+    size_t lastResult {};
+
+    while (!cancelled) {
+        const auto read = file.read(input.data(), static_cast<qint64>(input.size()));
+        if (read < 0) {
+            throw std::runtime_error(file.errorString().toStdString());
+        }
+        if (read == 0) {
+            break;
+        }
+
+        ZSTD_inBuffer in { input.data(), static_cast<size_t>(read), 0 };
+        while (true) {
+            ZSTD_outBuffer out { chunk.data(), static_cast<size_t>(chunk.size()), chunkUsed };
+            lastResult = ZSTD_decompressStream(ctx.get(), &out, &in);
+            if (ZSTD_isError(lastResult)) {
+                // Hand out what was decoded up to the corruption before reporting it
+                chunk.truncate(static_cast<qsizetype>(out.pos));
+                pushChunk(index, std::move(chunk));
+                throw std::runtime_error(ZSTD_getErrorName(lastResult));
+            }
+            chunkUsed = out.pos;
+
+            if (chunkUsed == out.size) {
+                pushChunk(index, std::move(chunk));
+                chunk = QByteArray(CHUNK_SIZE, Qt::Uninitialized);
+                chunkUsed = 0;
+            } else if (in.pos == in.size) {
+                // The decoder only stops short of filling the output once it has flushed everything
+                break;
+            }
+        }
+    }
+
+    chunk.truncate(static_cast<qsizetype>(chunkUsed));
+    pushChunk(index, std::move(chunk));
+
+    // An archive that was being streamed when the program died ends in the middle of a frame
+    if (lastResult != 0) {
+        throw std::runtime_error("Archive is truncated");
+    }
+}
+
+void ArchiveReader::pushChunk(const qsizetype index, QByteArray&& chunk)
+{
+    if (chunk.isEmpty()) {
+        return;
+    }
+    QMutexLocker locker(&mutex);
+    auto& file = decoded[static_cast<size_t>(index)];
+    while (!cancelled && file.chunks.size() >= MAX_BUFFERED_CHUNKS) {
+        stateChanged.wait(&mutex);
+    }
+    file.chunks.push_back(std::move(chunk));
+    stateChanged.wakeAll();
+}
@@ -0,0 +1,72 @@
+#ifndef ARCHIVEREADER_H
+#define ARCHIVEREADER_H
+
+#include <QByteArray>
+#include <QMutex>
+#include <QSemaphore>
+#include <QStringList>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <atomic>
+#include <deque>
+#include <vector>
+
+// Decompresses long term run mode archives and hands the text out in order, one chunk at a time,
+// through `chunkDecoded()`. Several archives are decoded in parallel on worker threads; this
+// thread only puts the chunks back in file order.
+//
+// Only MAX_CHUNKS_IN_FLIGHT chunks are handed out until the receiver calls `chunkConsumed()`, so
+// the decoders never run more than a few chunks ahead of the document.
+class ArchiveReader : public QThread {
+    Q_OBJECT
+
+public:
+    explicit ArchiveReader(const QStringList& archives, QObject* parent = nullptr);
+    // Cancels decoding and waits for the workers
+    ~ArchiveReader();
+
+    // True if the file starts with a zstd frame
+    [[nodiscard]] static bool isArchive(const QString& path);
+    // All *.txt.zst files in the directory, oldest first
+    [[nodiscard]] static QStringList archivesInDirectory(const QString& directory);
+
+    // Can be called from any thread
+    void chunkConsumed(const int count = 1);
+
+signals:
+    void chunkDecoded(const QByteArray& data);
+    void errorOccurred(const QString& msg);
+
+protected:
+    void run() override;
+
+private:
+    struct DecodedFile {
+        std::deque<QByteArray> chunks {};
+        QString error {};
+        bool done {};
+    };
+
+    static inline constexpr qsizetype CHUNK_SIZE = 1024 * 1024;
+    static inline constexpr int MAX_CHUNKS_IN_FLIGHT = 4;
+    // How many decoded chunks a file that isn't being handed out yet may hold
+    static inline constexpr size_t MAX_BUFFERED_CHUNKS = 64;
+
+    const QStringList files;
+    QSemaphore credits { MAX_CHUNKS_IN_FLIGHT };
+    std::atomic_bool cancelled {};
+
+    // Protected by `mutex`
+    QMutex mutex;
+    QWaitCondition stateChanged;
+    std::vector<DecodedFile> decoded {};
+    qsizetype nextFile {};
+    qsizetype currentFile {};
+
+    void decodeFiles(const qsizetype lookahead);
+    void decodeFile(const qsizetype index);
+    void pushChunk(const qsizetype index, QByteArray&& chunk);
+};
+
+#endif // ARCHIVEREADER_H
@@ -0,0 +1,246 @@
+#include "archivesearch.h"
+#include "archivedictionary.h"
+#include "archiveindex.h"
+#include "archivesearchindex.h"
+#include "regexmatcher.h"
+
+#include <QDebug>
+#include <QFile>
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+static char foldCase(const char c)
+{
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
+}
+
+ArchiveSearch::ArchiveSearch(const QStringList& archives, const Query& query, QObject* parent)
+    : QThread(parent)
+    , files(archives)
+    , searchQuery(query)
+    , needle(query.text)
+{
+    setObjectName("ArchiveSearch");
+
+    if (searchQuery.text.isEmpty()) {
+        throw std::invalid_argument("Nothing to search for");
+    }
+    if (searchQuery.regex) {
+        // Only to find errors early, every archive gets its own matcher
+        RegexMatcher matcher;
+        matcher.setPatterns({ searchQuery.text.toStdString() });
+    } else if (!searchQuery.caseSensitive) {
+        std::transform(needle.cbegin(), needle.cend(), needle.begin(), foldCase);
+    }
+}
+
+ArchiveSearch::~ArchiveSearch()
+{
+    cancel();
+    wait();
+}
+
+void ArchiveSearch::cancel()
+{
+    cancelled = true;
+}
+
+void ArchiveSearch::run()
+{
+    const auto workerCount = std::min<qsizetype>(std::max(1, QThread::idealThreadCount()), files.size());
+    std::vector<std::thread> workers;
+    for (qsizetype i = 0; i < workerCount; i++) {
+        workers.emplace_back(&ArchiveSearch::searchFiles, this);
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ArchiveSearch::searchFiles()
+{
+    const std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> ctx(ZSTD_createDCtx(), &ZSTD_freeDCtx);
+    if (!ctx) {
+        emit errorOccurred("Failed to create zstd context");
+        return;
+    }
+
+    while (!cancelled) {
+        const auto index = nextFile++;
+        if (index >= files.size()) {
+            return;
+        }
+
+        const auto& path = files[index];
+        try {
+            if (!searchFile(path, ctx.get())) {
+                skippedFiles++;
+            }
+        } catch (const std::exception& e) {
+            qWarning() << "Failed to search" << path << e.what();
+            emit errorOccurred(QString("%1: %2").arg(path, e.what()));
+        }
+        emit progress(++searchedFiles, skippedFiles, static_cast<int>(files.size()));
+    }
+}
+
+bool ArchiveSearch::isRuledOut(QIODevice& file) const
+{
+    const auto index = ArchiveIndex::read(file);
+    if (!index.hasSearchIndex() || !file.seek(index.searchIndexFileOffset())) {
+        return false;
+    }
+    const auto searchIndex = ArchiveSearchIndex::deserialize(file.read(index.searchIndexFileSize()));
+    if (!searchIndex.isValid()) {
+        return false;
+    }
+    return !searchIndex.overlaps(searchQuery.from, searchQuery.to) || (!searchQuery.regex && !searchIndex.mayContain(searchQuery.text));
+}
+
+bool ArchiveSearch::searchFile(const QString& path, ZSTD_DCtx* ctx)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        throw std::runtime_error(file.errorString().toStdString());
+    }
+    if (isRuledOut(file)) {
+        return false;
+    }
+    if (!file.seek(0)) {
+        throw std::runtime_error(file.errorString().toStdString());
+    }
+
+    RegexMatcher matcher;
+    if (searchQuery.regex) {
+        matcher.setPatterns({ searchQuery.text.toStdString() });
+    }
+    const std::boyer_moore_horspool_searcher searcher(needle.cbegin(), needle.cend());
+
+    // Decompressed text that hasn't been searched yet. It always starts at the beginning of line
+    // number `line`.
+    QByteArray pending;
+    QByteArray folded;
+    qint64 line {};
+    QList<Match> batch;
+
+    const auto flushBatch = [&]() {
+        if (!batch.isEmpty()) {
+            emit matchesFound(batch);
+            batch.clear();
+        }
+    };
+
+    // Searches pending[0, end), which has to end at a line end unless the line is too long, and
+    // drops it. Only the first match in a line is reported.
+    const auto searchLines = [&](const qsizetype end) {
+        const auto* data = pending.constData();
+        const auto* haystack = data;
+        if (!searchQuery.caseSensitive && !searchQuery.regex) {
+            folded.resize(end);
+            std::transform(data, data + end, folded.data(), foldCase);
+            haystack = folded.constData();
+        }
+
+        // Newlines in front of `counted` have been added to `line`
+        qsizetype counted {};
+        const auto report = [&](const qsizetype pos) -> qsizetype {
+            const auto* newline = static_cast<const char*>(memchr(data + pos, '\n', static_cast<size_t>(end - pos)));
+            const qsizetype lineEnd = newline ? newline - data : end;
+            const auto* previous = static_cast<const char*>(memrchr(data, '\n', static_cast<size_t>(pos)));
+            const qsizetype lineStart = previous ? previous - data + 1 : 0;
+            line += std::count(data + counted, data + lineStart, '\n');
+            counted = lineStart;
+
+            if (matchCount++ >= MAX_MATCHES) {
+                cancelled = true;
+                return end;
+            }
+            batch.append(Match { path, line, QByteArray(data + lineStart, std::min(lineEnd - lineStart, MAX_MATCH_LENGTH)) });
+            if (batch.size() >= MATCH_BATCH_SIZE) {
+                flushBatch();
+            }
+            return lineEnd;
+        };
+
+        if (searchQuery.regex) {
+            qsizetype nextLine {};
+            matcher.scan(data, static_cast<size_t>(end), [&](const size_t, const size_t pos) {
+                if (static_cast<qsizetype>(pos) >= nextLine && !cancelled) {
+                    nextLine = report(static_cast<qsizetype>(pos)) + 1;
+                }
+            });
+        } else {
+            qsizetype pos {};
+            while (pos < end && !cancelled) {
+                const auto* found = std::search(haystack + pos, haystack + end, searcher);
+                if (found == haystack + end) {
+                    break;
+                }
+                pos = report(found - haystack) + 1;
+            }
+        }
+
+        line += std::count(data + counted, data + end, '\n');
+        pending.remove(0, end);
+    };
+
+    std::vector<char> input(ZSTD_DStreamInSize());
+    if (const auto result = ZSTD_DCtx_reset(ctx, ZSTD_reset_session_only); ZSTD_isError(result)) {
+        throw std::runtime_error(ZSTD_getErrorName(result));
+    }
+    ArchiveDictionary::attach(ctx, path);
+    size_t lastResult {};
+
+    while (!cancelled) {
+        const auto read = file.read(input.data(), static_cast<qint64>(input.size()));
+        if (read < 0) {
+            throw std::runtime_error(file.errorString().toStdString());
+        }
+        if (read == 0) {
+            break;
+        }
+
+        ZSTD_inBuffer in { input.data(), static_cast<size_t>(read), 0 };
+        while (!cancelled) {
+            const auto used = pending.size();
+            pending.resize(used + CHUNK_SIZE);
+            ZSTD_outBuffer out { pending.data() + used, static_cast<size_t>(CHUNK_SIZE), 0 };
+            lastResult = ZSTD_decompressStream(ctx, &out, &in);
+            pending.resize(used + static_cast<qsizetype>(out.pos));
+            if (ZSTD_isError(lastResult)) {
+                // Report what was decoded up to the corruption before the error
+                searchLines(pending.size());
+                flushBatch();
+                throw std::runtime_error(ZSTD_getErrorName(lastResult));
+            }
+
+            if (const auto* newline = static_cast<const char*>(memrchr(pending.constData(), '\n', static_cast<size_t>(pending.size())))) {
+                searchLines(newline - pending.constData() + 1);
+            } else if (pending.size() > MAX_LINE_LENGTH) {
+                searchLines(pending.size());
+            }
+
+            // The decoder only stops short of filling the output once it has flushed everything
+            if (out.pos < out.size && in.pos == in.size) {
+                break;
+            }
+        }
+    }
+
+    if (!cancelled) {
+        searchLines(pending.size());
+    }
+    flushBatch();
+
+    // An archive that was being streamed when the program died ends in the middle of a frame
+    if (!cancelled && lastResult != 0) {
+        throw std::runtime_error("Archive is truncated");
+    }
+    return true;
+}
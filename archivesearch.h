@@ -0,0 +1,84 @@
+#ifndef ARCHIVESEARCH_H
+#define ARCHIVESEARCH_H
+
+#include <QByteArray>
+#include <QList>
+#include <QStringList>
+#include <QThread>
+
+#include <zstd.h>
+
+#include <atomic>
+
+// Searches long term run mode archives for a string or a regular expression. Archives whose
+// search index (see ArchiveSearchIndex) rules out the string or the time range are skipped without
+// being decompressed. The rest are decompressed in parallel, one archive per core, and scanned
+// line by line. Matches are handed out in batches through `matchesFound()` as they are found, so
+// they are only in order within one archive.
+//
+// Regular expressions can't be checked against the index, they only skip archives by time.
+class ArchiveSearch : public QThread {
+    Q_OBJECT
+
+public:
+    struct Query {
+        QByteArray text {};
+        bool caseSensitive {};
+        bool regex {};
+        // Milliseconds since the epoch, -1 for an open end. Only selects archives, the lines of an
+        // archive that is searched are all reported.
+        qint64 from = -1;
+        qint64 to = -1;
+    };
+
+    struct Match {
+        QString archive {};
+        // Zero based line number within the archive
+        qint64 line {};
+        // At most MAX_MATCH_LENGTH bytes of the line
+        QByteArray text {};
+    };
+
+    static inline constexpr qint64 MAX_MATCHES = 10000;
+
+    // Throws std::invalid_argument if the text is empty or the regular expression can't be parsed
+    ArchiveSearch(const QStringList& archives, const Query& query, QObject* parent = nullptr);
+    // Cancels the search and waits for the workers
+    ~ArchiveSearch();
+
+    // Can be called from any thread
+    void cancel();
+
+signals:
+    void matchesFound(const QList<ArchiveSearch::Match>& matches);
+    // `skipped` of the `searched` archives were ruled out by their index
+    void progress(const int searched, const int skipped, const int total);
+    void errorOccurred(const QString& msg);
+
+protected:
+    void run() override;
+
+private:
+    static inline constexpr qsizetype CHUNK_SIZE = 1024 * 1024;
+    // A line longer than this is searched in pieces, matches across the cuts are missed
+    static inline constexpr qsizetype MAX_LINE_LENGTH = 4 * CHUNK_SIZE;
+    static inline constexpr qsizetype MAX_MATCH_LENGTH = 1024;
+    static inline constexpr qsizetype MATCH_BATCH_SIZE = 256;
+
+    const QStringList files;
+    const Query searchQuery;
+    QByteArray needle {};
+
+    std::atomic_bool cancelled {};
+    std::atomic<int> nextFile {};
+    std::atomic<int> searchedFiles {};
+    std::atomic<int> skippedFiles {};
+    std::atomic<qint64> matchCount {};
+
+    void searchFiles();
+    // Returns false if the index ruled the archive out
+    bool searchFile(const QString& path, ZSTD_DCtx* ctx);
+    [[nodiscard]] bool isRuledOut(QIODevice& file) const;
+};
+
+#endif // ARCHIVESEARCH_H
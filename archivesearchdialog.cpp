@@ -0,0 +1,179 @@
+#include "archivesearchdialog.h"
+#include "archivereader.h"
+
+#include "ui_archivesearchdialog.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QFontDatabase>
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+ArchiveSearchDialog::ArchiveSearchDialog(QWidget* parent)
+    : QDialog(parent)
+    , ui(new Ui::ArchiveSearchDialog)
+{
+    ui->setupUi(this);
+    ui->resultsTreeWidget->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    ui->browseButton->setIcon(QIcon::fromTheme("folder-open"));
+
+    const auto now = QDateTime::currentDateTime();
+    ui->fromDateTimeEdit->setDateTime(now.addDays(-1));
+    ui->toDateTimeEdit->setDateTime(now);
+
+    connect(ui->browseButton, &QToolButton::clicked, this, &ArchiveSearchDialog::onBrowseButton);
+    connect(ui->searchButton, &QPushButton::clicked, this, &ArchiveSearchDialog::onSearchButton);
+    connect(ui->queryLineEdit, &QLineEdit::returnPressed, this, &ArchiveSearchDialog::onSearchButton);
+    connect(ui->resultsTreeWidget, &QTreeWidget::itemActivated, this, &ArchiveSearchDialog::onItemActivated);
+    connect(ui->regexCheckBox, &QCheckBox::toggled, ui->caseSensitiveCheckBox, [this](const bool regex) {
+        // The regex matcher has no case insensitive mode
+        ui->caseSensitiveCheckBox->setEnabled(!regex);
+    });
+    connect(ui->timeRangeCheckBox, &QCheckBox::toggled, ui->fromDateTimeEdit, &QWidget::setEnabled);
+    connect(ui->timeRangeCheckBox, &QCheckBox::toggled, ui->toDateTimeEdit, &QWidget::setEnabled);
+}
+
+ArchiveSearchDialog::~ArchiveSearchDialog()
+{
+    stopSearch();
+    delete ui;
+}
+
+void ArchiveSearchDialog::setDirectory(const QString& directory)
+{
+    if (ui->directoryLineEdit->text().isEmpty()) {
+        ui->directoryLineEdit->setText(directory);
+    }
+}
+
+void ArchiveSearchDialog::onBrowseButton()
+{
+    const auto directory = QFileDialog::getExistingDirectory(this, tr("Archive directory"), ui->directoryLineEdit->text());
+    if (!directory.isEmpty()) {
+        ui->directoryLineEdit->setText(directory);
+    }
+}
+
+void ArchiveSearchDialog::stopSearch()
+{
+    // The destructor waits for the workers. Matches that are still queued are dropped because
+    // their sender is gone.
+    delete std::exchange(search, nullptr);
+}
+
+void ArchiveSearchDialog::onSearchButton()
+{
+    if (search) {
+        search->cancel();
+        return;
+    }
+
+    const auto directory = ui->directoryLineEdit->text();
+    const auto archives = ArchiveReader::archivesInDirectory(directory);
+    if (archives.isEmpty()) {
+        ui->statusLabel->setText(tr("No archives in %1").arg(directory));
+        return;
+    }
+
+    ArchiveSearch::Query query;
+    query.text = ui->queryLineEdit->text().toUtf8();
+    query.regex = ui->regexCheckBox->isChecked();
+    query.caseSensitive = query.regex || ui->caseSensitiveCheckBox->isChecked();
+    if (ui->timeRangeCheckBox->isChecked()) {
+        query.from = ui->fromDateTimeEdit->dateTime().toMSecsSinceEpoch();
+        query.to = ui->toDateTimeEdit->dateTime().toMSecsSinceEpoch();
+    }
+
+    try {
+        search = new ArchiveSearch(archives, query, this);
+    } catch (const std::invalid_argument& e) {
+        ui->statusLabel->setText(e.what());
+        return;
+    }
+    qInfo() << "Searching" << archives.size() << "archives for" << query.text;
+
+    ui->resultsTreeWidget->clear();
+    matchCount = 0;
+    searchedFiles = 0;
+    skippedFiles = 0;
+    totalFiles = static_cast<int>(archives.size());
+    ui->searchButton->setText(tr("Stop"));
+
+    connect(search, &ArchiveSearch::matchesFound, this, &ArchiveSearchDialog::handleMatches);
+    connect(search, &ArchiveSearch::progress, this, &ArchiveSearchDialog::handleProgress);
+    connect(search, &ArchiveSearch::errorOccurred, this, [this](const QString& msg) {
+        ui->errorLabel->setText(msg);
+    });
+    connect(search, &QThread::finished, this, &ArchiveSearchDialog::handleSearchFinished);
+    ui->errorLabel->clear();
+    searchTimer.start();
+    search->start();
+    updateStatus();
+}
+
+void ArchiveSearchDialog::handleMatches(const QList<ArchiveSearch::Match>& matches)
+{
+    if (sender() != search) {
+        return;
+    }
+
+    QList<QTreeWidgetItem*> items;
+    items.reserve(matches.size());
+    for (const auto& match : matches) {
+        auto* item = new QTreeWidgetItem({ QFileInfo(match.archive).fileName(), QString::number(match.line + 1), QString::fromUtf8(match.text) });
+        item->setData(0, Qt::UserRole, match.archive);
+        item->setData(1, Qt::UserRole, match.line);
+        item->setToolTip(0, match.archive);
+        items.append(item);
+    }
+    ui->resultsTreeWidget->addTopLevelItems(items);
+    matchCount += matches.size();
+    updateStatus();
+}
+
+void ArchiveSearchDialog::handleProgress(const int searched, const int skipped, const int total)
+{
+    if (sender() != search) {
+        return;
+    }
+    // Progress is reported from several workers, so it can arrive out of order
+    searchedFiles = std::max(searchedFiles, searched);
+    skippedFiles = std::max(skippedFiles, skipped);
+    totalFiles = total;
+    updateStatus();
+}
+
+void ArchiveSearchDialog::handleSearchFinished()
+{
+    if (sender() != search) {
+        return;
+    }
+    qInfo() << "Search done in" << searchTimer.elapsed() << "ms," << searchedFiles << "archives searched," << skippedFiles << "skipped," << matchCount << "matches";
+    updateStatus();
+    search->deleteLater();
+    search = nullptr;
+    ui->searchButton->setText(tr("Search"));
+}
+
+void ArchiveSearchDialog::updateStatus()
+{
+    auto status = tr("%1 of %2 archives searched, %3 skipped by their index, %4 matches in %5 s")
+                      .arg(searchedFiles)
+                      .arg(totalFiles)
+                      .arg(skippedFiles)
+                      .arg(matchCount)
+                      .arg(static_cast<double>(searchTimer.elapsed()) / 1000, 0, 'f', 1);
+    if (matchCount >= ArchiveSearch::MAX_MATCHES) {
+        status += tr(" (stopped at %1 matches)").arg(ArchiveSearch::MAX_MATCHES);
+    }
+    ui->statusLabel->setText(status);
+}
+
+void ArchiveSearchDialog::onItemActivated(QTreeWidgetItem* item)
+{
+    emit archiveActivated(item->data(0, Qt::UserRole).toString(), item->data(1, Qt::UserRole).toLongLong());
+}
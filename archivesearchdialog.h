@@ -0,0 +1,51 @@
+#ifndef ARCHIVESEARCHDIALOG_H
+#define ARCHIVESEARCHDIALOG_H
+
+#include "archivesearch.h"
+
+#include <QDialog>
+#include <QElapsedTimer>
+
+namespace Ui {
+class ArchiveSearchDialog;
+}
+
+class QTreeWidgetItem;
+
+// Searches an archive directory with ArchiveSearch and lists the matches as they come in.
+// Activating a match emits `archiveActivated()`.
+class ArchiveSearchDialog : public QDialog {
+    Q_OBJECT
+
+public:
+    explicit ArchiveSearchDialog(QWidget* parent = nullptr);
+    ~ArchiveSearchDialog();
+
+    void setDirectory(const QString& directory);
+
+signals:
+    // `line` is zero based
+    void archiveActivated(const QString& path, const qint64 line);
+
+private slots:
+    void onBrowseButton();
+    void onSearchButton();
+    void onItemActivated(QTreeWidgetItem* item);
+    void handleMatches(const QList<ArchiveSearch::Match>& matches);
+    void handleProgress(const int searched, const int skipped, const int total);
+    void handleSearchFinished();
+
+private:
+    Ui::ArchiveSearchDialog* ui;
+    ArchiveSearch* search {};
+    QElapsedTimer searchTimer;
+    qint64 matchCount {};
+    int searchedFiles {};
+    int skippedFiles {};
+    int totalFiles {};
+
+    void stopSearch();
+    void updateStatus();
+};
+
+#endif // ARCHIVESEARCHDIALOG_H
@@ -0,0 +1,134 @@
+#include "archivesearchindex.h"
+
+#include <QtEndian>
+
+#include <utility>
+
+static uint8_t foldCase(const uint8_t c)
+{
+    return (c >= 'A' && c <= 'Z') ? static_cast<uint8_t>(c + ('a' - 'A')) : c;
+}
+
+// Two filter positions per trigram, taken from different bits of one multiplicative hash. Both
+// are reduced to MAX_BITS first, folding only drops high bits from there.
+static std::pair<uint32_t, uint32_t> hashTrigram(const uint32_t trigram, const uint32_t bitsLog2)
+{
+    const auto hash = static_cast<uint64_t>(trigram) * 0x9E3779B97F4A7C15ull;
+    const auto mask = (uint32_t { 1 } << bitsLog2) - 1;
+    return { static_cast<uint32_t>(hash >> 40) & mask, static_cast<uint32_t>(hash >> 19) & mask };
+}
+
+ArchiveSearchIndex::ArchiveSearchIndex()
+    : bits((size_t { 1 } << MAX_BITS_LOG2) / 64)
+{
+}
+
+void ArchiveSearchIndex::add(const char* data, const size_t len)
+{
+    const auto* bytes = reinterpret_cast<const uint8_t*>(data);
+    auto w = window;
+    for (size_t i = 0; i < len; i++) {
+        w = ((w << 8) | static_cast<uint32_t>(foldCase(bytes[i]))) & 0xFFFFFF;
+        // Only the first two bytes of the archive don't complete a trigram
+        if (windowBytes < 2) {
+            windowBytes++;
+            continue;
+        }
+        set(w);
+    }
+    window = w;
+    addedBytes += static_cast<qint64>(len);
+}
+
+void ArchiveSearchIndex::setTimeRange(const qint64 firstTime, const qint64 lastTime)
+{
+    first = firstTime;
+    last = lastTime;
+}
+
+void ArchiveSearchIndex::set(const uint32_t trigram)
+{
+    const auto [a, b] = hashTrigram(trigram, bitsLog2);
+    bits[a / 64] |= uint64_t { 1 } << (a % 64);
+    bits[b / 64] |= uint64_t { 1 } << (b % 64);
+}
+
+bool ArchiveSearchIndex::test(const uint32_t trigram) const
+{
+    const auto [a, b] = hashTrigram(trigram, bitsLog2);
+    return (bits[a / 64] >> (a % 64) & 1) && (bits[b / 64] >> (b % 64) & 1);
+}
+
+QByteArray ArchiveSearchIndex::serialize() const
+{
+    // Folding in half ORs the upper half onto the lower one, which is the filter that would have
+    // been built with one bit less of the hash
+    auto folded = bits;
+    auto foldedLog2 = bitsLog2;
+    while (foldedLog2 > MIN_BITS_LOG2 && (qint64 { 1 } << (foldedLog2 - 1)) >= addedBytes * BITS_PER_BYTE) {
+        const auto half = folded.size() / 2;
+        for (size_t i = 0; i < half; i++) {
+            folded[i] |= folded[i + half];
+        }
+        folded.resize(half);
+        foldedLog2--;
+    }
+
+    QByteArray out;
+    out.reserve(HEADER_SIZE + static_cast<qsizetype>(folded.size() * sizeof(uint64_t)));
+    const auto append = [&out](const auto value) {
+        const auto le = qToLittleEndian(value);
+        out.append(reinterpret_cast<const char*>(&le), sizeof(le));
+    };
+    append(VERSION);
+    append(foldedLog2);
+    append(first);
+    append(last);
+    for (const auto word : folded) {
+        append(word);
+    }
+    return out;
+}
+
+ArchiveSearchIndex ArchiveSearchIndex::deserialize(const QByteArray& data)
+{
+    ArchiveSearchIndex index;
+    index.bits.clear();
+    if (data.size() < HEADER_SIZE || qFromLittleEndian<uint32_t>(data.constData()) != VERSION) {
+        return index;
+    }
+    const auto log2 = qFromLittleEndian<uint32_t>(data.constData() + 4);
+    if (log2 < 6 || log2 > MAX_BITS_LOG2) {
+        return index;
+    }
+    const auto words = (size_t { 1 } << log2) / 64;
+    if (static_cast<size_t>(data.size() - HEADER_SIZE) != words * sizeof(uint64_t)) {
+        return index;
+    }
+
+    index.bitsLog2 = log2;
+    index.first = qFromLittleEndian<qint64>(data.constData() + 8);
+    index.last = qFromLittleEndian<qint64>(data.constData() + 16);
+    index.bits.resize(words);
+    for (size_t i = 0; i < words; i++) {
+        index.bits[i] = qFromLittleEndian<quint64>(data.constData() + HEADER_SIZE + static_cast<qsizetype>(i * sizeof(uint64_t)));
+    }
+    return index;
+}
+
+bool ArchiveSearchIndex::mayContain(const QByteArray& text) const
+{
+    uint32_t w {};
+    for (qsizetype i = 0; i < text.size(); i++) {
+        w = ((w << 8) | static_cast<uint32_t>(foldCase(static_cast<uint8_t>(text[i])))) & 0xFFFFFF;
+        if (i >= 2 && !test(w)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ArchiveSearchIndex::overlaps(const qint64 from, const qint64 to) const
+{
+    return (to < 0 || first < 0 || first <= to) && (from < 0 || last < 0 || last >= from);
+}
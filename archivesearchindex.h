@@ -0,0 +1,62 @@
+#ifndef ARCHIVESEARCHINDEX_H
+#define ARCHIVESEARCHINDEX_H
+
+#include <QByteArray>
+
+#include <cstdint>
+#include <vector>
+
+// Summary of an archive's text that lets a search skip archives without decompressing them: a
+// Bloom filter over every three byte sequence in the text, with ASCII letters folded to lower case,
+// and the time range the archive covers. A string can only be in the archive if all of its
+// trigrams are in the filter. False positives only cost a decompression.
+//
+// The filter is built at MAX_BITS and folded in half when it is serialized until it is no larger
+// than the amount of text needs, so a small archive gets a small index.
+class ArchiveSearchIndex {
+public:
+    ArchiveSearchIndex();
+
+    // Adds text. Trigrams spanning two calls are included.
+    void add(const char* data, const size_t len);
+    // Milliseconds since the epoch, -1 if unknown
+    void setTimeRange(const qint64 first, const qint64 last);
+
+    [[nodiscard]] QByteArray serialize() const;
+    // Returns an invalid index if the data is malformed or from a newer version
+    [[nodiscard]] static ArchiveSearchIndex deserialize(const QByteArray& data);
+
+    [[nodiscard]] bool isValid() const { return !bits.empty(); }
+    // False only if `text` can't be anywhere in the archive, regardless of case. Always true for
+    // text shorter than a trigram.
+    [[nodiscard]] bool mayContain(const QByteArray& text) const;
+    // False only if the archive covers no part of [from, to]. -1 for an open end.
+    [[nodiscard]] bool overlaps(const qint64 from, const qint64 to) const;
+
+    [[nodiscard]] qint64 firstTimestamp() const { return first; }
+    [[nodiscard]] qint64 lastTimestamp() const { return last; }
+
+private:
+    static inline constexpr uint32_t VERSION = 1;
+    static inline constexpr uint32_t MAX_BITS_LOG2 = 21;
+    static inline constexpr uint32_t MIN_BITS_LOG2 = 12;
+    // At least this many filter bits per byte of text before folding stops. Logs repeat a lot, so
+    // there are far fewer distinct trigrams than bytes.
+    static inline constexpr qint64 BITS_PER_BYTE = 4;
+    static inline constexpr qsizetype HEADER_SIZE = 24;
+
+    std::vector<uint64_t> bits {};
+    uint32_t bitsLog2 = MAX_BITS_LOG2;
+    qint64 first = -1;
+    qint64 last = -1;
+
+    // Rolling state of add()
+    uint32_t window {};
+    size_t windowBytes {};
+    qint64 addedBytes {};
+
+    void set(const uint32_t trigram);
+    [[nodiscard]] bool test(const uint32_t trigram) const;
+};
+
+#endif // ARCHIVESEARCHINDEX_H
@@ -0,0 +1,594 @@
+#include "archivewriter.h"
+#include "stats.h"
+
+#include <QDebug>
+#include <QDeadlineTimer>
+#include <QElapsedTimer>
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+ArchiveWriter::ArchiveWriter(QObject* parent)
+    : QThread(parent)
+{
+    setObjectName("ArchiveWriter");
+}
+
+ArchiveWriter::~ArchiveWriter()
+{
+    {
+        QMutexLocker locker(&mutex);
+        stopping = true;
+        jobAvailable.wakeAll();
+    }
+    wait();
+
+    ZSTD_freeCCtx(zstdCtx);
+    zstdCtx = nullptr;
+    ZSTD_freeCCtx(streamCtx);
+    streamCtx = nullptr;
+    ZSTD_freeCDict(zstdCDict);
+    zstdCDict = nullptr;
+    ZSTD_freeCDict(streamCDict);
+    streamCDict = nullptr;
+}
+
+bool ArchiveWriter::submit(const QString& directory, const QByteArray& contents, const int counter, const QByteArray& lineTimestamps)
+{
+    QMutexLocker locker(&mutex);
+    if (queue.size() >= MAX_QUEUED_JOBS) {
+        qWarning() << "Archive queue full, not accepting" << contents.size() << "bytes";
+        return false;
+    }
+    queue.push_back({ directory, contents, counter, QDateTime::currentDateTime(), lineTimestamps });
+    jobAvailable.wakeOne();
+    return true;
+}
+
+void ArchiveWriter::startStream(const QString& directory)
+{
+    QMutexLocker locker(&mutex);
+    streamDirectory = directory;
+    streamStopRequested = false;
+}
+
+void ArchiveWriter::append(const char* data, const size_t len, const std::vector<int64_t>& lineTimestamps)
+{
+    QMutexLocker locker(&mutex);
+    if (streamDirectory.isEmpty()) {
+        return;
+    }
+    streamPending.append(data, static_cast<qsizetype>(len));
+    streamPendingTimestamps.insert(streamPendingTimestamps.end(), lineTimestamps.cbegin(), lineTimestamps.cend());
+    Stats::instance().archiveBacklog.set(static_cast<uint64_t>(streamPending.size()));
+
+    if (streamPending.size() > STREAM_BACKLOG_WARNING && !streamBacklogWarned) {
+        streamBacklogWarned = true;
+        qWarning() << "Archive stream backlog:" << streamPending.size();
+    }
+    jobAvailable.wakeOne();
+}
+
+void ArchiveWriter::rotate()
+{
+    QMutexLocker locker(&mutex);
+    streamRotateRequested = true;
+    jobAvailable.wakeOne();
+}
+
+void ArchiveWriter::stopStream()
+{
+    QMutexLocker locker(&mutex);
+    streamDirectory.clear();
+    streamStopRequested = true;
+    jobAvailable.wakeOne();
+}
+
+void ArchiveWriter::setDictionary(const ArchiveDictionary& newDictionary)
+{
+    QMutexLocker locker(&mutex);
+    dictionary = newDictionary;
+    dictionaryTrainingBytes = 0;
+}
+
+void ArchiveWriter::trainDictionary(const size_t sampleBytes)
+{
+    QMutexLocker locker(&mutex);
+    dictionary = {};
+    // The training runs on the worker thread and holds up the archives meanwhile
+    dictionaryTrainingBytes = std::min(sampleBytes, static_cast<size_t>(ArchiveDictionary::MAX_TRAINING_MIB) * 1024 * 1024);
+}
+
+void ArchiveWriter::run()
+{
+    QDeadlineTimer flushDeadline(QDeadlineTimer::Forever);
+
+    while (true) {
+        Job job;
+        bool hasJob {}, rotateStream {}, stopStream {}, exiting {};
+        {
+            QMutexLocker locker(&mutex);
+            // A failing stream waits for its retry
+            const auto streamReady = [this]() { return !streamPending.isEmpty() && streamRetryDeadline.hasExpired(); };
+            while (queue.empty() && !streamReady() && !streamRotateRequested && !streamStopRequested && !stopping) {
+                const auto deadline = streamPending.isEmpty() || flushDeadline < streamRetryDeadline ? flushDeadline : streamRetryDeadline;
+                if (!jobAvailable.wait(&mutex, deadline)) {
+                    break;
+                }
+            }
+
+            if (!queue.empty()) {
+                job = std::move(queue.front());
+                queue.pop_front();
+                hasJob = true;
+            }
+
+            // Swap instead of copying so that both buffers keep their capacity
+            streamWork.resize(0);
+            streamWorkTimestamps.clear();
+            if (streamRetryDeadline.hasExpired() || stopping) {
+                std::swap(streamWork, streamPending);
+                std::swap(streamWorkTimestamps, streamPendingTimestamps);
+            }
+            if (!streamWork.isEmpty()) {
+                Stats::instance().archiveBacklog.set(0);
+            }
+            if (!streamWork.isEmpty() && streamFileDirectory.isEmpty()) {
+                streamFileDirectory = streamDirectory;
+            }
+            streamBacklogWarned = false;
+
+            if (trainingTarget != dictionaryTrainingBytes) {
+                trainingTarget = dictionaryTrainingBytes;
+                trainingSamples.clear();
+            }
+
+            rotateStream = std::exchange(streamRotateRequested, false);
+            stopStream = std::exchange(streamStopRequested, false);
+
+            // Drain the queue before honouring a stop request so that no data is lost on exit
+            exiting = stopping && queue.empty() && !hasJob && streamWork.isEmpty();
+        }
+
+        if (hasJob) {
+            try {
+                writeCompressedFile(job);
+            } catch (const std::exception& e) {
+                qCritical() << "Failed to write archive:" << e.what();
+                emit errorOccurred(e.what());
+            }
+        }
+
+        // Set once the batch is in the file, after that it must not be written again
+        bool streamWorkWritten = streamWork.isEmpty();
+        try {
+            if (!streamWork.isEmpty()) {
+                streamCompress(streamWork);
+                streamWorkWritten = true;
+                if (flushDeadline.isForever()) {
+                    flushDeadline.setRemainingTime(STREAM_FLUSH_INTERVAL_MS);
+                }
+            }
+
+            if (rotateStream || stopStream || exiting) {
+                streamClose();
+                flushDeadline = QDeadlineTimer(QDeadlineTimer::Forever);
+            } else if (flushDeadline.hasExpired()) {
+                streamFlush();
+                flushDeadline = QDeadlineTimer(QDeadlineTimer::Forever);
+            }
+
+            if (streamRetryMs && !streamWork.isEmpty()) {
+                qInfo() << "Archive stream recovered";
+                streamRetryMs = 0;
+            }
+        } catch (const std::exception& e) {
+            // Start over with a new file rather than appending to a broken frame
+            streamFile.reset();
+            streamDirty = false;
+            flushDeadline = QDeadlineTimer(QDeadlineTimer::Forever);
+            if (!streamWorkWritten) {
+                retainStreamWork(e.what());
+            } else {
+                qCritical() << "Failed to write archive:" << e.what();
+                emit errorOccurred(e.what());
+            }
+        }
+
+        if (exiting) {
+            return;
+        }
+    }
+}
+
+void ArchiveWriter::retainStreamWork(const QString& error)
+{
+    // Reported once when the stream starts failing rather than with every retry
+    const bool firstFailure = !streamRetryMs;
+    streamRetryMs = firstFailure ? STREAM_RETRY_MIN_MS : std::min(2 * streamRetryMs, STREAM_RETRY_MAX_MS);
+    streamRetryDeadline.setRemainingTime(streamRetryMs);
+
+    qsizetype dropped {};
+    {
+        QMutexLocker locker(&mutex);
+        if (stopping) {
+            // Nothing is retried on exit
+            dropped = streamWork.size();
+        } else if (streamWork.size() + streamPending.size() > STREAM_MAX_RETAINED) {
+            dropped = streamWork.size();
+        } else {
+            streamPending.prepend(streamWork);
+            streamPendingTimestamps.insert(streamPendingTimestamps.begin(), streamWorkTimestamps.cbegin(), streamWorkTimestamps.cend());
+            Stats::instance().archiveBacklog.set(static_cast<uint64_t>(streamPending.size()));
+        }
+    }
+
+    if (dropped) {
+        const auto msg = QString("%1, %2 bytes lost").arg(error).arg(dropped);
+        qCritical() << "Failed to write archive:" << msg;
+        emit errorOccurred(msg);
+    } else if (firstFailure) {
+        const auto msg = QString("%1, retrying").arg(error);
+        qCritical() << "Failed to write archive:" << msg;
+        emit errorOccurred(msg);
+    } else {
+        qWarning() << "Failed to write archive:" << error << "retrying in" << streamRetryMs << "ms";
+    }
+}
+
+QString ArchiveWriter::archiveFilename(const QString& directory, const QDateTime& timestamp, const int counter)
+{
+    // In case this function gets called multiple times rapidly, the `currentDateTime()` function
+    // will return the same value and therefore we will attempt to use the same filename more than
+    // once. In order to prevent this we prepend the filename with an incrementing counter.
+    return QString("%1/%2_%3.txt.zst")
+        .arg(directory,
+            timestamp.toString(Qt::DateFormat::ISODate),
+            (QStringLiteral("%1").arg(counter, 8, 10, QLatin1Char('0'))));
+}
+
+void ArchiveWriter::compressFramed(ZSTD_CCtx* ctx, QFile& file, FrameState& frames, const char* data, const size_t len, const qint64 timestamp)
+{
+    auto& stats = Stats::instance();
+    StatTimer timer(stats.compressTime);
+    stats.compressedInput.add(len);
+    frames.searchIndex.add(data, len);
+
+    size_t pos {};
+    while (pos < len) {
+        if (!frames.open) {
+            frames.open = true;
+            frames.compressedSize = 0;
+            frames.uncompressedSize = 0;
+            frames.firstLine = frames.lines;
+            frames.timestamp = timestamp;
+        }
+
+        auto take = len - pos;
+        bool end {};
+        const auto frameUsed = static_cast<size_t>(frames.uncompressedSize);
+        if (frameUsed + take >= FRAME_SIZE) {
+            const auto searchFrom = pos + (frameUsed < FRAME_SIZE ? FRAME_SIZE - frameUsed - 1 : 0);
+            const auto searchEnd = std::min(len, pos + (MAX_FRAME_SIZE - frameUsed));
+            if (const auto* newline = static_cast<const char*>(memchr(data + searchFrom, '\n', searchEnd - searchFrom))) {
+                take = static_cast<size_t>(newline - data) + 1 - pos;
+                end = true;
+            } else if (frameUsed + take >= MAX_FRAME_SIZE) {
+                take = MAX_FRAME_SIZE - frameUsed;
+                end = true;
+            }
+        }
+
+        ZSTD_inBuffer input = { data + pos, take, 0 };
+        const auto directive = end ? ZSTD_e_end : ZSTD_e_continue;
+        size_t remaining {};
+        do {
+            ZSTD_outBuffer out = { zstdOutBuffer.data(), zstdOutBuffer.size(), 0 };
+            remaining = ZSTD_compressStream2(ctx, &out, &input, directive);
+            validateZstdResult(remaining);
+            writeOutput(file, frames, out);
+        } while (input.pos < input.size || (end && remaining != 0));
+
+        frames.lines += std::count(data + pos, data + pos + take, '\n');
+        frames.uncompressedSize += static_cast<qint64>(take);
+        pos += take;
+
+        if (end) {
+            frames.index.addFrame(frames.compressedSize, frames.uncompressedSize, frames.firstLine, frames.timestamp);
+            frames.open = false;
+        }
+    }
+}
+
+void ArchiveWriter::endFrame(ZSTD_CCtx* ctx, QFile& file, FrameState& frames)
+{
+    if (!frames.open) {
+        return;
+    }
+
+    ZSTD_inBuffer input = { nullptr, 0, 0 };
+    size_t remaining {};
+    do {
+        ZSTD_outBuffer out = { zstdOutBuffer.data(), zstdOutBuffer.size(), 0 };
+        remaining = ZSTD_compressStream2(ctx, &out, &input, ZSTD_e_end);
+        validateZstdResult(remaining);
+        writeOutput(file, frames, out);
+    } while (remaining != 0);
+
+    frames.index.addFrame(frames.compressedSize, frames.uncompressedSize, frames.firstLine, frames.timestamp);
+    frames.open = false;
+}
+
+void ArchiveWriter::writeIndex(QFile& file, const FrameState& frames, const QByteArray& lineTimestamps)
+{
+    const auto index = frames.index.serialize(lineTimestamps, frames.searchIndex.serialize());
+    if (file.write(index) != index.size()) {
+        throw std::runtime_error(QString("Failed to write %1: %2").arg(file.fileName(), file.errorString()).toStdString());
+    }
+}
+
+void ArchiveWriter::writeOutput(QFile& file, FrameState& frames, const ZSTD_outBuffer& out)
+{
+    if (file.write(static_cast<const char*>(out.dst), static_cast<qint64>(out.pos)) != static_cast<qint64>(out.pos)) {
+        throw std::runtime_error(QString("Failed to write %1: %2").arg(file.fileName(), file.errorString()).toStdString());
+    }
+    frames.compressedSize += static_cast<qint64>(out.pos);
+    Stats::instance().compressedOutput.add(out.pos);
+}
+
+void ArchiveWriter::syncFile(QFile& file, const bool dataOnly)
+{
+    if (!file.flush()) {
+        throw std::runtime_error(QString("Failed to write %1: %2").arg(file.fileName(), file.errorString()).toStdString());
+    }
+    // A rotated archive that never reached the disk is lost just as if the write had failed
+    if ((dataOnly ? fdatasync(file.handle()) : fsync(file.handle())) != 0) {
+        throw std::runtime_error(QString("Failed to sync %1: %2").arg(file.fileName(), strerror(errno)).toStdString());
+    }
+}
+
+void ArchiveWriter::streamCompress(const QByteArray& data)
+{
+    if (!streamFile) {
+        const auto fileDictionary = dictionaryForFile(streamFileDirectory);
+        const auto filename = archiveFilename(streamFileDirectory, QDateTime::currentDateTime(), streamCounter++);
+        qInfo() << "Streaming to" << filename << "dictionary" << fileDictionary.id();
+
+        auto file = std::make_unique<QFile>(filename);
+        if (!file->open(QIODevice::WriteOnly | QIODevice::NewOnly)) {
+            throw std::runtime_error(QString("Failed to open: %1 %2").arg(filename, file->errorString()).toStdString());
+        }
+
+        if (!streamCtx) {
+            streamCtx = ZSTD_createCCtx();
+            if (!streamCtx) {
+                throw std::runtime_error("Failed to create zstd ctx");
+            }
+            validateZstdResult(ZSTD_CCtx_setParameter(streamCtx, ZSTD_c_checksumFlag, 1));
+            validateZstdResult(ZSTD_CCtx_setParameter(streamCtx, ZSTD_c_strategy, ZSTD_fast));
+        } else {
+            validateZstdResult(ZSTD_CCtx_reset(streamCtx, ZSTD_reset_session_only));
+        }
+        useDictionary(streamCtx, streamCDict, fileDictionary);
+        if (zstdOutBuffer.empty()) {
+            zstdOutBuffer.resize(ZSTD_CStreamOutSize());
+        }
+        streamFile = std::move(file);
+        streamUncompressedSize = 0;
+        streamFrames = {};
+        streamTimestamps.clear();
+        streamTimestampsLineOffset = streamAtLineStart ? 0 : 1;
+    }
+
+    compressFramed(streamCtx, *streamFile, streamFrames, data.data(), static_cast<size_t>(data.size()), QDateTime::currentMSecsSinceEpoch());
+    collectSamples(data.data(), static_cast<size_t>(data.size()));
+    streamUncompressedSize += data.size();
+    streamDirty = true;
+
+    // Everything appended together with this data starts in this file
+    for (const auto timestamp : streamWorkTimestamps) {
+        streamTimestamps.append(timestamp);
+    }
+    if (!data.isEmpty()) {
+        streamAtLineStart = data.back() == '\n';
+    }
+}
+
+void ArchiveWriter::streamFlush()
+{
+    if (!streamFile || !streamDirty) {
+        return;
+    }
+
+    // Flushing doesn't end the frame, it only makes everything compressed so far decodable
+    ZSTD_inBuffer input = { nullptr, 0, 0 };
+    size_t remaining {};
+    do {
+        ZSTD_outBuffer out = { zstdOutBuffer.data(), zstdOutBuffer.size(), 0 };
+        remaining = ZSTD_compressStream2(streamCtx, &out, &input, ZSTD_e_flush);
+        validateZstdResult(remaining);
+        writeOutput(*streamFile, streamFrames, out);
+    } while (remaining != 0);
+
+    syncFile(*streamFile, true);
+    streamDirty = false;
+}
+
+void ArchiveWriter::streamClose()
+{
+    if (!streamFile) {
+        return;
+    }
+
+    // Ending the frame and appending the seek table makes the file a complete archive. A file
+    // that never got here is still readable from the start, just not seekable.
+    StatTimer timer(Stats::instance().rotationTime);
+    QByteArray lineTimestamps;
+    if (!streamTimestamps.isEmpty()) {
+        const auto serialized = streamTimestamps.serialize(streamTimestampsLineOffset);
+        lineTimestamps = QByteArray(reinterpret_cast<const char*>(serialized.data()), static_cast<qsizetype>(serialized.size()));
+    }
+    endFrame(streamCtx, *streamFile, streamFrames);
+    const auto& frameList = streamFrames.index.frames();
+    const auto firstTime = !streamTimestamps.isEmpty() ? LineTimestamps::toWallClock(streamTimestamps.at(0)) / 1000000
+        : !frameList.empty()                           ? frameList.front().timestamp
+                                                       : -1;
+    streamFrames.searchIndex.setTimeRange(firstTime, QDateTime::currentMSecsSinceEpoch());
+    writeIndex(*streamFile, streamFrames, lineTimestamps);
+    syncFile(*streamFile);
+    streamDirty = false;
+
+    qInfo() << "Closed" << streamFile->fileName() << streamUncompressedSize << streamFile->size() << streamFrames.index.frames().size() << "frames";
+    emit fileWritten(streamFile->fileName(), streamUncompressedSize, streamFile->size());
+    streamFile.reset();
+    streamFileDirectory.clear();
+}
+
+void ArchiveWriter::writeCompressedFile(const Job& job)
+{
+    const auto& contents = job.contents;
+    const auto contentsLen = contents.size();
+
+    if (!contentsLen) {
+        qWarning() << "Attempt to write empty file";
+        return;
+    }
+
+    const auto fileDictionary = dictionaryForFile(job.directory);
+    const auto filename = archiveFilename(job.directory, job.timestamp, job.counter);
+
+    qInfo() << "Saving" << filename << contentsLen << "dictionary" << fileDictionary.id();
+
+    QFile file(filename);
+    if (const auto result = file.open(QIODevice::WriteOnly | QIODevice::NewOnly); !result) {
+        const auto msg = QString("Failed to open: %1 %2 %3").arg(filename).arg(static_cast<int>(result)).arg(errno);
+        qCritical() << msg;
+        throw std::runtime_error(msg.toStdString());
+    }
+
+    if (!zstdCtx) {
+        zstdCtx = ZSTD_createCCtx();
+        if (!zstdCtx) {
+            throw std::runtime_error("Failed to create zstd ctx");
+        }
+        validateZstdResult(ZSTD_CCtx_setParameter(zstdCtx, ZSTD_c_checksumFlag, 1));
+        validateZstdResult(ZSTD_CCtx_setParameter(zstdCtx, ZSTD_c_strategy, ZSTD_fast));
+        zstdOutBuffer.resize(ZSTD_CStreamOutSize()); // This returns approx 128KiB
+    } else {
+        validateZstdResult(ZSTD_CCtx_reset(zstdCtx, ZSTD_reset_session_only));
+    }
+    useDictionary(zstdCtx, zstdCDict, fileDictionary);
+
+    // A snapshot doesn't know when each line arrived, so all of its frames get the snapshot time
+    Q_ASSERT(contentsLen > 0);
+    FrameState frames;
+    compressFramed(zstdCtx, file, frames, contents.data(), static_cast<size_t>(contentsLen), job.timestamp.toMSecsSinceEpoch());
+    endFrame(zstdCtx, file, frames);
+    collectSamples(contents.data(), static_cast<size_t>(contentsLen));
+    // The snapshot only knows when its lines arrived if it has their timestamps
+    qint64 firstTime = -1;
+    if (!job.lineTimestamps.isEmpty()) {
+        try {
+            const auto [offset, timestamps] = LineTimestamps::deserialize(reinterpret_cast<const uint8_t*>(job.lineTimestamps.constData()), static_cast<size_t>(job.lineTimestamps.size()));
+            if (!timestamps.isEmpty()) {
+                firstTime = timestamps.at(0) / 1000000;
+            }
+        } catch (const std::runtime_error& e) {
+            qWarning() << "Invalid line timestamps:" << e.what();
+        }
+    }
+    frames.searchIndex.setTimeRange(firstTime, job.timestamp.toMSecsSinceEpoch());
+    writeIndex(file, frames, job.lineTimestamps);
+
+    syncFile(file);
+    const auto compressedSize = file.size();
+    file.close();
+
+    emit fileWritten(filename, contentsLen, compressedSize);
+}
+
+ArchiveDictionary ArchiveWriter::dictionaryForFile(const QString& directory)
+{
+    ArchiveDictionary fileDictionary;
+    {
+        QMutexLocker locker(&mutex);
+        fileDictionary = dictionary;
+    }
+    // Before the file is created, an archive without its dictionary can't be read
+    if (!fileDictionary.isEmpty()) {
+        fileDictionary.save(directory);
+    }
+    return fileDictionary;
+}
+
+void ArchiveWriter::useDictionary(ZSTD_CCtx* ctx, ZSTD_CDict*& cdict, const ArchiveDictionary& fileDictionary)
+{
+    // Loading the raw dictionary would build its tables again for every file, which costs more
+    // than compressing a small one. The digested one is only built when the dictionary changes.
+    if (fileDictionary.isEmpty()) {
+        validateZstdResult(ZSTD_CCtx_refCDict(ctx, nullptr));
+        ZSTD_freeCDict(cdict);
+        cdict = nullptr;
+        return;
+    }
+    if (cdict && ZSTD_getDictID_fromCDict(cdict) == fileDictionary.id()) {
+        validateZstdResult(ZSTD_CCtx_refCDict(ctx, cdict));
+        return;
+    }
+
+    const auto& data = fileDictionary.data();
+    auto* newCDict = ZSTD_createCDict(data.constData(), static_cast<size_t>(data.size()), ArchiveDictionary::COMPRESSION_LEVEL);
+    if (!newCDict) {
+        throw std::runtime_error("Failed to create zstd dictionary");
+    }
+    // The old one is still referenced by `ctx` until it is replaced
+    const auto result = ZSTD_CCtx_refCDict(ctx, newCDict);
+    if (ZSTD_isError(result)) {
+        ZSTD_freeCDict(newCDict);
+        validateZstdResult(result);
+    }
+    ZSTD_freeCDict(cdict);
+    cdict = newCDict;
+}
+
+void ArchiveWriter::collectSamples(const char* data, const size_t len)
+{
+    if (!trainingTarget) {
+        return;
+    }
+    const auto take = std::min(len, trainingTarget - static_cast<size_t>(trainingSamples.size()));
+    trainingSamples.append(data, static_cast<qsizetype>(take));
+    if (static_cast<size_t>(trainingSamples.size()) < trainingTarget) {
+        return;
+    }
+
+    // A failed training is not a reason to stop archiving, the files just stay without one
+    ArchiveDictionary trained;
+    QElapsedTimer timer;
+    timer.start();
+    try {
+        trained = ArchiveDictionary::train(trainingSamples);
+        qInfo() << "Trained dictionary" << trained.id() << "of" << trained.data().size() << "bytes from" << trainingSamples.size() << "bytes in" << timer.elapsed() << "ms";
+    } catch (const std::runtime_error& e) {
+        qWarning() << e.what();
+        emit errorOccurred(e.what());
+    }
+    trainingSamples = {};
+
+    QMutexLocker locker(&mutex);
+    // Unless it was replaced in the meantime
+    if (dictionaryTrainingBytes == trainingTarget) {
+        dictionary = trained;
+        dictionaryTrainingBytes = 0;
+    }
+    trainingTarget = 0;
+}
+
+void ArchiveWriter::validateZstdResult(const size_t result, const std::experimental::source_location srcLoc)
+{
+    if (ZSTD_isError(result)) {
+        throw std::runtime_error(std::string("ZSTD error: ") + ZSTD_getErrorName(result) + " " + std::to_string(srcLoc.line()));
+    }
+}
@@ -0,0 +1,180 @@
+#ifndef ARCHIVEWRITER_H
+#define ARCHIVEWRITER_H
+
+#include "archivedictionary.h"
+#include "archiveindex.h"
+#include "archivesearchindex.h"
+#include "linetimestamps.h"
+
+#include <zstd.h>
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QDeadlineTimer>
+#include <QFile>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <deque>
+#include <memory>
+#include <utility>
+#include <vector>
+// #include <source_location>
+#include <experimental/source_location>
+
+// Compresses and writes the long term run mode archives on a background thread so that the
+// GUI and the serial reader keep running while a rotation is written out and fsync'd.
+// The queue is bounded; if the disk can't keep up `submit()` fails and the caller is expected to
+// hold on to the data and try again later. Errors are reported through `errorOccurred()`.
+//
+// Archives are written in the seekable format described in ArchiveIndex: a new zstd frame is
+// started about every FRAME_SIZE bytes, on a line boundary, and a seek table mapping the frames to
+// line numbers and times is appended when the file is closed, along with a search index of the
+// file's text.
+//
+// Alternatively the data can be streamed: `append()` hands the incoming bytes to a persistent
+// zstd stream as they arrive and `rotate()` ends the frame and starts a new file. The stream is
+// flushed to disk every STREAM_FLUSH_INTERVAL_MS, which bounds what an unclean exit can lose.
+//
+// Either way the files can be compressed with an ArchiveDictionary, which is either given or
+// trained from the first bytes written. The dictionary is saved next to every file that needs it.
+class ArchiveWriter : public QThread {
+    Q_OBJECT
+
+public:
+    explicit ArchiveWriter(QObject* parent = nullptr);
+    // Writes out whatever is still queued before returning
+    ~ArchiveWriter();
+
+    // Can be called from any thread. Returns false if the queue is full. `lineTimestamps` is the
+    // output of LineTimestamps::serialize() and may be empty.
+    [[nodiscard]] bool submit(const QString& directory, const QByteArray& contents, const int counter, const QByteArray& lineTimestamps = {});
+
+    // Streaming mode. Can be called from any thread. `lineTimestamps` holds the receive time of
+    // every line that starts in `data`.
+    void startStream(const QString& directory);
+    void append(const char* data, const size_t len, const std::vector<int64_t>& lineTimestamps = {});
+    void rotate();
+    void stopStream();
+
+    // Can be called from any thread. Every file started from now on is compressed with
+    // `dictionary`, or without one if it is empty.
+    void setDictionary(const ArchiveDictionary& dictionary);
+    // Can be called from any thread. Trains a dictionary from the next `sampleBytes` written, at
+    // most ArchiveDictionary::MAX_TRAINING_MIB, and compresses every file started after that with
+    // it. The files until then are compressed without one.
+    void trainDictionary(const size_t sampleBytes);
+
+signals:
+    void errorOccurred(const QString& msg);
+    void fileWritten(const QString& filename, const qint64 uncompressedSize, const qint64 compressedSize);
+
+protected:
+    void run() override;
+
+private:
+    struct Job {
+        QString directory {};
+        QByteArray contents {};
+        int counter {};
+        QDateTime timestamp {};
+        QByteArray lineTimestamps {};
+    };
+
+    // Per frame bookkeeping of the archive being written
+    struct FrameState {
+        ArchiveIndex index {};
+        ArchiveSearchIndex searchIndex {};
+        qint64 lines {};
+        bool open {};
+        qint64 compressedSize {};
+        qint64 uncompressedSize {};
+        qint64 firstLine {};
+        qint64 timestamp {};
+    };
+
+    static inline constexpr size_t MAX_QUEUED_JOBS = 2;
+    // Frames are ended at the first newline after FRAME_SIZE, or at MAX_FRAME_SIZE if there is none
+    static inline constexpr size_t FRAME_SIZE = 1024 * 1024;
+    static inline constexpr size_t MAX_FRAME_SIZE = 2 * FRAME_SIZE;
+    static inline constexpr int STREAM_FLUSH_INTERVAL_MS = 1000;
+    // Only used to warn about a disk that can't keep up, the data is never dropped
+    static inline constexpr qsizetype STREAM_BACKLOG_WARNING = 64 * 1024 * 1024;
+    // A batch that couldn't be written is kept and retried after a delay that doubles from
+    // STREAM_RETRY_MIN_MS up to STREAM_RETRY_MAX_MS. Only if the disk fails for so long that more
+    // than STREAM_MAX_RETAINED piles up is the data dropped.
+    static inline constexpr int STREAM_RETRY_MIN_MS = 1000;
+    static inline constexpr int STREAM_RETRY_MAX_MS = 60 * 1000;
+    static inline constexpr qsizetype STREAM_MAX_RETAINED = 512 * 1024 * 1024;
+
+    QMutex mutex;
+    QWaitCondition jobAvailable;
+    std::deque<Job> queue {};
+    bool stopping {};
+
+    // Streaming state shared with the producer, protected by `mutex`
+    QString streamDirectory {};
+    QByteArray streamPending {};
+    std::vector<int64_t> streamPendingTimestamps {};
+    bool streamRotateRequested {};
+    bool streamStopRequested {};
+    bool streamBacklogWarned {};
+
+    // Also protected by `mutex`. Trained dictionaries end up in `dictionary` as well.
+    ArchiveDictionary dictionary {};
+    size_t dictionaryTrainingBytes {};
+
+    // Only touched by the worker thread
+    ZSTD_CCtx* zstdCtx {};
+    // The dictionary digested for the context that references it, rebuilt when it changes
+    ZSTD_CDict* zstdCDict {};
+    std::vector<char> zstdOutBuffer {};
+
+    ZSTD_CCtx* streamCtx {};
+    ZSTD_CDict* streamCDict {};
+    std::unique_ptr<QFile> streamFile {};
+    QString streamFileDirectory {};
+    int streamCounter {};
+    qint64 streamUncompressedSize {};
+    bool streamDirty {};
+    QByteArray streamWork {};
+    std::vector<int64_t> streamWorkTimestamps {};
+    // 0 while the stream is being written, the current retry delay while it is failing
+    int streamRetryMs {};
+    QDeadlineTimer streamRetryDeadline {};
+    FrameState streamFrames {};
+    // Line timestamps of the current file. If the file starts in the middle of a line, that line
+    // belongs to the previous file and the timestamps start at the second line.
+    LineTimestamps streamTimestamps {};
+    uint64_t streamTimestampsLineOffset {};
+    bool streamAtLineStart = true;
+
+    // Everything written since trainDictionary() until there are `trainingTarget` bytes
+    QByteArray trainingSamples {};
+    size_t trainingTarget {};
+
+    void writeCompressedFile(const Job& job);
+    [[nodiscard]] static QString archiveFilename(const QString& directory, const QDateTime& timestamp, const int counter);
+
+    void compressFramed(ZSTD_CCtx* ctx, QFile& file, FrameState& frames, const char* data, const size_t len, const qint64 timestamp);
+    void endFrame(ZSTD_CCtx* ctx, QFile& file, FrameState& frames);
+    void writeIndex(QFile& file, const FrameState& frames, const QByteArray& lineTimestamps);
+    void writeOutput(QFile& file, FrameState& frames, const ZSTD_outBuffer& out);
+    // Flushes `file` and waits until it is on the disk, only its contents if `dataOnly`. Throws
+    // std::runtime_error.
+    static void syncFile(QFile& file, const bool dataOnly = false);
+    // The dictionary for a new file in `directory`, saved there if it isn't already
+    [[nodiscard]] ArchiveDictionary dictionaryForFile(const QString& directory);
+    static void useDictionary(ZSTD_CCtx* ctx, ZSTD_CDict*& cdict, const ArchiveDictionary& fileDictionary);
+    void collectSamples(const char* data, const size_t len);
+
+    void streamCompress(const QByteArray& data);
+    void streamFlush();
+    void streamClose();
+    // Puts the batch that failed back in front of what arrived meanwhile
+    void retainStreamWork(const QString& error);
+    static void validateZstdResult(const size_t result, const std::experimental::source_location = std::experimental::source_location::current());
+};
+
+#endif // ARCHIVEWRITER_H
@@ -0,0 +1,236 @@
+// Heap allocations per chunk in the steady state of the capture path. Synthetic log traffic is
+// written to a pipe and read straight into a RingBuffer, the way SerialReader reads the port, and
+// every chunk goes through LineFramer, TriggerEngine, LineTimestamps with a bounded scrollback and
+// the pending buffer that is decoded by Utf8Decoder at the refresh rate. malloc() and friends are
+// replaced to count the calls, the first GiB is the warm-up during which the buffers grow to
+// their working size. Once warmed up, neither the allocation count nor the RSS should move.
+// Usage: allocbench [GiB] [scrollback lines]
+
+#include "lineframer.h"
+#include "linetimestamps.h"
+#include "ringbuffer.h"
+#include "triggerengine.h"
+#include "utf8decoder.h"
+
+#include <QByteArray>
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <random>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+extern "C" {
+
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void __libc_free(void* ptr);
+
+}
+
+namespace {
+
+std::atomic<uint64_t> allocations {};
+
+}
+
+// Everything, including operator new and Qt's containers, ends up here
+extern "C" {
+
+void* malloc(size_t size) noexcept
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) noexcept
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) noexcept
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+void free(void* ptr) noexcept
+{
+    __libc_free(ptr);
+}
+
+}
+
+namespace {
+
+QByteArray makeInput(const qsizetype size)
+{
+    static constexpr const char* SEVERITIES[] = { "DEBUG", "INFO", "INFO", "INFO", "WARNING", "ERROR" };
+    static constexpr const char* WORDS[] = { "sensor", "température", "ok", "retry", "€", "timeout" };
+
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<size_t> severity(0, std::size(SEVERITIES) - 1);
+    std::uniform_int_distribution<size_t> word(0, std::size(WORDS) - 1);
+    std::uniform_int_distribution<int> words(2, 20);
+
+    QByteArray input;
+    input.reserve(size + 256);
+    while (input.size() < size) {
+        input.append('[').append(SEVERITIES[severity(rng)]).append("] ");
+        for (int i = words(rng); i > 0; i--) {
+            input.append(WORDS[word(rng)]).append(' ');
+        }
+        input.append('\n');
+    }
+    return input;
+}
+
+size_t residentBytes()
+{
+    long pages {};
+    if (auto* file = fopen("/proc/self/statm", "r")) {
+        if (fscanf(file, "%*d %ld", &pages) != 1) {
+            pages = 0;
+        }
+        fclose(file);
+    }
+    return static_cast<size_t>(pages) * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    const long long gib = argc > 1 ? std::atoll(argv[1]) : 4;
+    const long long scrollbackLines = argc > 2 ? std::atoll(argv[2]) : 1000000;
+    if (gib <= 1 || scrollbackLines <= 0) {
+        fprintf(stderr, "Usage: allocbench [GiB > 1] [scrollback lines]\n");
+        return EXIT_FAILURE;
+    }
+    const auto total = static_cast<uint64_t>(gib) << 30;
+    constexpr uint64_t WARMUP = 1ull << 30;
+    // What a serial port delivers per read, from a few bytes to a full USB transfer
+    constexpr size_t READ_SIZES[] = { 1, 7, 31, 62, 64, 200, 510, 512, 4096 };
+    // About 60 flushes per second at 921600 baud
+    constexpr qsizetype FLUSH_BYTES = 1536;
+
+    const auto input = makeInput(4 * 1024 * 1024);
+
+    int fds[2] {};
+    if (pipe2(fds, O_NONBLOCK) != 0) {
+        perror("pipe2");
+        return EXIT_FAILURE;
+    }
+
+    RingBuffer ring(1024 * 1024);
+    LineFramer lineFramer;
+    TriggerEngine triggerEngine;
+    triggerEngine.setTriggers({ { "ERROR", false }, { "timeout", false }, { "retry [a-z]+ ok", true } });
+    LineTimestamps lineTimestamps;
+    Utf8Decoder decoder;
+    QByteArray pendingData;
+
+    uint64_t processed {}, chunks {}, lines {}, matches {}, decoded {};
+    uint64_t steadyAllocations {}, steadyChunks {};
+    size_t warmRss {}, maxRss {};
+    bool atLineStart = true;
+    size_t readIndex {};
+    qsizetype inputOffset {};
+
+    QElapsedTimer timer;
+    timer.start();
+    while (processed < total) {
+        // Producer: one write stands for whatever arrived since the last read
+        const auto size = std::min<size_t>(READ_SIZES[readIndex++ % std::size(READ_SIZES)], static_cast<size_t>(input.size() - inputOffset));
+        if (const auto n = write(fds[1], input.constData() + inputOffset, size); n > 0) {
+            inputOffset = (inputOffset + n) % input.size();
+        }
+
+        // Reader: straight into the ring buffer, like SerialReader::handleReadyRead()
+        const auto timestamp = LineTimestamps::now();
+        while (true) {
+            const auto [ptr, space] = ring.writeRegion();
+            if (!space) {
+                break;
+            }
+            const auto n = read(fds[0], ptr, space);
+            if (n <= 0) {
+                break;
+            }
+            ring.commitWrite(static_cast<size_t>(n));
+        }
+
+        // Consumer, like PortCapture::processChunk() and MainWindow::processChunk()
+        const auto before = allocations.load(std::memory_order_relaxed);
+        size_t chunksNow {};
+        while (true) {
+            const auto [data, len] = ring.readRegion();
+            if (!len) {
+                break;
+            }
+            lineFramer.frame(data, len);
+            triggerEngine.scan(data, len, lineFramer.newlines(), [&](const size_t) { matches++; });
+
+            if (atLineStart) {
+                lineTimestamps.append(timestamp);
+            }
+            for (const auto newline : lineFramer.newlines()) {
+                if (newline + 1 < len) {
+                    lineTimestamps.append(timestamp);
+                }
+            }
+            atLineStart = data[len - 1] == '\n';
+            lines += lineFramer.newlines().size();
+
+            // The scrollback evicts down to 90% once it is full, see MainWindow::enforceScrollback()
+            if (lineTimestamps.size() > static_cast<size_t>(scrollbackLines)) {
+                lineTimestamps.removeFirst(lineTimestamps.size() - static_cast<size_t>(scrollbackLines) * 9 / 10);
+            }
+
+            pendingData.append(data, static_cast<qsizetype>(len));
+            if (pendingData.size() >= FLUSH_BYTES) {
+                decoded += static_cast<uint64_t>(decoder.decode(pendingData.constData(), static_cast<size_t>(pendingData.size())).size());
+                pendingData.resize(0);
+            }
+
+            ring.commitRead(len);
+            processed += len;
+            chunksNow++;
+        }
+        chunks += chunksNow;
+
+        if (processed >= WARMUP) {
+            if (!warmRss) {
+                warmRss = residentBytes();
+            } else {
+                steadyAllocations += allocations.load(std::memory_order_relaxed) - before;
+                steadyChunks += chunksNow;
+            }
+            if (steadyChunks % 65536 < chunksNow) {
+                maxRss = std::max(maxRss, residentBytes());
+            }
+        }
+    }
+    const auto seconds = static_cast<double>(timer.elapsed()) / 1e3;
+    maxRss = std::max(maxRss, residentBytes());
+    close(fds[0]);
+    close(fds[1]);
+
+    printf("%.2f GiB in %llu chunks, %llu lines, %llu trigger matches, %llu UTF-16 units (%s), %.2f s\n",
+           static_cast<double>(processed) / (1u << 30), static_cast<unsigned long long>(chunks), static_cast<unsigned long long>(lines),
+           static_cast<unsigned long long>(matches), static_cast<unsigned long long>(decoded), decoder.implementation(), seconds);
+    printf("Timestamps of %zu lines in %.1f MiB\n", lineTimestamps.size(), static_cast<double>(lineTimestamps.memoryUsage()) / (1 << 20));
+    printf("Steady state: %llu allocations in %llu chunks │ %.6f per chunk\n", static_cast<unsigned long long>(steadyAllocations),
+           static_cast<unsigned long long>(steadyChunks), steadyChunks ? static_cast<double>(steadyAllocations) / static_cast<double>(steadyChunks) : 0.0);
+    printf("RSS: %.1f MiB after warm-up │ %.1f MiB peak │ %+.1f MiB\n", static_cast<double>(warmRss) / (1 << 20),
+           static_cast<double>(maxRss) / (1 << 20), (static_cast<double>(maxRss) - static_cast<double>(warmRss)) / (1 << 20));
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,86 @@
+// Compares Utf8Decoder against converting every chunk with QString::fromUtf8(), which is what
+// inserting a QByteArray into the document does. Also counts the characters that the per chunk
+// conversion breaks because they were split between two chunks.
+// Usage: decodebench [MiB] [non-ASCII lines in percent] [chunk bytes]
+
+#include "utf8decoder.h"
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QString>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <random>
+
+namespace {
+
+QByteArray makeInput(const qsizetype size, const unsigned utf8Percent)
+{
+    // Two, three and four byte sequences
+    static constexpr const char* WORDS[] = { "Grüße", "température", "€", "日本語", "𝄞", "ok" };
+
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<unsigned> percent(0, 99);
+    std::uniform_int_distribution<int> lineLength(20, 160);
+    std::uniform_int_distribution<int> printable(' ', '~');
+    std::uniform_int_distribution<size_t> word(0, std::size(WORDS) - 1);
+
+    QByteArray input;
+    input.reserve(size + 256);
+    while (input.size() < size) {
+        const auto len = lineLength(rng);
+        const auto utf8 = percent(rng) < utf8Percent;
+        for (int i = 0; i < len; i++) {
+            if (utf8 && i % 16 == 0) {
+                input.append(WORDS[word(rng)]);
+            }
+            input.append(static_cast<char>(printable(rng)));
+        }
+        input.append('\n');
+    }
+    return input;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    const qsizetype mib = argc > 1 ? std::atoi(argv[1]) : 256;
+    const unsigned utf8Percent = argc > 2 ? static_cast<unsigned>(std::atoi(argv[2])) : 10;
+    const qsizetype chunk = argc > 3 ? std::atoi(argv[3]) : 4096;
+    if (mib <= 0 || chunk <= 0) {
+        fprintf(stderr, "Usage: decodebench [MiB] [non-ASCII lines in percent] [chunk bytes]\n");
+        return EXIT_FAILURE;
+    }
+    const auto input = makeInput(mib * 1024 * 1024, utf8Percent);
+    QElapsedTimer timer;
+
+    // Old path, a new QString for every chunk
+    qsizetype oldReplacements {};
+    timer.start();
+    for (qsizetype offset = 0; offset < input.size(); offset += chunk) {
+        const auto text = QString::fromUtf8(input.constData() + offset, std::min(chunk, input.size() - offset));
+        oldReplacements += text.count(QChar::ReplacementCharacter);
+    }
+    const auto oldNs = timer.nsecsElapsed();
+
+    Utf8Decoder decoder;
+    size_t invalid {};
+    timer.restart();
+    for (qsizetype offset = 0; offset < input.size(); offset += chunk) {
+        decoder.decode(input.constData() + offset, static_cast<size_t>(std::min(chunk, input.size() - offset)));
+        invalid += decoder.invalidBytes();
+    }
+    const auto newNs = timer.nsecsElapsed();
+
+    const auto mbps = [&](const qint64 ns) { return static_cast<double>(input.size()) / 1e6 / (static_cast<double>(ns) / 1e9); };
+
+    printf("Input: %lld MiB, %u%% lines with non-ASCII, chunks of %lld bytes\n", static_cast<long long>(mib), utf8Percent, static_cast<long long>(chunk));
+    printf("QString::fromUtf8:     %8.1f ms %8.1f MB/s, %lld broken characters\n", static_cast<double>(oldNs) / 1e6, mbps(oldNs), static_cast<long long>(oldReplacements));
+    printf("Utf8Decoder (%s):   %8.1f ms %8.1f MB/s, %zu invalid bytes\n", decoder.implementation(), static_cast<double>(newNs) / 1e6, mbps(newNs), invalid);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,204 @@
+// Compression ratio and throughput of archives with and without an ArchiveDictionary. The
+// dictionary is trained from the first part of the input and the rest is cut into rotations of
+// several sizes, each compressed on its own the way ArchiveWriter compresses a file: ZSTD_fast with
+// checksums and a dictionary that is digested once, at ArchiveDictionary::COMPRESSION_LEVEL.
+// Every archive is decompressed again and compared. The input is a log file or synthetic log
+// lines with counters and slowly drifting readings, like a device would print them.
+// Usage: dictbench [training MiB] [log file]
+
+#include "archivedictionary.h"
+
+#include <zstd.h>
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QString>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <random>
+
+namespace {
+
+QByteArray makeInput(const qsizetype size)
+{
+    static constexpr const char* SEVERITIES[] = { "DBG", "INF", "INF", "INF", "WRN", "ERR" };
+    static constexpr const char* MESSAGES[] = {
+        "sensor: temperature=%1 humidity=%2",
+        "net: tx packet seq=%1 len=%2",
+        "net: rx ack seq=%1 rssi=-%2",
+        "power: battery %1 mV, load %2 mA",
+        "scheduler: task %1 overran by %2 us",
+        "uart: frame error at offset %1 (count %2)",
+    };
+
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<size_t> severity(0, std::size(SEVERITIES) - 1);
+    std::uniform_int_distribution<size_t> message(0, std::size(MESSAGES) - 1);
+    std::uniform_int_distribution<unsigned> step(0, 39);
+
+    // The two values of every message, which mostly change a little from one line to the next
+    unsigned values[std::size(MESSAGES)][2] = { { 215, 40 }, { 0, 64 }, { 0, 70 }, { 3700, 120 }, { 1, 50 }, { 0, 0 } };
+
+    QByteArray input;
+    input.reserve(size + 256);
+    unsigned ms {};
+    while (input.size() < size) {
+        ms += step(rng);
+        input.append(QStringLiteral("[%1.%2] <%3> ")
+                         .arg(ms / 1000, 8, 10, QLatin1Char(' '))
+                         .arg(ms % 1000, 3, 10, QLatin1Char('0'))
+                         .arg(QLatin1String(SEVERITIES[severity(rng)]))
+                         .toUtf8());
+        const auto index = message(rng);
+        auto& value = values[index];
+        switch (index) {
+        case 0:
+            value[0] = value[0] + rng() % 3 - 1;
+            value[1] = value[1] + rng() % 3 - 1;
+            break;
+        case 1:
+            value[0]++;
+            value[1] = 64u << (rng() % 3);
+            break;
+        case 2:
+            value[0]++;
+            value[1] = 60 + rng() % 20;
+            break;
+        case 3:
+            value[0] -= rng() % 2;
+            value[1] = 100 + rng() % 50;
+            break;
+        case 4:
+            value[0] = 1 + rng() % 8;
+            value[1] = 10 * (rng() % 20);
+            break;
+        default:
+            value[0] += rng() % 512;
+            value[1]++;
+            break;
+        }
+        input.append(QString::fromLatin1(MESSAGES[index]).arg(value[0]).arg(value[1]).toUtf8());
+        input.append('\n');
+    }
+    return input;
+}
+
+struct Result {
+    size_t compressed {};
+    double compressSeconds {};
+    double decompressSeconds {};
+    bool ok = true;
+};
+
+Result run(const QByteArray& data, const qsizetype rotation, const ArchiveDictionary& dictionary)
+{
+    auto* cctx = ZSTD_createCCtx();
+    auto* dctx = ZSTD_createDCtx();
+    ZSTD_CCtx_setParameter(cctx, ZSTD_c_checksumFlag, 1);
+    ZSTD_CCtx_setParameter(cctx, ZSTD_c_strategy, ZSTD_fast);
+    const auto* dictionaryData = dictionary.data().constData();
+    const auto dictionarySize = static_cast<size_t>(dictionary.data().size());
+    ZSTD_CDict* cdict = dictionary.isEmpty() ? nullptr : ZSTD_createCDict(dictionaryData, dictionarySize, ArchiveDictionary::COMPRESSION_LEVEL);
+    ZSTD_DDict* ddict = dictionary.isEmpty() ? nullptr : ZSTD_createDDict(dictionaryData, dictionarySize);
+    ZSTD_DCtx_refDDict(dctx, ddict);
+
+    QByteArray compressed(static_cast<qsizetype>(ZSTD_compressBound(static_cast<size_t>(rotation))), Qt::Uninitialized);
+    QByteArray decompressed(rotation, Qt::Uninitialized);
+    Result result;
+    QElapsedTimer timer;
+
+    for (qsizetype offset = 0; offset + rotation <= data.size(); offset += rotation) {
+        timer.start();
+        ZSTD_CCtx_reset(cctx, ZSTD_reset_session_only);
+        ZSTD_CCtx_refCDict(cctx, cdict);
+        const auto size = ZSTD_compress2(cctx, compressed.data(), static_cast<size_t>(compressed.size()), data.constData() + offset, static_cast<size_t>(rotation));
+        result.compressSeconds += static_cast<double>(timer.nsecsElapsed()) / 1e9;
+        if (ZSTD_isError(size)) {
+            fprintf(stderr, "Compression failed: %s\n", ZSTD_getErrorName(size));
+            result.ok = false;
+            break;
+        }
+        result.compressed += size;
+
+        timer.start();
+        const auto decompressedSize = ZSTD_decompressDCtx(dctx, decompressed.data(), static_cast<size_t>(decompressed.size()), compressed.constData(), size);
+        result.decompressSeconds += static_cast<double>(timer.nsecsElapsed()) / 1e9;
+        if (ZSTD_isError(decompressedSize) || decompressedSize != static_cast<size_t>(rotation)
+            || memcmp(decompressed.constData(), data.constData() + offset, static_cast<size_t>(rotation)) != 0) {
+            fprintf(stderr, "Round trip failed\n");
+            result.ok = false;
+            break;
+        }
+    }
+
+    ZSTD_freeDDict(ddict);
+    ZSTD_freeCDict(cdict);
+    ZSTD_freeDCtx(dctx);
+    ZSTD_freeCCtx(cctx);
+    return result;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    const qsizetype trainingMiB = argc > 1 ? std::atoi(argv[1]) : 8;
+    if (trainingMiB <= 0) {
+        fprintf(stderr, "Usage: dictbench [training MiB] [log file]\n");
+        return EXIT_FAILURE;
+    }
+    const auto trainingSize = trainingMiB * 1024 * 1024;
+
+    QByteArray input;
+    if (argc > 2) {
+        QFile file(argv[2]);
+        if (!file.open(QIODevice::ReadOnly)) {
+            fprintf(stderr, "Failed to open %s: %s\n", argv[2], qPrintable(file.errorString()));
+            return EXIT_FAILURE;
+        }
+        input = file.readAll();
+    } else {
+        input = makeInput(trainingSize + 64 * 1024 * 1024);
+    }
+    if (input.size() <= trainingSize) {
+        fprintf(stderr, "Need more than the %lld MiB to train from\n", static_cast<long long>(trainingMiB));
+        return EXIT_FAILURE;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    ArchiveDictionary dictionary;
+    try {
+        dictionary = ArchiveDictionary::train(input.left(trainingSize));
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return EXIT_FAILURE;
+    }
+    const auto rest = input.mid(trainingSize);
+    printf("Dictionary %u of %lld KiB trained from %lld MiB in %lld ms, %.1f MiB to compress\n", dictionary.id(),
+        static_cast<long long>(dictionary.data().size() / 1024), static_cast<long long>(trainingMiB), static_cast<long long>(timer.elapsed()),
+        static_cast<double>(rest.size()) / (1024 * 1024));
+
+    bool ok = true;
+    for (const qsizetype rotation : { 4 * 1024, 16 * 1024, 64 * 1024, 256 * 1024, 1024 * 1024 }) {
+        if (rotation > rest.size()) {
+            break;
+        }
+        const auto files = rest.size() / rotation;
+        const auto megabytes = static_cast<double>(files * rotation) / 1e6;
+        for (const auto withDictionary : { false, true }) {
+            const auto result = run(rest, rotation, withDictionary ? dictionary : ArchiveDictionary {});
+            ok &= result.ok;
+            printf("%5lld KiB x %6lld │ %-15s │ ratio %6.2f │ compress %8.1f MB/s │ decompress %8.1f MB/s\n",
+                static_cast<long long>(rotation / 1024), static_cast<long long>(files), withDictionary ? "dictionary" : "no dictionary",
+                static_cast<double>(files * rotation) / static_cast<double>(result.compressed), megabytes / result.compressSeconds,
+                megabytes / result.decompressSeconds);
+        }
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,84 @@
+// Compares LineFramer against the old ingest path: QByteArray::replace() for the NUL scrub
+// followed by a per byte loop looking for line ends.
+// Usage: framebench [MiB] [NUL density in percent]
+
+#include "lineframer.h"
+
+#include <QByteArray>
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+namespace {
+
+QByteArray makeInput(const qsizetype size, const unsigned nulPercent)
+{
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<unsigned> percent(0, 99);
+    std::uniform_int_distribution<int> lineLength(20, 160);
+    std::uniform_int_distribution<int> printable(' ', '~');
+
+    QByteArray input;
+    input.reserve(size);
+    while (input.size() < size) {
+        const auto len = lineLength(rng);
+        for (int i = 0; i < len; i++) {
+            input.append(percent(rng) < nulPercent ? '\0' : static_cast<char>(printable(rng)));
+        }
+        input.append('\n');
+    }
+    return input;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    const qsizetype mib = argc > 1 ? std::atoi(argv[1]) : 256;
+    const unsigned nulPercent = argc > 2 ? static_cast<unsigned>(std::atoi(argv[2])) : 1;
+    const auto input = makeInput(mib * 1024 * 1024, nulPercent);
+
+    constexpr qsizetype CHUNK = 64 * 1024;
+    QElapsedTimer timer;
+
+    // Old path
+    size_t oldLines {};
+    QByteArray line;
+    timer.start();
+    for (qsizetype offset = 0; offset < input.size(); offset += CHUNK) {
+        auto chunk = input.mid(offset, CHUNK);
+        chunk.replace('\0', ' ');
+        for (const auto c : chunk) {
+            if (c == '\n') {
+                oldLines++;
+                line.resize(0);
+            } else {
+                line.push_back(c);
+            }
+        }
+    }
+    const auto oldNs = timer.nsecsElapsed();
+
+    // LineFramer, in place on a private copy
+    auto copy = input;
+    copy.detach();
+    LineFramer framer;
+    size_t newLines {};
+    timer.restart();
+    for (qsizetype offset = 0; offset < copy.size(); offset += CHUNK) {
+        framer.frame(copy.data() + offset, static_cast<size_t>(std::min(CHUNK, copy.size() - offset)));
+        newLines += framer.newlines().size();
+    }
+    const auto newNs = timer.nsecsElapsed();
+
+    const auto mbps = [&](const qint64 ns) { return static_cast<double>(input.size()) / 1e6 / (static_cast<double>(ns) / 1e9); };
+
+    printf("Input: %lld MiB, %u%% NUL, %zu lines (old path counted %zu)\n", static_cast<long long>(mib), nulPercent, newLines, oldLines);
+    printf("replace + per byte loop: %8.1f ms %8.1f MB/s\n", static_cast<double>(oldNs) / 1e6, mbps(oldNs));
+    printf("LineFramer (%s):      %8.1f ms %8.1f MB/s\n", framer.implementation(), static_cast<double>(newNs) / 1e6, mbps(newNs));
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,129 @@
+// GUI thread CPU time spent per MB of log text with each level of AdaptiveHighlighting. Synthetic
+// log lines are inserted into a document in chunks the way the ingest path does it, with the view
+// following the end so that every line gets highlighted. Rendered offscreen unless --show is given.
+// Usage: highlightbench [MiB] [chunk KiB] [--show]
+
+#include "adaptivehighlighting.h"
+
+#include <KTextEditor/Document>
+#include <KTextEditor/Editor>
+#include <KTextEditor/View>
+
+#include <QApplication>
+#include <QByteArray>
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <random>
+
+#include <sys/resource.h>
+
+namespace {
+
+QByteArray makeInput(const qsizetype size)
+{
+    static constexpr const char* SEVERITIES[] = { "DEBUG", "INFO", "INFO", "INFO", "WARNING", "ERROR" };
+    static constexpr const char* MODULES[] = { "uart", "net", "sensor", "power", "scheduler" };
+
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<size_t> severity(0, std::size(SEVERITIES) - 1);
+    std::uniform_int_distribution<size_t> module(0, std::size(MODULES) - 1);
+    std::uniform_int_distribution<unsigned> value(0, 0xffff);
+
+    QByteArray input;
+    input.reserve(size + 256);
+    unsigned ms {};
+    while (input.size() < size) {
+        ms += value(rng) % 50;
+        input.append(QStringLiteral("2026-01-01 %1:%2:%3.%4 [%5] %6: sample %7 value=0x%8 status=\"%9\"\n")
+                         .arg(ms / 3600000 % 24, 2, 10, QLatin1Char('0'))
+                         .arg(ms / 60000 % 60, 2, 10, QLatin1Char('0'))
+                         .arg(ms / 1000 % 60, 2, 10, QLatin1Char('0'))
+                         .arg(ms % 1000, 3, 10, QLatin1Char('0'))
+                         .arg(QLatin1String(SEVERITIES[severity(rng)]), QLatin1String(MODULES[module(rng)]))
+                         .arg(value(rng))
+                         .arg(value(rng), 4, 16, QLatin1Char('0'))
+                         .arg(QLatin1String(value(rng) % 2 ? "ok" : "retry"))
+                         .toUtf8());
+    }
+    return input;
+}
+
+double cpuSeconds()
+{
+    rusage usage {};
+    getrusage(RUSAGE_SELF, &usage);
+    const auto toSeconds = [](const timeval& t) { return static_cast<double>(t.tv_sec) + static_cast<double>(t.tv_usec) / 1e6; };
+    return toSeconds(usage.ru_utime) + toSeconds(usage.ru_stime);
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    bool show {};
+    for (int i = 1; i < argc; i++) {
+        show |= !strcmp(argv[i], "--show");
+    }
+    if (!show && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QApplication app(argc, argv);
+
+    const qsizetype mib = argc > 1 && strcmp(argv[1], "--show") ? std::atoi(argv[1]) : 32;
+    const qsizetype chunkSize = (argc > 2 && strcmp(argv[2], "--show") ? std::atoi(argv[2]) : 64) * 1024;
+    if (mib <= 0 || chunkSize <= 0) {
+        fprintf(stderr, "Usage: highlightbench [MiB] [chunk KiB] [--show]\n");
+        return EXIT_FAILURE;
+    }
+    const auto input = makeInput(mib * 1024 * 1024);
+    const auto megabytes = static_cast<double>(input.size()) / 1e6;
+
+    auto* editor = KTextEditor::Editor::instance();
+    double fullCpu {};
+    printf("%lld MiB in chunks of %lld KiB\n", static_cast<long long>(mib), static_cast<long long>(chunkSize / 1024));
+
+    for (const auto level : { AdaptiveHighlighting::Level::Full, AdaptiveHighlighting::Level::Simple, AdaptiveHighlighting::Level::Plain }) {
+        const auto mode = AdaptiveHighlighting::modeName(level);
+        auto* doc = editor->createDocument(nullptr);
+        if (!doc->highlightingModes().contains(mode)) {
+            printf("%-22s not available\n", qPrintable(AdaptiveHighlighting::displayName(level)));
+            delete doc;
+            continue;
+        }
+        doc->setHighlightingMode(mode);
+        auto* view = doc->createView(nullptr);
+        view->resize(1280, 800);
+        view->show();
+        QCoreApplication::processEvents();
+
+        QElapsedTimer timer;
+        timer.start();
+        const auto cpuStart = cpuSeconds();
+        for (qsizetype offset = 0; offset < input.size(); offset += chunkSize) {
+            doc->insertText(doc->documentEnd(), QString::fromUtf8(input.constData() + offset, std::min(chunkSize, input.size() - offset)));
+            view->setCursorPosition(doc->documentEnd());
+            view->repaint();
+            QCoreApplication::processEvents();
+        }
+        const auto cpu = cpuSeconds() - cpuStart;
+        const auto wall = static_cast<double>(timer.elapsed()) / 1e3;
+        if (level == AdaptiveHighlighting::Level::Full) {
+            fullCpu = cpu;
+        }
+
+        printf("%-22s CPU %7.2f s │ %7.2f ms/MB │ wall %7.2f s", qPrintable(AdaptiveHighlighting::displayName(level)), cpu, cpu * 1e3 / megabytes, wall);
+        if (fullCpu > 0 && level != AdaptiveHighlighting::Level::Full) {
+            printf(" │ saves %7.2f ms/MB (%.0f%%)", (fullCpu - cpu) * 1e3 / megabytes, (fullCpu - cpu) / fullCpu * 100);
+        }
+        printf("\n");
+
+        delete view;
+        delete doc;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,406 @@
+// End to end ingest benchmark. Synthetic log traffic is written to a pseudo terminal and read
+// through the real capture path: SerialReader and the document of a MainWindow, which is handed
+// the pseudo terminal like a port given on the command line. Every few lines carry the time they
+// were written, which is picked up again once the line has been inserted into the document. No
+// serial hardware or display is needed, the window is rendered offscreen unless --show is given.
+//
+// MainWindow takes its scrollback, trigger and long term run mode settings from its dialogs, so
+// it is measured with none of them. --window multi reads through PortCapture and a
+// MultiPortWindow instead, which can be given all of them, to measure the cost of the triggers,
+// the scrollback and the archive rotations.
+// Usage: ingestbench [options], see --help
+
+#include "linetimestamps.h"
+#include "mainwindow.h"
+#include "multiportwindow.h"
+#include "portcapture.h"
+
+#include <KTextEditor/Document>
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QTimer>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <pty.h>
+#include <sys/resource.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace {
+
+struct Traffic {
+    qint64 totalBytes {};
+    // 0 to write as fast as the reader takes it
+    qint64 bytesPerSecond {};
+    size_t burstBytes {};
+    int lineMin {};
+    int lineMax {};
+    unsigned nulPercent {};
+    unsigned triggerPercent {};
+    int probeEvery {};
+    std::string keyword {};
+};
+
+// Lines are taken from a pool round robin so that generating them doesn't limit the writer
+constexpr size_t LINE_POOL_SIZE = 64 * 1024;
+// Gaps between heartbeats longer than this are counted as event loop stalls
+constexpr int64_t STALL_THRESHOLD_NS = 5'000'000;
+// How long to wait for the rest of the data once the writer is done
+constexpr int64_t DRAIN_TIMEOUT_NS = 10'000'000'000;
+// Stalls and latencies this close to a rotation are attributed to it
+constexpr int64_t ROTATION_WINDOW_NS = 1'000'000'000;
+
+std::vector<std::string> makeLines(const Traffic& traffic)
+{
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<unsigned> percent(0, 99);
+    std::uniform_int_distribution<int> lineLength(traffic.lineMin, traffic.lineMax);
+    std::uniform_int_distribution<int> printable(' ', '~');
+
+    std::vector<std::string> lines(LINE_POOL_SIZE);
+    for (auto& line : lines) {
+        const auto len = static_cast<size_t>(lineLength(rng));
+        while (line.size() < len) {
+            // '#' is reserved for the probes
+            const auto c = static_cast<char>(printable(rng));
+            line += percent(rng) < traffic.nulPercent ? '\0' : c == '#' ? '-' : c;
+        }
+        if (percent(rng) < traffic.triggerPercent) {
+            line.insert(line.size() / 2, traffic.keyword);
+        }
+    }
+    return lines;
+}
+
+bool writeAll(const int fd, const std::string& data, const std::atomic_bool& stop)
+{
+    size_t offset {};
+    while (offset < data.size()) {
+        if (stop) {
+            return false;
+        }
+        const auto written = write(fd, data.data() + offset, data.size() - offset);
+        if (written > 0) {
+            offset += static_cast<size_t>(written);
+        } else if (written < 0 && errno != EAGAIN && errno != EINTR) {
+            perror("write");
+            return false;
+        } else {
+            // The reader is behind, wait for room in the pty
+            pollfd pfd { fd, POLLOUT, 0 };
+            poll(&pfd, 1, 100);
+        }
+    }
+    return true;
+}
+
+// Runs on its own thread. Bursts are paced so that the average matches the requested rate.
+void writeTraffic(const int fd, const Traffic& traffic, std::atomic<qint64>& written, std::atomic_bool& stop)
+{
+    const auto lines = makeLines(traffic);
+    const auto start = LineTimestamps::now();
+
+    std::string burst;
+    burst.reserve(traffic.burstBytes + static_cast<size_t>(traffic.lineMax) + traffic.keyword.size() + 32);
+    size_t lineIndex {};
+    qint64 total {};
+
+    while (total < traffic.totalBytes) {
+        burst.clear();
+        const auto timestamp = std::to_string(LineTimestamps::now());
+        while (burst.size() < traffic.burstBytes) {
+            if (lineIndex % static_cast<size_t>(traffic.probeEvery) == 0) {
+                burst += "#P" + timestamp + '#';
+            }
+            burst += lines[lineIndex++ % lines.size()];
+            burst += '\n';
+        }
+
+        if (!writeAll(fd, burst, stop)) {
+            break;
+        }
+        total += static_cast<qint64>(burst.size());
+        written.store(total, std::memory_order_relaxed);
+
+        if (traffic.bytesPerSecond) {
+            const auto due = start + static_cast<int64_t>(static_cast<double>(total) * 1e9 / static_cast<double>(traffic.bytesPerSecond));
+            std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::nanoseconds(due)));
+        }
+    }
+}
+
+// Write times of all complete probes in `text`. Probes cut in half by a chunk boundary are
+// skipped, they can't be told apart from a truncated number otherwise.
+template <typename Callback>
+void forEachProbe(const QString& text, Callback callback)
+{
+    qsizetype pos = 0;
+    while ((pos = text.indexOf(QLatin1String("#P"), pos)) >= 0) {
+        pos += 2;
+        int64_t timestamp {};
+        auto end = pos;
+        while (end < text.size() && text[end].isDigit()) {
+            timestamp = timestamp * 10 + text[end].digitValue();
+            end++;
+        }
+        if (end > pos && end < text.size() && text[end] == '#') {
+            callback(timestamp);
+        }
+        pos = end;
+    }
+}
+
+double percentile(const std::vector<int64_t>& sorted, const double p)
+{
+    if (sorted.empty()) {
+        return 0;
+    }
+    const auto index = static_cast<size_t>(p / 100 * static_cast<double>(sorted.size() - 1));
+    return static_cast<double>(sorted[index]) / 1e6;
+}
+
+qint64 positiveValue(const QCommandLineParser& parser, const QString& name, const bool allowZero = false)
+{
+    bool ok {};
+    const auto value = parser.value(name).toLongLong(&ok);
+    if (!ok || value < 0 || (!value && !allowZero)) {
+        throw std::invalid_argument("Invalid --" + name.toStdString() + ": " + parser.value(name).toStdString());
+    }
+    return value;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    bool show {};
+    for (int i = 1; i < argc; i++) {
+        show |= !strcmp(argv[i], "--show");
+    }
+    if (!show && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    QApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Measures throughput and latency of the capture path through a pseudo terminal.");
+    parser.addHelpOption();
+    parser.addOption({ "mib", "Write <size> MiB in total.", "size", "256" });
+    parser.addOption({ "rate", "Write at most <bytes> per second, 0 for no limit.", "bytes", "0" });
+    parser.addOption({ "burst", "Write in bursts of <bytes>.", "bytes", "4096" });
+    parser.addOption({ "line-min", "Shortest line, in bytes.", "bytes", "20" });
+    parser.addOption({ "line-max", "Longest line, in bytes.", "bytes", "160" });
+    parser.addOption({ "nul-percent", "Chance of every byte to be a NUL.", "percent", "0" });
+    parser.addOption({ "trigger-percent", "Chance of every line to contain the trigger keyword.", "percent", "1" });
+    parser.addOption({ "trigger", "Trigger keyword.", "keyword", "ERROR" });
+    parser.addOption({ "probe-every", "Put a write timestamp on every <n>th line.", "n", "64" });
+    parser.addOption({ "scrollback", "Keep at most <lines> in the document, 0 for no limit.", "lines", "100000" });
+    parser.addOption({ "archive", "Stream archives to <directory> while capturing.", "directory" });
+    parser.addOption({ "rotate-mib", "Start a new archive every <size> MiB.", "size", "64" });
+    parser.addOption({ "window", "Read through <window>: main, or multi for a MultiPortWindow. Only multi takes --trigger, --scrollback and --archive.", "window", "main" });
+    parser.addOption({ "show", "Show the window instead of rendering offscreen." });
+    parser.process(app);
+
+    Traffic traffic;
+    PortCapture::Options options;
+    int scrollback {};
+    try {
+        traffic.totalBytes = positiveValue(parser, "mib") * 1024 * 1024;
+        traffic.bytesPerSecond = positiveValue(parser, "rate", true);
+        traffic.burstBytes = static_cast<size_t>(positiveValue(parser, "burst"));
+        traffic.lineMin = static_cast<int>(positiveValue(parser, "line-min"));
+        traffic.lineMax = static_cast<int>(positiveValue(parser, "line-max"));
+        traffic.nulPercent = static_cast<unsigned>(positiveValue(parser, "nul-percent", true));
+        traffic.triggerPercent = static_cast<unsigned>(positiveValue(parser, "trigger-percent", true));
+        traffic.probeEvery = static_cast<int>(positiveValue(parser, "probe-every"));
+        traffic.keyword = parser.value("trigger").toStdString();
+        scrollback = static_cast<int>(positiveValue(parser, "scrollback", true));
+        options.archiveDirectory = parser.value("archive");
+        options.rotateMiB = static_cast<int>(positiveValue(parser, "rotate-mib"));
+        if (traffic.lineMax < traffic.lineMin) {
+            throw std::invalid_argument("--line-max is smaller than --line-min");
+        }
+        if (traffic.keyword.empty() || traffic.keyword.find('#') != std::string::npos) {
+            throw std::invalid_argument("Invalid --trigger");
+        }
+        if (parser.value("window") != "main" && parser.value("window") != "multi") {
+            throw std::invalid_argument("Invalid --window: " + parser.value("window").toStdString());
+        }
+        if (parser.value("window") == "main" && (parser.isSet("trigger") || parser.isSet("scrollback") || parser.isSet("archive"))) {
+            throw std::invalid_argument("--trigger, --scrollback and --archive need --window multi, MainWindow takes them from its dialogs");
+        }
+    } catch (const std::exception& e) {
+        fprintf(stderr, "Error: %s\n", e.what());
+        return EXIT_FAILURE;
+    }
+
+    int master {}, slave {};
+    if (openpty(&master, &slave, nullptr, nullptr, nullptr) < 0) {
+        perror("openpty");
+        return EXIT_FAILURE;
+    }
+    // Raw from the start, or the line discipline would mangle whatever is written before the
+    // reader has configured the port
+    termios tio {};
+    tcgetattr(slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+    options.port = ttyname(slave);
+    options.baud = 115200;
+    options.triggers = { { traffic.keyword, false } };
+
+    std::unique_ptr<QMainWindow> window;
+    if (parser.value("window") == "main") {
+        window = std::make_unique<MainWindow>(options.port, options.baud);
+    } else {
+        window = std::make_unique<MultiPortWindow>(std::vector { options }, scrollback);
+    }
+    window->show();
+    auto* doc = window->findChild<KTextEditor::Document*>();
+    // Null for MainWindow
+    auto* capture = window->findChild<PortCapture*>();
+
+    std::vector<std::pair<int64_t, int64_t>> latencies; // When the probe became visible, latency
+    std::vector<std::pair<int64_t, int64_t>> stalls; // When the stall ended, length
+    std::vector<std::pair<int64_t, QString>> rotations;
+    latencies.reserve(static_cast<size_t>(traffic.totalBytes / traffic.lineMin / traffic.probeEvery) + 1);
+    qint64 visibleBytes {};
+    int64_t lastVisible {};
+
+    QObject::connect(doc, &KTextEditor::Document::textInsertedRange, &app, [&](KTextEditor::Document*, const KTextEditor::Range& range) {
+        const auto text = doc->text(range);
+        const auto timestamp = LineTimestamps::now();
+        visibleBytes += text.size();
+        lastVisible = timestamp;
+        forEachProbe(text, [&](const int64_t writeTime) { latencies.emplace_back(timestamp, timestamp - writeTime); });
+    });
+    if (capture) {
+        QObject::connect(capture, &PortCapture::fileWritten, &app, [&](const QString& filename) { rotations.emplace_back(LineTimestamps::now(), filename); }, Qt::QueuedConnection);
+    }
+
+    // Measures how late the event loop gets around to a 1 ms timer
+    QTimer heartbeat;
+    heartbeat.setTimerType(Qt::PreciseTimer);
+    auto lastBeat = LineTimestamps::now();
+    QObject::connect(&heartbeat, &QTimer::timeout, &app, [&]() {
+        const auto timestamp = LineTimestamps::now();
+        if (timestamp - lastBeat > STALL_THRESHOLD_NS) {
+            stalls.emplace_back(timestamp, timestamp - lastBeat);
+        }
+        lastBeat = timestamp;
+    });
+    heartbeat.start(1);
+
+    std::atomic<qint64> written {};
+    std::atomic_bool writerDone {}, stopWriter {};
+    const auto start = LineTimestamps::now();
+    std::thread writer([&]() {
+        writeTraffic(master, traffic, written, stopWriter);
+        writerDone = true;
+    });
+
+    bool complete {};
+    int64_t drainStart {};
+    qint64 lastReported {};
+    QTimer progress;
+    QObject::connect(&progress, &QTimer::timeout, &app, [&]() {
+        const auto total = written.load(std::memory_order_relaxed);
+        if (writerDone && visibleBytes >= total) {
+            complete = true;
+            app.quit();
+            return;
+        }
+        if (writerDone) {
+            drainStart = drainStart ? drainStart : LineTimestamps::now();
+            if (LineTimestamps::now() - drainStart > DRAIN_TIMEOUT_NS) {
+                app.quit();
+                return;
+            }
+        }
+        if (total / (64 * 1024 * 1024) != lastReported) {
+            lastReported = total / (64 * 1024 * 1024);
+            fprintf(stderr, "written %lld MiB, visible %lld MiB\n", static_cast<long long>(total >> 20), static_cast<long long>(visibleBytes >> 20));
+        }
+    });
+    progress.start(100);
+
+    app.exec();
+
+    stopWriter = true;
+    writer.join();
+    window.reset();
+    close(master);
+    close(slave);
+
+    rusage usage {};
+    getrusage(RUSAGE_SELF, &usage);
+
+    const auto seconds = static_cast<double>(lastVisible - start) / 1e9;
+    std::vector<int64_t> sorted(latencies.size());
+    std::transform(latencies.begin(), latencies.end(), sorted.begin(), [](const auto& l) { return l.second; });
+    std::sort(sorted.begin(), sorted.end());
+
+    printf("Traffic: %lld MiB, lines of %d-%d bytes, %u%% NUL, %u%% triggers, bursts of %zu bytes, ",
+        static_cast<long long>(traffic.totalBytes >> 20), traffic.lineMin, traffic.lineMax, traffic.nulPercent, traffic.triggerPercent, traffic.burstBytes);
+    if (traffic.bytesPerSecond) {
+        printf("%.1f MB/s\n", static_cast<double>(traffic.bytesPerSecond) / 1e6);
+    } else {
+        printf("unlimited rate\n");
+    }
+    if (!complete) {
+        printf("INCOMPLETE: only %lld of %lld bytes became visible\n", static_cast<long long>(visibleBytes), static_cast<long long>(written.load()));
+    }
+    printf("Sustained:  %8.1f MB/s (%lld MiB in %.2f s)\n", seconds > 0 ? static_cast<double>(visibleBytes) / 1e6 / seconds : 0.0,
+        static_cast<long long>(visibleBytes >> 20), seconds);
+    printf("Latency (%zu probes, write to visible in document):\n", sorted.size());
+    printf("  p50 %8.2f ms  p90 %8.2f ms  p99 %8.2f ms  p99.9 %8.2f ms  max %8.2f ms\n",
+        percentile(sorted, 50), percentile(sorted, 90), percentile(sorted, 99), percentile(sorted, 99.9), percentile(sorted, 100));
+
+    int64_t maxStall {};
+    for (const auto& stall : stalls) {
+        maxStall = std::max(maxStall, stall.second);
+    }
+    printf("Event loop stalls over %lld ms: %zu, longest %.2f ms\n", static_cast<long long>(STALL_THRESHOLD_NS / 1'000'000), stalls.size(), static_cast<double>(maxStall) / 1e6);
+    printf("Peak RSS:   %8.1f MiB\n", static_cast<double>(usage.ru_maxrss) / 1024);
+
+    if (!options.archiveDirectory.isEmpty()) {
+        printf("Rotations: %zu\n", rotations.size());
+        for (const auto& [timestamp, filename] : rotations) {
+            int64_t rotationStall {}, rotationLatency {};
+            for (const auto& stall : stalls) {
+                if (std::abs(stall.first - timestamp) < ROTATION_WINDOW_NS) {
+                    rotationStall = std::max(rotationStall, stall.second);
+                }
+            }
+            for (const auto& latency : latencies) {
+                if (std::abs(latency.first - timestamp) < ROTATION_WINDOW_NS) {
+                    rotationLatency = std::max(rotationLatency, latency.second);
+                }
+            }
+            printf("  %s: stall %.2f ms, max latency %.2f ms\n", qPrintable(filename),
+                static_cast<double>(rotationStall) / 1e6, static_cast<double>(rotationLatency) / 1e6);
+        }
+    }
+
+    return complete ? EXIT_SUCCESS : EXIT_FAILURE;
+}
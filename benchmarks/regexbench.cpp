@@ -0,0 +1,116 @@
+// Compares the streaming trigger engine against QRegularExpression on the same input.
+// Usage: regexbench [MiB]
+
+#include "lineframer.h"
+#include "triggerengine.h"
+
+#include <QElapsedTimer>
+#include <QRegularExpression>
+#include <QString>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string makeInput(const size_t size)
+{
+    static const char* const messages[] = {
+        "I (1234) wifi: connected to ap, rssi=-61",
+        "W (2345) sensor: temp=104 above threshold",
+        "E (3456) app: ERR42 while flushing queue",
+        "D (4567) spi: transfer done len=4096",
+        "I (5678) heap: free=182344 min=170112",
+        "E (6789) watchdog: task wdt triggered, temp=187",
+        "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaac",
+    };
+
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<size_t> pick(0, std::size(messages) - 1);
+
+    std::string input;
+    input.reserve(size + 128);
+    while (input.size() < size) {
+        input += messages[pick(rng)];
+        input += '\n';
+    }
+    return input;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    const size_t mib = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 64;
+    auto input = makeInput(mib * 1024 * 1024);
+
+    const std::vector<std::string> patterns = {
+        "ERR[0-9]+",
+        "temp=1[0-9]{2}",
+        "^E \\([0-9]+\\) watchdog",
+        "rssi=-[89][0-9]",
+        "(a+)+b",
+    };
+
+    // Streaming engine, fed in 64 KiB chunks like the serial reader does
+    std::vector<TriggerPattern> triggers;
+    for (const auto& p : patterns) {
+        triggers.push_back({ p, true });
+    }
+    TriggerEngine engine;
+    engine.setTriggers(triggers);
+    LineFramer framer;
+
+    QElapsedTimer timer;
+    timer.start();
+    constexpr size_t CHUNK = 64 * 1024;
+    for (size_t offset = 0; offset < input.size(); offset += CHUNK) {
+        const auto len = std::min(CHUNK, input.size() - offset);
+        framer.frame(input.data() + offset, len);
+        engine.scan(input.data() + offset, len, framer.newlines(), [](const size_t) { });
+    }
+    const auto engineNs = timer.nsecsElapsed();
+
+    // QRegularExpression, matched line by line
+    std::vector<QRegularExpression> qregexes;
+    for (const auto& p : patterns) {
+        qregexes.emplace_back(QString::fromStdString(p));
+        qregexes.back().optimize();
+    }
+    std::vector<uint64_t> qCounts(patterns.size());
+
+    timer.restart();
+    size_t lineStart = 0;
+    while (lineStart < input.size()) {
+        auto lineEnd = input.find('\n', lineStart);
+        if (lineEnd == std::string::npos) {
+            lineEnd = input.size();
+        }
+        const auto line = QString::fromUtf8(input.data() + lineStart, static_cast<qsizetype>(lineEnd - lineStart));
+        for (size_t i = 0; i < qregexes.size(); i++) {
+            if (qregexes[i].match(line).hasMatch()) {
+                qCounts[i]++;
+            }
+        }
+        lineStart = lineEnd + 1;
+    }
+    const auto qtNs = timer.nsecsElapsed();
+
+    const auto mbps = [&](const qint64 ns) { return static_cast<double>(input.size()) / 1e6 / (static_cast<double>(ns) / 1e9); };
+
+    printf("%-28s %12s %12s\n", "pattern", "engine", "QRegExp");
+    for (size_t i = 0; i < patterns.size(); i++) {
+        printf("%-28s %12llu %12llu\n", patterns[i].c_str(),
+            static_cast<unsigned long long>(engine.matchCount(i)),
+            static_cast<unsigned long long>(qCounts[i]));
+    }
+    printf("\nInput: %zu MiB\n", mib);
+    printf("TriggerEngine:      %8.1f ms %8.1f MB/s\n", static_cast<double>(engineNs) / 1e6, mbps(engineNs));
+    printf("QRegularExpression: %8.1f ms %8.1f MB/s\n", static_cast<double>(qtNs) / 1e6, mbps(qtNs));
+
+    return EXIT_SUCCESS;
+}
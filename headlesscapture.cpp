@@ -0,0 +1,113 @@
+#include "headlesscapture.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QLocale>
+#include <QThread>
+#include <QTimer>
+
+#include <cstdio>
+
+static void printLine(const QString& line)
+{
+    // Called from the archive writer threads as well, stdio streams are locked
+    const auto utf8 = QString("%1 %2\n").arg(QDateTime::currentDateTime().toString(Qt::ISODateWithMs), line).toUtf8();
+    fwrite(utf8.constData(), 1, static_cast<size_t>(utf8.size()), stdout);
+    fflush(stdout);
+}
+
+HeadlessCapture::HeadlessCapture(const std::vector<PortCapture::Options>& ports, const int statsIntervalSeconds, QObject* parent)
+    : QObject(parent)
+    , ioThread(new QThread(this))
+    , statsTimer(new QTimer(this))
+    , statsInterval(statsIntervalSeconds)
+{
+    ioThread->setObjectName("SerialIO");
+    ioThread->start(QThread::TimeCriticalPriority);
+
+    try {
+        for (const auto& port : ports) {
+            auto* capture = new PortCapture(port, ioThread, this);
+            const auto name = port.port;
+            connect(capture, &PortCapture::connected, this, [name, baud = port.baud]() {
+                printLine(QString("%1: Connected at %2").arg(name).arg(baud));
+            });
+            connect(capture, &PortCapture::errorOccurred, this, [name](const QString& msg) {
+                printLine(QString("%1: %2").arg(name, msg));
+            });
+            connect(capture, &PortCapture::serialErrors, this, [name, capture](const SerialErrorCounts& counts) {
+                printLine(QString("%1: Serial errors after line %2: %3").arg(name).arg(capture->totalLines() + 1).arg(counts.toString()));
+            });
+            connect(capture, &PortCapture::triggerMatched, this, [name](const QStringList& matches) {
+                printLine(QString("%1: Trigger %2").arg(name, matches.join(" │ ")));
+            });
+            // Direct, so that the archives closed on exit are reported too
+            connect(
+                capture, &PortCapture::fileWritten, this, [name](const QString& filename, const qint64 uncompressedSize, const qint64 compressedSize) {
+                    printLine(QString("%1: Archived %2: %3 -> %4").arg(name, filename, QLocale().formattedDataSize(uncompressedSize), QLocale().formattedDataSize(compressedSize)));
+                },
+                Qt::DirectConnection);
+            connect(
+                capture, &PortCapture::archiveErrorOccurred, this, [name](const QString& msg) {
+                    printLine(QString("%1: Failed to write archive: %2").arg(name, msg));
+                },
+                Qt::DirectConnection);
+            captures.push_back(capture);
+        }
+    } catch (...) {
+        for (auto* capture : captures) {
+            delete capture;
+        }
+        ioThread->quit();
+        ioThread->wait();
+        throw;
+    }
+
+    statsStartBytes.resize(captures.size());
+    connect(statsTimer, &QTimer::timeout, this, &HeadlessCapture::handleStatsTimer);
+}
+
+HeadlessCapture::~HeadlessCapture()
+{
+    if (statsInterval > 0) {
+        handleStatsTimer();
+    }
+    for (auto* capture : captures) {
+        delete capture;
+    }
+    captures.clear();
+    ioThread->quit();
+    ioThread->wait();
+}
+
+void HeadlessCapture::start()
+{
+    elapsedTimer.start();
+    statsStartTime = 0;
+
+    qInfo() << "Headless capture of" << captures.size() << "ports";
+    for (auto* capture : captures) {
+        capture->start();
+    }
+    if (statsInterval > 0) {
+        statsTimer->start(statsInterval * 1000);
+    }
+}
+
+void HeadlessCapture::handleStatsTimer()
+{
+    const auto now = elapsedTimer.elapsed();
+    const auto interval = std::max<qint64>(1, now - statsStartTime);
+    const QLocale locale;
+    for (size_t i = 0; i < captures.size(); i++) {
+        const auto* capture = captures[i];
+        printLine(QString("%1: Stats: %2 received, %3 lines, %4/s, %5 buffered")
+                      .arg(capture->options().port,
+                          locale.formattedDataSize(capture->totalBytes()),
+                          QString::number(capture->totalLines()),
+                          locale.formattedDataSize((capture->totalBytes() - statsStartBytes[i]) * 1000 / interval),
+                          locale.formattedDataSize(static_cast<qint64>(capture->bufferedBytes()))));
+        statsStartBytes[i] = capture->totalBytes();
+    }
+    statsStartTime = now;
+}
@@ -0,0 +1,42 @@
+#ifndef HEADLESSCAPTURE_H
+#define HEADLESSCAPTURE_H
+
+#include "portcapture.h"
+
+#include <QElapsedTimer>
+#include <QObject>
+
+#include <vector>
+
+class QThread;
+class QTimer;
+
+// Captures one or more serial ports without a GUI. All ports are read on a single I/O thread.
+// Trigger hits, archive rotations and periodic stats are printed to stdout, everything else goes
+// to the log.
+class HeadlessCapture : public QObject {
+    Q_OBJECT
+
+public:
+    // Throws std::invalid_argument if one of the triggers can't be compiled
+    HeadlessCapture(const std::vector<PortCapture::Options>& ports, const int statsIntervalSeconds, QObject* parent = nullptr);
+    // Closes the ports and finishes the current archives
+    ~HeadlessCapture();
+
+    void start();
+
+private slots:
+    void handleStatsTimer();
+
+private:
+    QThread* ioThread {};
+    std::vector<PortCapture*> captures {};
+
+    QTimer* statsTimer {};
+    const int statsInterval {};
+    QElapsedTimer elapsedTimer;
+    qint64 statsStartTime {};
+    std::vector<qint64> statsStartBytes {};
+};
+
+#endif // HEADLESSCAPTURE_H
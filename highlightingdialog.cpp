@@ -0,0 +1,77 @@
+#include "highlightingdialog.h"
+
+#include "ui_highlightingdialog.h"
+
+#include <QIntValidator>
+#include <QPushButton>
+
+HighlightingDialog::HighlightingDialog(QWidget* parent)
+    : QDialog(parent)
+    , ui(new Ui::HighlightingDialog)
+{
+    ui->setupUi(this);
+
+    ui->simpleRateLineEdit->setText(QString::number(simpleRateKiB));
+    ui->plainRateLineEdit->setText(QString::number(plainRateKiB));
+    ui->simpleSizeLineEdit->setText(QString::number(simpleSizeMiB));
+    ui->plainSizeLineEdit->setText(QString::number(plainSizeMiB));
+
+    for (auto* lineEdit : { ui->simpleRateLineEdit, ui->plainRateLineEdit }) {
+        connect(lineEdit, &QLineEdit::textChanged, this, &HighlightingDialog::onInputChanged);
+        lineEdit->setValidator(new QIntValidator(1, 1024 * 1024, this));
+    }
+    for (auto* lineEdit : { ui->simpleSizeLineEdit, ui->plainSizeLineEdit }) {
+        connect(lineEdit, &QLineEdit::textChanged, this, &HighlightingDialog::onInputChanged);
+        lineEdit->setValidator(new QIntValidator(1, 64 * 1024, this));
+    }
+
+    onInputChanged();
+}
+
+HighlightingDialog::~HighlightingDialog()
+{
+    delete ui;
+}
+
+bool HighlightingDialog::isAdaptive() const
+{
+    return ui->groupBox->isChecked();
+}
+
+AdaptiveHighlighting::Thresholds HighlightingDialog::getThresholds() const
+{
+    AdaptiveHighlighting::Thresholds thresholds;
+    thresholds.simpleRate = static_cast<qint64>(simpleRateKiB) * 1024;
+    thresholds.plainRate = static_cast<qint64>(plainRateKiB) * 1024;
+    thresholds.simpleDocumentSize = static_cast<qint64>(simpleSizeMiB) * 1024 * 1024;
+    thresholds.plainDocumentSize = static_cast<qint64>(plainSizeMiB) * 1024 * 1024;
+    return thresholds;
+}
+
+void HighlightingDialog::onInputChanged()
+{
+    bool simpleRateOk {}, plainRateOk {}, simpleSizeOk {}, plainSizeOk {};
+
+    simpleRateKiB = ui->simpleRateLineEdit->text().toInt(&simpleRateOk);
+    plainRateKiB = ui->plainRateLineEdit->text().toInt(&plainRateOk);
+    simpleSizeMiB = ui->simpleSizeLineEdit->text().toInt(&simpleSizeOk);
+    plainSizeMiB = ui->plainSizeLineEdit->text().toInt(&plainSizeOk);
+
+    const auto acceptable = ui->simpleRateLineEdit->hasAcceptableInput() && ui->plainRateLineEdit->hasAcceptableInput()
+        && ui->simpleSizeLineEdit->hasAcceptableInput() && ui->plainSizeLineEdit->hasAcceptableInput();
+    if (!simpleRateOk || !plainRateOk || !simpleSizeOk || !plainSizeOk || !acceptable) {
+        ui->buttonBox->button(QDialogButtonBox::StandardButton::Ok)->setEnabled(false);
+        return;
+    }
+    // Plain text has to be the last step
+    if (plainRateKiB < simpleRateKiB || plainSizeMiB < simpleSizeMiB) {
+        ui->buttonBox->button(QDialogButtonBox::StandardButton::Ok)->setEnabled(false);
+        ui->msgLabel->setText(QStringLiteral("The plain text thresholds can't be below the simple highlighting ones"));
+        return;
+    }
+    ui->buttonBox->button(QDialogButtonBox::StandardButton::Ok)->setEnabled(true);
+
+    ui->msgLabel->setText(QStringLiteral("yeTTY will switch to simple highlighting above %1 KiB/s or %2 MiB"
+                                         " and to plain text above %3 KiB/s or %4 MiB, and back once the data slows down")
+                              .arg(QString::number(simpleRateKiB), QString::number(simpleSizeMiB), QString::number(plainRateKiB), QString::number(plainSizeMiB)));
+}
@@ -0,0 +1,33 @@
+#ifndef HIGHLIGHTINGDIALOG_H
+#define HIGHLIGHTINGDIALOG_H
+
+#include "adaptivehighlighting.h"
+
+#include <QDialog>
+
+namespace Ui {
+class HighlightingDialog;
+}
+
+class HighlightingDialog : public QDialog {
+    Q_OBJECT
+
+public:
+    explicit HighlightingDialog(QWidget* parent = nullptr);
+    ~HighlightingDialog();
+
+    bool isAdaptive() const;
+    AdaptiveHighlighting::Thresholds getThresholds() const;
+
+private slots:
+    void onInputChanged();
+
+private:
+    Ui::HighlightingDialog* ui;
+    int simpleRateKiB = 256;
+    int plainRateKiB = 2048;
+    int simpleSizeMiB = 64;
+    int plainSizeMiB = 256;
+};
+
+#endif // HIGHLIGHTINGDIALOG_H
@@ -0,0 +1,148 @@
+#include "largefileview.h"
+#include "mappedlogfile.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFontDatabase>
+#include <QKeyEvent>
+#include <QPainter>
+#include <QScrollBar>
+
+#include <climits>
+
+LargeFileView::LargeFileView(const QString& path, QWidget* parent)
+    : QAbstractScrollArea(parent)
+    , file(std::make_unique<MappedLogFile>(path.toStdString()))
+{
+    setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    viewport()->setBackgroundRole(QPalette::Base);
+    viewport()->setAutoFillBackground(true);
+    setFocusPolicy(Qt::StrongFocus);
+
+    updateScrollBars();
+
+    if (file->isFullyIndexed()) {
+        return;
+    }
+
+    indexThread = std::thread([this]() {
+        QElapsedTimer timer;
+        timer.start();
+        auto index = std::make_shared<MappedLogFile::Index>(file->buildIndex(cancelIndexing));
+        if (cancelIndexing) {
+            return;
+        }
+        qInfo() << "Indexed" << file->size() << "bytes in" << timer.elapsed() << "ms";
+
+        QMetaObject::invokeMethod(
+            this, [this, index]() {
+                file->setIndex(std::move(*index));
+                updateScrollBars();
+                viewport()->update();
+                emit indexReady();
+            },
+            Qt::QueuedConnection);
+    });
+}
+
+LargeFileView::~LargeFileView()
+{
+    cancelIndexing = true;
+    if (indexThread.joinable()) {
+        indexThread.join();
+    }
+}
+
+qint64 LargeFileView::fileSize() const
+{
+    return static_cast<qint64>(file->size());
+}
+
+qint64 LargeFileView::lineCount() const
+{
+    return static_cast<qint64>(file->lineCount());
+}
+
+bool LargeFileView::isFullyIndexed() const
+{
+    return file->isFullyIndexed();
+}
+
+int LargeFileView::visibleLines() const
+{
+    return std::max(1, viewport()->height() / fontMetrics().lineSpacing());
+}
+
+void LargeFileView::updateScrollBars()
+{
+    const auto lines = static_cast<qint64>(file->lineCount());
+    const auto maxFirstLine = std::max<qint64>(0, lines - visibleLines());
+
+    // QScrollBar is int based. Files with more than 2^31 lines can't be scrolled to the very end.
+    verticalScrollBar()->setRange(0, static_cast<int>(std::min<qint64>(maxFirstLine, INT_MAX)));
+    verticalScrollBar()->setPageStep(visibleLines());
+    verticalScrollBar()->setSingleStep(1);
+
+    horizontalScrollBar()->setRange(0, std::max(0, maxLineWidth - viewport()->width()));
+    horizontalScrollBar()->setPageStep(viewport()->width());
+}
+
+void LargeFileView::paintEvent(QPaintEvent* /*event*/)
+{
+    QPainter painter(viewport());
+    painter.setPen(palette().color(QPalette::Text));
+
+    const auto metrics = fontMetrics();
+    const auto lineSpacing = metrics.lineSpacing();
+    const auto firstLine = static_cast<uint64_t>(verticalScrollBar()->value());
+    const auto xOffset = -horizontalScrollBar()->value();
+
+    int widest = maxLineWidth;
+    for (int row = 0; row <= visibleLines(); row++) {
+        const auto line = file->line(firstLine + static_cast<uint64_t>(row));
+        auto text = QString::fromUtf8(line.data(), std::min<qsizetype>(static_cast<qsizetype>(line.size()), MAX_PAINTED_LINE));
+        text.replace(QChar('\0'), QChar(' '));
+
+        const auto y = row * lineSpacing + metrics.ascent();
+        painter.drawText(xOffset, y, text);
+        widest = std::max(widest, metrics.horizontalAdvance(text));
+    }
+
+    if (widest > maxLineWidth) {
+        maxLineWidth = widest;
+        horizontalScrollBar()->setRange(0, std::max(0, maxLineWidth - viewport()->width()));
+    }
+}
+
+void LargeFileView::resizeEvent(QResizeEvent* event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+    updateScrollBars();
+}
+
+void LargeFileView::keyPressEvent(QKeyEvent* event)
+{
+    auto* scrollBar = verticalScrollBar();
+    switch (event->key()) {
+    case Qt::Key_Up:
+        scrollBar->triggerAction(QAbstractSlider::SliderSingleStepSub);
+        break;
+    case Qt::Key_Down:
+        scrollBar->triggerAction(QAbstractSlider::SliderSingleStepAdd);
+        break;
+    case Qt::Key_PageUp:
+        scrollBar->triggerAction(QAbstractSlider::SliderPageStepSub);
+        break;
+    case Qt::Key_PageDown:
+        scrollBar->triggerAction(QAbstractSlider::SliderPageStepAdd);
+        break;
+    case Qt::Key_Home:
+        scrollBar->triggerAction(QAbstractSlider::SliderToMinimum);
+        break;
+    case Qt::Key_End:
+        scrollBar->triggerAction(QAbstractSlider::SliderToMaximum);
+        break;
+    default:
+        QAbstractScrollArea::keyPressEvent(event);
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef LARGEFILEVIEW_H
+#define LARGEFILEVIEW_H
+
+#include <QAbstractScrollArea>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+class MappedLogFile;
+
+// Read-only viewer for log files too large to load into a KTextEditor document. The file is
+// memory mapped and only the visible lines are decoded and painted. The line index is built in
+// the background; until it is done only the start of the file can be scrolled through.
+class LargeFileView : public QAbstractScrollArea {
+    Q_OBJECT
+
+public:
+    // Throws std::runtime_error if the file can't be opened
+    explicit LargeFileView(const QString& path, QWidget* parent = nullptr);
+    ~LargeFileView();
+
+    [[nodiscard]] qint64 fileSize() const;
+    [[nodiscard]] qint64 lineCount() const;
+    [[nodiscard]] bool isFullyIndexed() const;
+
+signals:
+    void indexReady();
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
+    void keyPressEvent(QKeyEvent* event) override;
+
+private:
+    std::unique_ptr<MappedLogFile> file;
+    std::thread indexThread {};
+    std::atomic_bool cancelIndexing {};
+    int maxLineWidth {};
+
+    // Lines longer than this are cut off when painting
+    static inline constexpr qsizetype MAX_PAINTED_LINE = 4096;
+
+    void updateScrollBars();
+    [[nodiscard]] int visibleLines() const;
+};
+
+#endif // LARGEFILEVIEW_H
@@ -0,0 +1,117 @@
+#include "lineframer.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define LINEFRAMER_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+void frameScalar(char* data, const size_t len, std::vector<uint32_t>& newlines)
+{
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] == '\0') {
+            data[i] = ' ';
+        } else if (data[i] == '\n') {
+            newlines.push_back(static_cast<uint32_t>(i));
+        }
+    }
+}
+
+#ifdef LINEFRAMER_X86
+
+inline void collectNewlines(uint32_t mask, const size_t base, std::vector<uint32_t>& newlines)
+{
+    while (mask) {
+        newlines.push_back(static_cast<uint32_t>(base) + static_cast<uint32_t>(__builtin_ctz(mask)));
+        mask &= mask - 1;
+    }
+}
+
+__attribute__((target("sse2"))) void frameSse2(char* data, const size_t len, std::vector<uint32_t>& newlines)
+{
+    const auto zero = _mm_setzero_si128();
+    const auto newline = _mm_set1_epi8('\n');
+    const auto space = _mm_set1_epi8(' ');
+
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        auto* p = reinterpret_cast<__m128i*>(data + i);
+        const auto v = _mm_loadu_si128(p);
+
+        const auto isNul = _mm_cmpeq_epi8(v, zero);
+        if (_mm_movemask_epi8(isNul)) {
+            // NUL bytes are 0, so OR-ing in a space only changes them
+            _mm_storeu_si128(p, _mm_or_si128(v, _mm_and_si128(isNul, space)));
+        }
+        collectNewlines(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline))), i, newlines);
+    }
+
+    const auto tailStart = newlines.size();
+    frameScalar(data + i, len - i, newlines);
+    for (auto j = tailStart; j < newlines.size(); j++) {
+        newlines[j] += static_cast<uint32_t>(i);
+    }
+}
+
+__attribute__((target("avx2"))) void frameAvx2(char* data, const size_t len, std::vector<uint32_t>& newlines)
+{
+    const auto zero = _mm256_setzero_si256();
+    const auto newline = _mm256_set1_epi8('\n');
+    const auto space = _mm256_set1_epi8(' ');
+
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        auto* p = reinterpret_cast<__m256i*>(data + i);
+        const auto v = _mm256_loadu_si256(p);
+
+        const auto isNul = _mm256_cmpeq_epi8(v, zero);
+        if (_mm256_movemask_epi8(isNul)) {
+            _mm256_storeu_si256(p, _mm256_or_si256(v, _mm256_and_si256(isNul, space)));
+        }
+        collectNewlines(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, newline))), i, newlines);
+    }
+
+    const auto tailStart = newlines.size();
+    frameSse2(data + i, len - i, newlines);
+    for (auto j = tailStart; j < newlines.size(); j++) {
+        newlines[j] += static_cast<uint32_t>(i);
+    }
+}
+
+#endif
+
+}
+
+LineFramer::LineFramer()
+    : frameFunc(frameScalar)
+{
+#ifdef LINEFRAMER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        frameFunc = frameAvx2;
+    } else if (__builtin_cpu_supports("sse2")) {
+        frameFunc = frameSse2;
+    }
+#endif
+}
+
+void LineFramer::frame(char* data, const size_t len)
+{
+    // clear() keeps the capacity, so this doesn't allocate once warmed up
+    newlineOffsets.clear();
+    frameFunc(data, len, newlineOffsets);
+}
+
+const char* LineFramer::implementation() const
+{
+#ifdef LINEFRAMER_X86
+    if (frameFunc == frameAvx2) {
+        return "avx2";
+    }
+    if (frameFunc == frameSse2) {
+        return "sse2";
+    }
+#endif
+    return "scalar";
+}
@@ -0,0 +1,32 @@
+#ifndef LINEFRAMER_H
+#define LINEFRAMER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// First stage of the ingest path. In a single pass over each chunk it replaces '\0' with ' ' and
+// records the offsets of all the '\n' bytes. The resulting line index is reused by the later
+// stages (triggers, line accounting, ...) so that none of them has to walk the bytes again.
+//
+// Uses AVX2 or SSE2 when available and falls back to a scalar loop otherwise.
+class LineFramer {
+public:
+    LineFramer();
+
+    // Modifies `data` in place. The newline index stays valid until the next call.
+    void frame(char* data, const size_t len);
+
+    // Offsets of '\n' in the last framed chunk, in increasing order
+    [[nodiscard]] const std::vector<uint32_t>& newlines() const { return newlineOffsets; }
+
+    [[nodiscard]] const char* implementation() const;
+
+private:
+    using FrameFunc = void (*)(char* data, const size_t len, std::vector<uint32_t>& newlines);
+
+    FrameFunc frameFunc {};
+    std::vector<uint32_t> newlineOffsets {};
+};
+
+#endif // LINEFRAMER_H
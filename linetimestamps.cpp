@@ -0,0 +1,194 @@
+#include "linetimestamps.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+static void putVarint(std::vector<uint8_t>& out, uint64_t value)
+{
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+static uint64_t getVarint(const uint8_t*& pos, const uint8_t* end)
+{
+    uint64_t value {};
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (pos == end) {
+            throw std::runtime_error("Truncated varint");
+        }
+        const auto byte = *pos++;
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+    throw std::runtime_error("Varint too long");
+}
+
+static uint64_t zigzag(const int64_t value)
+{
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+static int64_t unzigzag(const uint64_t value)
+{
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+void LineTimestamps::append(const int64_t timestamp)
+{
+    if (!blockCount || blockAt(blockCount - 1).lines == BLOCK_LINES) {
+        auto& block = addBlock();
+        block.first = timestamp;
+        block.last = timestamp;
+        block.lines = 1;
+        // Keeps the capacity from the last time the block was used, so this only allocates for
+        // blocks that are new
+        block.deltas.clear();
+        block.deltas.reserve(BLOCK_LINES);
+    } else {
+        auto& block = blockAt(blockCount - 1);
+        putVarint(block.deltas, zigzag(timestamp - block.last));
+        block.last = timestamp;
+        block.lines++;
+    }
+    count++;
+}
+
+int64_t LineTimestamps::at(const size_t line) const
+{
+    const auto index = line + skipped;
+    const auto& block = blockAt(index / BLOCK_LINES);
+    auto value = block.first;
+    const auto* pos = block.deltas.data();
+    const auto* end = pos + block.deltas.size();
+    for (size_t i = 0; i < index % BLOCK_LINES; i++) {
+        value += unzigzag(getVarint(pos, end));
+    }
+    return value;
+}
+
+size_t LineTimestamps::memoryUsage() const
+{
+    // Includes the blocks kept for reuse
+    size_t bytes = blocks.capacity() * sizeof(Block);
+    for (const auto& block : blocks) {
+        bytes += block.deltas.capacity();
+    }
+    return bytes;
+}
+
+void LineTimestamps::removeFirst(size_t lines)
+{
+    lines = std::min(lines, count);
+    count -= lines;
+    if (!count) {
+        clear();
+        return;
+    }
+    skipped += lines;
+    while (skipped >= BLOCK_LINES) {
+        firstBlock = (firstBlock + 1) % blocks.size();
+        blockCount--;
+        skipped -= BLOCK_LINES;
+    }
+}
+
+void LineTimestamps::clear()
+{
+    blockCount = 0;
+    skipped = 0;
+    count = 0;
+}
+
+void LineTimestamps::squeeze()
+{
+    clear();
+    blocks = {};
+    firstBlock = 0;
+}
+
+LineTimestamps::Block& LineTimestamps::addBlock()
+{
+    if (blockCount == blocks.size()) {
+        // Full, unwrap the ring so that the new blocks go after the last one in use
+        std::rotate(blocks.begin(), blocks.begin() + static_cast<std::ptrdiff_t>(firstBlock), blocks.end());
+        firstBlock = 0;
+        blocks.emplace_back();
+        blocks.resize(blocks.capacity());
+    }
+    blockCount++;
+    return blockAt(blockCount - 1);
+}
+
+template <typename F>
+void LineTimestamps::forEach(const size_t from, F&& f) const
+{
+    auto index = from + skipped;
+    for (auto b = index / BLOCK_LINES; b < blockCount; b++) {
+        const auto& block = blockAt(b);
+        auto value = block.first;
+        const auto* pos = block.deltas.data();
+        const auto* end = pos + block.deltas.size();
+        for (size_t i = 0; i < block.lines; i++) {
+            if (i) {
+                value += unzigzag(getVarint(pos, end));
+            }
+            if (b * BLOCK_LINES + i >= index) {
+                f(value);
+            }
+        }
+    }
+}
+
+std::vector<uint8_t> LineTimestamps::serialize(const uint64_t lineOffset, const size_t from) const
+{
+    std::vector<uint8_t> out;
+    putVarint(out, SERIALIZATION_VERSION);
+    putVarint(out, lineOffset);
+    putVarint(out, from < count ? count - from : 0);
+
+    // Same encoding as in memory, the deltas don't change with the conversion
+    const auto offset = toWallClock(0);
+    int64_t previous {};
+    forEach(from, [&](const int64_t timestamp) {
+        const auto wallClock = timestamp + offset;
+        putVarint(out, zigzag(wallClock - previous));
+        previous = wallClock;
+    });
+    return out;
+}
+
+std::pair<uint64_t, LineTimestamps> LineTimestamps::deserialize(const uint8_t* data, const size_t len)
+{
+    const auto* pos = data;
+    const auto* end = data + len;
+    if (getVarint(pos, end) != SERIALIZATION_VERSION) {
+        throw std::runtime_error("Unsupported timestamp version");
+    }
+    const auto lineOffset = getVarint(pos, end);
+    const auto lines = getVarint(pos, end);
+
+    LineTimestamps timestamps;
+    int64_t value {};
+    for (uint64_t i = 0; i < lines; i++) {
+        value += unzigzag(getVarint(pos, end));
+        timestamps.append(value);
+    }
+    return { lineOffset, std::move(timestamps) };
+}
+
+int64_t LineTimestamps::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int64_t LineTimestamps::toWallClock(const int64_t timestamp)
+{
+    const auto wallClockNow = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    return wallClockNow - (now() - timestamp);
+}
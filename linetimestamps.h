@@ -0,0 +1,74 @@
+#ifndef LINETIMESTAMPS_H
+#define LINETIMESTAMPS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Receive time of every line, in nanoseconds on the monotonic clock. Stored column wise in
+// blocks of BLOCK_LINES: the first timestamp of a block is kept as is and the rest as zigzag
+// varint deltas to the previous line. Lines that arrive in the same read share a timestamp and
+// cost one byte, lines a millisecond apart three.
+//
+// Lines can only be added at the end and removed from the front, which is all the scrollback
+// needs. Looking up a line decodes at most one block. The blocks are kept in a ring: the ones
+// removed from the front are reused at the back along with the capacity of their deltas, so once
+// the scrollback is full appending doesn't allocate any more.
+class LineTimestamps {
+public:
+    void append(const int64_t timestamp);
+    // `line` must be less than size()
+    [[nodiscard]] int64_t at(const size_t line) const;
+    [[nodiscard]] size_t size() const { return count; }
+    [[nodiscard]] bool isEmpty() const { return count == 0; }
+    [[nodiscard]] size_t memoryUsage() const;
+
+    void removeFirst(size_t lines);
+    // Keeps the blocks for reuse
+    void clear();
+    // Like clear(), but also frees the blocks
+    void squeeze();
+
+    // For archives: the lines from `from` onwards, converted to wall clock time, preceded by
+    // `lineOffset`, the line number the first of them has in the archive.
+    [[nodiscard]] std::vector<uint8_t> serialize(const uint64_t lineOffset, const size_t from = 0) const;
+    // Returns the line offset and the wall clock timestamps. Throws std::runtime_error if the
+    // data is malformed.
+    [[nodiscard]] static std::pair<uint64_t, LineTimestamps> deserialize(const uint8_t* data, const size_t len);
+
+    // Current time on the clock used for the timestamps
+    [[nodiscard]] static int64_t now();
+    // Converts a timestamp taken with now() to nanoseconds since the epoch
+    [[nodiscard]] static int64_t toWallClock(const int64_t timestamp);
+
+private:
+    struct Block {
+        int64_t first {};
+        int64_t last {};
+        size_t lines {};
+        std::vector<uint8_t> deltas {};
+    };
+
+    static inline constexpr size_t BLOCK_LINES = 256;
+    static inline constexpr uint32_t SERIALIZATION_VERSION = 1;
+
+    std::vector<Block> blocks {};
+    // Index of the first block in use in `blocks` and how many are in use from there on, wrapping
+    // around the end
+    size_t firstBlock {};
+    size_t blockCount {};
+    // Lines already removed from the first block
+    size_t skipped {};
+    size_t count {};
+
+    [[nodiscard]] const Block& blockAt(const size_t block) const { return blocks[(firstBlock + block) % blocks.size()]; }
+    [[nodiscard]] Block& blockAt(const size_t block) { return blocks[(firstBlock + block) % blocks.size()]; }
+    // Reuses a block that isn't in use or makes room for more
+    Block& addBlock();
+
+    template <typename F>
+    void forEach(const size_t from, F&& f) const;
+};
+
+#endif // LINETIMESTAMPS_H
@@ -1,5 +1,6 @@
 #include "longtermrunmodedialog.h"
 
+#include "archivedictionary.h"
 #include "ui_longtermrunmodedialog.h"
 
 #include <QDebug>
@@ -23,6 +24,8 @@ LongTermRunModeDialog::LongTermRunModeDialog(QWidget* parent)
 
     ui->timeLineEdit->setText(QString::number(timeInMinutes));
     ui->memoryLineEdit->setText(QString::number(memoryInMiB));
+    ui->trainDictionaryLineEdit->setText(QString::number(dictionaryTrainingMiB));
+    ui->trainDictionaryLineEdit->setEnabled(false);
 
     ui->directoryLineEdit->setText(directoryStr);
 
@@ -33,9 +36,14 @@ LongTermRunModeDialog::LongTermRunModeDialog(QWidget* parent)
     connect(ui->timeLineEdit, &QLineEdit::textChanged, this, &LongTermRunModeDialog::onInputChanged);
     connect(ui->memoryLineEdit, &QLineEdit::textChanged, this, &LongTermRunModeDialog::onInputChanged);
     connect(ui->toolButton, &QToolButton::pressed, this, &LongTermRunModeDialog::onToolButton);
+    connect(ui->trainDictionaryLineEdit, &QLineEdit::textChanged, this, &LongTermRunModeDialog::onInputChanged);
+    connect(ui->trainDictionaryCheckBox, &QCheckBox::toggled, ui->trainDictionaryLineEdit, &QLineEdit::setEnabled);
+    connect(ui->trainDictionaryCheckBox, &QCheckBox::toggled, this, &LongTermRunModeDialog::onInputChanged);
+    connect(ui->dictionaryToolButton, &QToolButton::pressed, this, &LongTermRunModeDialog::onDictionaryToolButton);
 
     ui->memoryLineEdit->setValidator(new QIntValidator(1, 512, this));
     ui->timeLineEdit->setValidator(new QIntValidator(1, 60, this));
+    ui->trainDictionaryLineEdit->setValidator(new QIntValidator(1, ArchiveDictionary::MAX_TRAINING_MIB, this));
 
     onInputChanged();
 }
@@ -60,15 +68,22 @@ bool LongTermRunModeDialog::isEnabled() const
     return ui->groupBox->isChecked();
 }
 
+bool LongTermRunModeDialog::isStreaming() const
+{
+    return ui->streamCheckBox->isChecked();
+}
+
 void LongTermRunModeDialog::onInputChanged()
 {
 
-    bool timeOk {}, memoryOk {};
+    bool timeOk {}, memoryOk {}, dictionaryOk {};
 
     timeInMinutes = ui->timeLineEdit->text().toInt(&timeOk);
     memoryInMiB = ui->memoryLineEdit->text().toInt(&memoryOk);
+    dictionaryTrainingMiB = ui->trainDictionaryLineEdit->text().toInt(&dictionaryOk);
+    dictionaryOk = dictionaryOk && dictionaryTrainingMiB > 0 && dictionaryTrainingMiB <= ArchiveDictionary::MAX_TRAINING_MIB;
 
-    if (!timeOk || !memoryOk) {
+    if (!timeOk || !memoryOk || (ui->trainDictionaryCheckBox->isChecked() && !dictionaryOk)) {
         ui->buttonBox->button(QDialogButtonBox::StandardButton::Ok)->setEnabled(false);
         return;
     }
@@ -90,3 +105,21 @@ QUrl LongTermRunModeDialog::getDirectory() const
 {
     return directory;
 }
+
+int LongTermRunModeDialog::getDictionaryTrainingMiB() const
+{
+    return ui->trainDictionaryCheckBox->isChecked() ? dictionaryTrainingMiB : 0;
+}
+
+QString LongTermRunModeDialog::getDictionaryFile() const
+{
+    return ui->dictionaryLineEdit->text();
+}
+
+void LongTermRunModeDialog::onDictionaryToolButton()
+{
+    const auto file = QFileDialog::getOpenFileName(this, tr("Open dictionary"), directory.path(), tr("zstd dictionaries (*.zdict);;All files (*)"));
+    if (!file.isEmpty()) {
+        ui->dictionaryLineEdit->setText(file);
+    }
+}
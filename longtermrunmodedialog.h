@@ -18,16 +18,23 @@ public:
     int getMinutes() const;
     int getMemory() const;
     bool isEnabled() const;
+    bool isStreaming() const;
     QUrl getDirectory() const;
+    // 0 unless a dictionary is to be trained
+    int getDictionaryTrainingMiB() const;
+    // Empty if none was chosen, takes precedence over training one
+    QString getDictionaryFile() const;
 
 private slots:
     void onInputChanged();
     void onToolButton();
+    void onDictionaryToolButton();
 
 private:
     Ui::LongTermRunModeDialog* ui;
     int timeInMinutes = 15;
     int memoryInMiB = 8;
+    int dictionaryTrainingMiB = 8;
     QUrl directory;
 };
 
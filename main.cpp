@@ -1,19 +1,279 @@
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QCoreApplication>
 #include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
 #include <QMessageBox>
+#include <QSocketNotifier>
 
+#include "headlesscapture.h"
 #include "mainwindow.h"
+#include "multiportwindow.h"
+#include "rawcapture.h"
+#include "stats.h"
 #include "yetty.version.h"
 
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <thread>
+#include <unistd.h>
+
 static void printUsage()
 {
     fputs("Usage: " PROJECT_NAME " PORTNAME BAUDRATE\n"
-          "       " PROJECT_NAME " FILENAME",
+          "       " PROJECT_NAME " FILENAME\n"
+          "       " PROJECT_NAME " --headless PORTNAME BAUDRATE [PORTNAME BAUDRATE]... [--archive DIRECTORY [--dictionary FILE | --train-dictionary MIB]] [--raw DIRECTORY] [--trigger KEYWORD]... [--regex PATTERN]...\n"
+          "       " PROJECT_NAME " --multi PORTNAME BAUDRATE [PORTNAME BAUDRATE]... [--archive DIRECTORY [--dictionary FILE | --train-dictionary MIB]] [--trigger KEYWORD]... [--regex PATTERN]...\n"
+          "       " PROJECT_NAME " --replay-raw FILENAME [--realtime]\n"
+          "       " PROJECT_NAME " --headless --help",
         stderr);
 }
 
+static int signalPipe[2] {};
+
+static void handleSignal(int signalNumber)
+{
+    const auto c = static_cast<char>(signalNumber);
+    [[maybe_unused]] const auto result = write(signalPipe[1], &c, 1);
+}
+
+// The handlers only write the signal number to a pipe that the event loop watches. SIGUSR1 dumps
+// the stats as JSON, SIGINT and SIGTERM quit if `quitOnTerminate` is set. Returns false if the pipe
+// can't be created.
+static bool installSignalHandlers(QCoreApplication& app, const bool quitOnTerminate)
+{
+    if (pipe(signalPipe) != 0) {
+        perror("pipe");
+        return false;
+    }
+    auto* notifier = new QSocketNotifier(signalPipe[0], QSocketNotifier::Read, &app);
+    QObject::connect(notifier, &QSocketNotifier::activated, &app, [&app]() {
+        char signalNumber {};
+        if (read(signalPipe[0], &signalNumber, 1) != 1) {
+            return;
+        }
+        if (signalNumber != SIGUSR1) {
+            app.quit();
+            return;
+        }
+        try {
+            qInfo() << "Stats written to" << Stats::instance().dump();
+        } catch (const std::runtime_error& e) {
+            qWarning() << e.what();
+        }
+    });
+
+    std::signal(SIGUSR1, handleSignal);
+    if (quitOnTerminate) {
+        std::signal(SIGINT, handleSignal);
+        std::signal(SIGTERM, handleSignal);
+    }
+    return true;
+}
+
+// The same limit as in the scrollback dialog
+static constexpr int MAX_SCROLLBACK_LINES = 100 * 1000 * 1000;
+
+struct CaptureArguments {
+    std::vector<PortCapture::Options> ports {};
+    int statsIntervalSeconds {};
+    int scrollbackLines {};
+};
+
+// Parses the arguments shared by the headless and the multi port mode. Exits on --help.
+// Throws std::invalid_argument on invalid arguments and std::runtime_error if the dictionary can't
+// be loaded.
+static CaptureArguments parseCaptureArguments(const QCoreApplication& app)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Capture one or more serial ports");
+    parser.addHelpOption();
+    parser.addOption({ "headless", "Run without a GUI." });
+    parser.addOption({ "multi", "Show every port in its own tab." });
+    parser.addOption({ "archive", "Stream zstd archives to <directory>, in a subdirectory per port if there are several.", "directory" });
+    parser.addOption({ "raw", "Write every received byte unchanged to a raw capture per port in <directory>.", "directory" });
+    parser.addOption({ "trigger", "Report lines containing <keyword>. Can be repeated.", "keyword" });
+    parser.addOption({ "regex", "Report lines matching <pattern>. Can be repeated.", "pattern" });
+    parser.addOption({ "rotate-minutes", "Start a new archive every <minutes>.", "minutes", "60" });
+    parser.addOption({ "rotate-mib", "Start a new archive every <size> MiB.", "size", "512" });
+    parser.addOption({ "dictionary", "Compress the archives with the zstd dictionary <file>.", "file" });
+    parser.addOption({ "train-dictionary", "Compress the archives with a zstd dictionary trained from the first <size> MiB of each port, at most 16.", "size" });
+    parser.addOption({ "stats-interval", "Print stats every <seconds>, 0 to disable. Headless only.", "seconds", "10" });
+    parser.addOption({ "low-latency", "Set ASYNC_LOW_LATENCY, a 1 ms FTDI latency timer and VMIN 1 / VTIME 0." });
+    parser.addOption({ "scrollback", "Keep at most <lines> per port, 0 for no limit. Multi port only.", "lines", "0" });
+    parser.addPositionalArgument("port baud", "Serial port and baud rate, can be repeated");
+    parser.process(app);
+
+    const auto args = parser.positionalArguments();
+    if (args.isEmpty() || args.size() % 2) {
+        throw std::invalid_argument("Expected pairs of port and baud rate");
+    }
+
+    PortCapture::Options common;
+    for (const auto& keyword : parser.values("trigger")) {
+        common.triggers.push_back({ keyword.toStdString(), false });
+    }
+    for (const auto& pattern : parser.values("regex")) {
+        common.triggers.push_back({ pattern.toStdString(), true });
+    }
+    if (parser.isSet("low-latency")) {
+        common.portSettings = PortSettings::lowestLatency();
+    }
+    common.rotateMinutes = parser.value("rotate-minutes").toInt();
+    common.rotateMiB = parser.value("rotate-mib").toInt();
+    if (common.rotateMinutes <= 0 || common.rotateMiB <= 0) {
+        throw std::invalid_argument("Invalid rotation interval");
+    }
+    if (parser.isSet("dictionary")) {
+        // Loaded once, every port gets the same one
+        common.dictionary = ArchiveDictionary::load(parser.value("dictionary"));
+    } else if (parser.isSet("train-dictionary")) {
+        common.dictionaryTrainingMiB = parser.value("train-dictionary").toInt();
+        if (common.dictionaryTrainingMiB <= 0 || common.dictionaryTrainingMiB > ArchiveDictionary::MAX_TRAINING_MIB) {
+            throw std::invalid_argument("Invalid dictionary training size");
+        }
+    }
+
+    CaptureArguments result;
+    result.statsIntervalSeconds = parser.value("stats-interval").toInt();
+    result.scrollbackLines = parser.value("scrollback").toInt();
+    if (result.statsIntervalSeconds < 0 || result.scrollbackLines < 0 || result.scrollbackLines > MAX_SCROLLBACK_LINES) {
+        throw std::invalid_argument("Invalid stats interval or scrollback");
+    }
+
+    const auto archive = parser.value("archive");
+    const auto raw = parser.value("raw");
+    if (!raw.isEmpty() && !QDir().mkpath(raw)) {
+        throw std::invalid_argument("Failed to create " + raw.toStdString());
+    }
+    const auto startTime = QDateTime::currentDateTime().toString(Qt::DateFormat::ISODate);
+    for (qsizetype i = 0; i < args.size(); i += 2) {
+        auto options = common;
+        options.port = args[i];
+        bool ok {};
+        options.baud = args[i + 1].toInt(&ok);
+        if (!ok || !options.baud) {
+            throw std::invalid_argument("Invalid baud: " + args[i + 1].toStdString());
+        }
+
+        if (!archive.isEmpty()) {
+            options.archiveDirectory = args.size() == 2 ? archive : QDir(archive).filePath(QFileInfo(options.port).fileName());
+            if (!QDir().mkpath(options.archiveDirectory)) {
+                throw std::invalid_argument("Failed to create " + options.archiveDirectory.toStdString());
+            }
+        }
+        if (!raw.isEmpty()) {
+            options.rawCaptureFile = QDir(raw).filePath(QString("%1_%2.raw").arg(QFileInfo(options.port).fileName(), startTime));
+        }
+        result.ports.push_back(options);
+    }
+    return result;
+}
+
+// Writes the bytes of a raw capture to stdout exactly as they were received, optionally with the
+// original gaps between the reads
+static int runReplay(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(PROJECT_NAME);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Write a raw capture to stdout");
+    parser.addHelpOption();
+    parser.addOption({ "replay-raw", "Raw capture to replay.", "file" });
+    parser.addOption({ "realtime", "Keep the original timing between reads." });
+    parser.process(app);
+
+    const auto path = parser.value("replay-raw");
+    const auto realtime = parser.isSet("realtime");
+    try {
+        RawCaptureReader reader(path);
+        RawCaptureReader::Record record;
+        int64_t previousTimestamp {};
+        while (reader.next(record)) {
+            if (realtime && previousTimestamp && record.timestamp > previousTimestamp) {
+                std::this_thread::sleep_for(std::chrono::nanoseconds(record.timestamp - previousTimestamp));
+            }
+            previousTimestamp = record.timestamp;
+            if (fwrite(record.data.constData(), 1, static_cast<size_t>(record.data.size()), stdout) != static_cast<size_t>(record.data.size())) {
+                perror("fwrite");
+                return EXIT_FAILURE;
+            }
+            if (realtime) {
+                fflush(stdout);
+            }
+        }
+        if (reader.isTruncated()) {
+            qWarning() << path << "ends in an incomplete record";
+        }
+    } catch (const std::exception& e) {
+        fprintf(stderr, "Error: %s\n", e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+// Runs the capture pipeline with a QCoreApplication only, no windows, KTextEditor or sound
+static int runHeadless(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setOrganizationDomain("aa55.dev");
+    QCoreApplication::setApplicationName(PROJECT_NAME);
+
+    // Quit cleanly on SIGINT and SIGTERM so that the current archives get their seek tables
+    if (!installSignalHandlers(app, true)) {
+        return EXIT_FAILURE;
+    }
+
+    try {
+        const auto args = parseCaptureArguments(app);
+        HeadlessCapture capture(args.ports, args.statsIntervalSeconds);
+        capture.start();
+        return app.exec();
+    } catch (const std::exception& e) {
+        fprintf(stderr, "Error: %s\n", e.what());
+        printUsage();
+        return EXIT_FAILURE;
+    }
+}
+
+static int runMultiPort(int argc, char* argv[])
+{
+    QApplication app(argc, argv);
+    QApplication::setOrganizationDomain("aa55.dev");
+    QApplication::setApplicationName(PROJECT_NAME);
+    QApplication::setDesktopFileName(PROJECT_DOMAIN);
+    app.setWindowIcon(QIcon::fromTheme(PROJECT_DOMAIN));
+    installSignalHandlers(app, false);
+
+    try {
+        const auto args = parseCaptureArguments(app);
+        MultiPortWindow w(args.ports, args.scrollbackLines);
+        w.show();
+        return app.exec();
+    } catch (const std::exception& e) {
+        QMessageBox::critical(nullptr, "Error", e.what());
+        return EXIT_FAILURE;
+    }
+}
+
 int main(int argc, char* argv[])
 {
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--headless")) {
+            return runHeadless(argc, argv);
+        }
+        if (!strcmp(argv[i], "--multi")) {
+            return runMultiPort(argc, argv);
+        }
+        if (!strcmp(argv[i], "--replay-raw")) {
+            return runReplay(argc, argv);
+        }
+    }
+
     if (argc > 3) {
         printUsage();
         exit(EXIT_FAILURE);
@@ -27,6 +287,7 @@ int main(int argc, char* argv[])
     QApplication::setDesktopFileName(PROJECT_DOMAIN);
     // This is needed to show the icon in the "About" window
     a.setWindowIcon(QIcon::fromTheme(PROJECT_DOMAIN));
+    installSignalHandlers(a, false);
 
     try {
         MainWindow w;
@@ -1,76 +1,112 @@
 #include "mainwindow.h"
 #include "./ui_mainwindow.h"
+#include "archivereader.h"
+#include "archivesearchdialog.h"
+#include "archivewriter.h"
+#include "highlightingdialog.h"
+#include "largefileview.h"
 #include "longtermrunmodedialog.h"
 #include "portselectiondialog.h"
+#include "rawcapture.h"
+#include "ringbuffer.h"
+#include "scrollbackdialog.h"
+#include "seekablearchive.h"
+#include "serialreader.h"
+#include "stats.h"
+#include "statsdialog.h"
 #include "triggersetupdialog.h"
 #include "yetty.version.h"
 
+#include <KTextEditor/Cursor>
 #include <KTextEditor/Document>
 #include <KTextEditor/Editor>
 #include <KTextEditor/Message>
 #include <KTextEditor/View>
 #include <kstandardshortcut.h>
 
-#include <zstd.h>
-
 #include <malloc.h>
 #include <unistd.h>
 
+#include <QActionGroup>
 #include <QApplication>
 #include <QDateTime>
+#include <QDir>
 #include <QFile>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QInputDialog>
 #include <QKeyEvent>
+#include <QLabel>
+#include <QLocale>
 #include <QMessageBox>
 #include <QSerialPortInfo>
 #include <QSoundEffect>
+#include <QTemporaryFile>
+#include <QThread>
 #include <QTimer>
 #include <QVBoxLayout>
 
+#include <algorithm>
+#include <utility>
+
 #ifdef SYSTEMD_AVAILABLE
 #include <systemd/sd-bus.h>
 #endif
 
 MainWindow::MainWindow(QWidget* parent)
+    : MainWindow(portFromArguments(), parent)
+{
+}
+
+MainWindow::MainWindow(const QString& port, const int baud, const PortSettings& settings, QWidget* parent)
+    : MainWindow(std::make_tuple(port, baud, settings), parent)
+{
+}
+
+MainWindow::MainWindow(const std::tuple<QString, int, PortSettings>& port, QWidget* parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
-    , serialPort(new QSerialPort(this))
+    , ringBuffer(std::make_unique<RingBuffer>(RING_BUFFER_SIZE))
+    , readerThread(new QThread(this))
+    , serialReader(new SerialReader(*ringBuffer))
+    , flushTimer(new QTimer(this))
+    , sizeLabel(new QLabel(this))
+    , serialErrorLabel(new QLabel(this))
     , sound(new QSoundEffect(this))
     , timer(new QTimer(this))
     , longTermRunModeTimer(new QTimer(this))
+    , archiveWriter(new ArchiveWriter(this))
+    , highlightingTimer(new QTimer(this))
+    , highlightingLabel(new QLabel(this))
 {
-    const auto args = QApplication::arguments();
-
-    QString portname {};
-    int baud {};
-
-    switch (args.size()) {
-
-    case 3: { // Port and baud in cmdline arg
-        bool ok {};
-        baud = args[2].toInt(&ok);
-        if (!ok || !baud) {
-            throw std::runtime_error("Invalid baud: " + args[2].toStdString());
-        }
-        [[fallthrough]];
-    }
-    case 2: // Filename in cmdline arg
-        portname = args[1];
-        break;
-
-    default: // No args, show msgbox and get it from user
-        std::tie(portname, baud) = getPortFromUser();
-    }
+    const auto& [portname, baud, settings] = port;
+    currentPortSettings = settings;
 
     elapsedTimer.start();
     ui->setupUi(this);
 
+    serialReader->moveToThread(readerThread);
+    connect(readerThread, &QThread::finished, serialReader, &QObject::deleteLater);
+    connect(serialReader, &SerialReader::dataAvailable, this, &MainWindow::handleDataAvailable);
+    connect(serialReader, &SerialReader::errorOccurred, this, &MainWindow::handleError);
+    connect(serialReader, &SerialReader::serialErrors, this, &MainWindow::handleSerialErrors);
+    readerThread->setObjectName("SerialReader");
+    readerThread->start(QThread::TimeCriticalPriority);
+
     editor = KTextEditor::Editor::instance();
     doc = editor->createDocument(this);
-    doc->setHighlightingMode(HIGHLIGHT_MODE);
+    applyHighlighting();
 
     view = doc->createView(this);
+    view->registerTextHintProvider(this);
 
     ui->verticalLayout->insertWidget(0, view);
+    ui->statusbar->addPermanentWidget(serialErrorLabel);
+    ui->statusbar->addPermanentWidget(highlightingLabel);
+    ui->statusbar->addPermanentWidget(sizeLabel);
+    serialErrorLabel->hide();
+    doc->setMarkDescription(KTextEditor::Document::Error, tr("Serial errors"));
+    doc->setMarkIcon(KTextEditor::Document::Error, QIcon::fromTheme("dialog-error"));
 
     setWindowTitle(PROJECT_NAME);
 
@@ -80,6 +116,16 @@ MainWindow::MainWindow(QWidget* parent)
     ui->actionConnectToDevice->setShortcut(QKeySequence::Open);
     ui->actionConnectToDevice->setIcon(QIcon::fromTheme("document-open"));
 
+    connect(ui->actionOpenArchive, &QAction::triggered, this, &MainWindow::handleOpenArchiveAction);
+    ui->actionOpenArchive->setIcon(QIcon::fromTheme("archive-extract"));
+    connect(ui->actionOpenArchiveDirectory, &QAction::triggered, this, &MainWindow::handleOpenArchiveDirectoryAction);
+    ui->actionOpenArchiveDirectory->setIcon(QIcon::fromTheme("folder-open"));
+    connect(ui->actionSearchArchives, &QAction::triggered, this, &MainWindow::handleSearchArchivesAction);
+    ui->actionSearchArchives->setShortcut(QKeySequence(Qt::CTRL | Qt::SHIFT | Qt::Key_F));
+    ui->actionSearchArchives->setIcon(QIcon::fromTheme("edit-find"));
+    connect(ui->actionGoToArchive, &QAction::triggered, this, &MainWindow::handleGoToArchiveAction);
+    ui->actionGoToArchive->setIcon(QIcon::fromTheme("go-jump"));
+
     connect(ui->actionSave, &QAction::triggered, this, &MainWindow::handleSaveAction);
     ui->actionSave->setIcon(QIcon::fromTheme("document-save"));
 
@@ -91,6 +137,31 @@ MainWindow::MainWindow(QWidget* parent)
     ui->actionClear->setShortcut(QKeySequence(Qt::CTRL | Qt::SHIFT | Qt::Key_K));
     ui->actionClear->setIcon(QIcon::fromTheme("edit-clear-all"));
 
+    auto refreshRateGroup = new QActionGroup(this);
+    for (const auto& [action, rate] : { std::pair { ui->actionRefreshRate15, 15 },
+             std::pair { ui->actionRefreshRate30, 30 },
+             std::pair { ui->actionRefreshRate60, 60 },
+             std::pair { ui->actionRefreshRate120, 120 } }) {
+        action->setData(rate);
+        action->setChecked(rate == DEFAULT_REFRESH_RATE);
+        refreshRateGroup->addAction(action);
+    }
+    connect(refreshRateGroup, &QActionGroup::triggered, this, &MainWindow::handleRefreshRateAction);
+
+    auto invalidUtf8Group = new QActionGroup(this);
+    for (const auto& [action, policy] : { std::pair { ui->actionInvalidUtf8Replace, Utf8Decoder::InvalidPolicy::Replace },
+             std::pair { ui->actionInvalidUtf8HexEscape, Utf8Decoder::InvalidPolicy::HexEscape },
+             std::pair { ui->actionInvalidUtf8Latin1, Utf8Decoder::InvalidPolicy::Latin1 } }) {
+        action->setData(static_cast<int>(policy));
+        action->setChecked(policy == utf8Decoder.invalidPolicy());
+        invalidUtf8Group->addAction(action);
+    }
+    connect(invalidUtf8Group, &QActionGroup::triggered, this, &MainWindow::handleInvalidUtf8Action);
+
+    connect(ui->actionScrollback, &QAction::triggered, this, &MainWindow::handleScrollbackAction);
+    connect(ui->actionStatistics, &QAction::triggered, this, &MainWindow::handleStatisticsAction);
+    connect(ui->actionHighlighting, &QAction::triggered, this, &MainWindow::handleHighlightingAction);
+
     connect(ui->scrollToEndButton, &QPushButton::pressed, this, &MainWindow::handleScrollToEnd);
     ui->scrollToEndButton->setIcon(QIcon::fromTheme("go-bottom"));
 
@@ -103,13 +174,20 @@ MainWindow::MainWindow(QWidget* parent)
     ui->actionLongTermRunMode->setIcon(QIcon::fromTheme("media-record"));
     connect(ui->actionLongTermRunMode, &QAction::triggered, this, &MainWindow::handleLongTermRunModeAction);
 
+    ui->actionRawCapture->setIcon(QIcon::fromTheme("document-save-as"));
+    connect(ui->actionRawCapture, &QAction::triggered, this, &MainWindow::handleRawCaptureAction);
+
     connect(ui->startStopButton, &QPushButton::pressed, this, &MainWindow::handleStartStopButton);
 
-    connect(serialPort, &QSerialPort::readyRead, this, &MainWindow::handleReadyRead);
-    connect(serialPort, &QSerialPort::errorOccurred, this, &MainWindow::handleError);
+    flushTimer->setSingleShot(true);
+    connect(flushTimer, &QTimer::timeout, this, &MainWindow::handleFlushTimer);
 
     connect(timer, &QTimer::timeout, this, &MainWindow::handleRetryConnection);
     connect(longTermRunModeTimer, &QTimer::timeout, this, &MainWindow::handleLongTermRunModeTimer);
+    connect(highlightingTimer, &QTimer::timeout, this, &MainWindow::handleHighlightingTimer);
+    highlightingTimer->start(HIGHLIGHTING_INTERVAL_MS);
+    connect(archiveWriter, &ArchiveWriter::errorOccurred, this, &MainWindow::handleArchiveError);
+    archiveWriter->start(QThread::LowPriority);
 
     sound->setSource(QUrl::fromLocalFile(":/notify.wav"));
 
@@ -118,9 +196,12 @@ MainWindow::MainWindow(QWidget* parent)
 
 MainWindow::~MainWindow()
 {
+    view->unregisterTextHintProvider(this);
+    readerThread->quit();
+    readerThread->wait();
+    // The reader is gone, whatever it appended is written out by the destructor
+    delete rawCaptureWriter;
     delete ui;
-    ZSTD_freeCCtx(zstdCtx);
-    zstdCtx = nullptr;
 }
 
 void MainWindow::setProgramState(const ProgramState newState)
@@ -150,7 +231,34 @@ void MainWindow::setProgramState(const ProgramState newState)
     currentProgramState = newState;
 }
 
-std::pair<QString, int> MainWindow::getPortFromUser() const
+std::tuple<QString, int, PortSettings> MainWindow::portFromArguments()
+{
+    const auto args = QApplication::arguments();
+
+    QString portname {};
+    int baud {};
+
+    switch (args.size()) {
+
+    case 3: { // Port and baud in cmdline arg
+        bool ok {};
+        baud = args[2].toInt(&ok);
+        if (!ok || !baud) {
+            throw std::runtime_error("Invalid baud: " + args[2].toStdString());
+        }
+        [[fallthrough]];
+    }
+    case 2: // Filename in cmdline arg
+        portname = args[1];
+        break;
+
+    default: // No args, show msgbox and get it from user
+        return getPortFromUser();
+    }
+    return { portname, baud, PortSettings {} };
+}
+
+std::tuple<QString, int, PortSettings> MainWindow::getPortFromUser()
 {
     PortSelectionDialog dlg;
     if (!dlg.exec()) {
@@ -158,43 +266,366 @@ std::pair<QString, int> MainWindow::getPortFromUser() const
         throw std::runtime_error("No selection made");
     }
     const auto baud = dlg.getSelectedBaud();
-    return { dlg.getSelectedPortLocation(), baud };
+    return { dlg.getSelectedPortLocation(), baud, dlg.getPortSettings() };
 }
 
-void MainWindow::handleReadyRead()
+void MainWindow::handleDataAvailable()
 {
-    auto newData = serialPort->readAll();
+    if (!serialReader->acknowledgeData()) {
+        return;
+    }
+    Stats::instance().ringBufferDepth.set(ringBuffer->size());
 
-    // Need to remove '\0' from the input or else we might mess up the text shown or
-    // affect string operation downstream. We could replace it with "�" but
-    // the replace operation with multi byte unicode char will become be very expensive.
-    newData.replace('\0', ' ');
+    while (true) {
+        const auto [data, len] = ringBuffer->readRegion();
+        if (!len) {
+            break;
+        }
+        processChunk(data, len);
+        ringBuffer->commitRead(len);
+    }
 
-    if (triggerActive) {
+    if (serialReader->isBackpressured()) {
+        QMetaObject::invokeMethod(serialReader, &SerialReader::resume, Qt::QueuedConnection);
+    }
 
-        // We will keep pushing whatever data we get into a QByteArray till we reach end of line,
-        // at which point we search for our trigger keyword in the constructed line.
-        for (const auto i : newData) {
-            if (i == '\n') {
-                if (triggerSearchLine.contains(triggerKeyword)) {
-                    triggerMatchCount++;
-                    ui->statusbar->showMessage(QString("%1 matches").arg(triggerMatchCount), 3000);
+    if (!pendingData.isEmpty() && !flushTimer->isActive()) {
+        flushTimer->start(flushIntervalMs);
+    }
+}
 
-                    // TODO: This is broken. Qt plays the sound for a few times and then stops working.
-                    sound->play();
-                }
+void MainWindow::handleFlushTimer()
+{
+    // Nobody is looking at the document while we are minimized. Keep collecting the data and
+    // insert it in one go once the window is restored.
+    if (isMinimized()) {
+        return;
+    }
+    flushPendingData();
+}
 
-                // clear() will free memory, resize(0) will not
-                triggerSearchLine.resize(0);
-            } else {
-                triggerSearchLine.push_back(i);
+void MainWindow::flushPendingData()
+{
+    if (pendingData.isEmpty()) {
+        return;
+    }
+
+    auto& stats = Stats::instance();
+    stats.pendingBytes.set(static_cast<uint64_t>(pendingData.size()));
+    // A character cut off at the end stays in the decoder until the rest of it arrives
+    const auto& text = [&]() -> const QString& {
+        StatTimer timer(stats.decodeTime);
+        return utf8Decoder.decode(pendingData.constData(), static_cast<size_t>(pendingData.size()));
+    }();
+    stats.invalidUtf8Bytes.add(utf8Decoder.invalidBytes());
+    documentBytes += utf8Decoder.sizeDifference();
+    {
+        StatTimer timer(stats.insertTextTime);
+        doc->setReadWrite(true);
+        doc->insertText(doc->documentEnd(), text);
+        doc->setReadWrite(false);
+    }
+
+    // clear() will free memory, resize(0) will not
+    pendingData.resize(0);
+
+    if (archiveReader && archiveChunksPending) {
+        archiveReader->chunkConsumed(std::exchange(archiveChunksPending, 0));
+    }
+
+    enforceScrollback();
+    updateSizeLabel();
+}
+
+static qint64 utf8Length(const QStringView str)
+{
+    qint64 len {};
+    for (const auto c : str) {
+        const auto u = c.unicode();
+        if (u < 0x80) {
+            len += 1;
+        } else if (u < 0x800 || c.isSurrogate()) {
+            // A surrogate pair is 4 bytes in UTF-8, 2 for each half
+            len += 2;
+        } else {
+            len += 3;
+        }
+    }
+    return len;
+}
+
+void MainWindow::enforceScrollback()
+{
+    if (!scrollbackEnabled) {
+        return;
+    }
+
+    const auto lineCount = doc->lines();
+    const bool overLines = lineCount > scrollbackMaxLines;
+    const bool overBytes = documentBytes > scrollbackMaxBytes;
+    if (!overLines && !overBytes) {
+        return;
+    }
+
+    // In qint64, the line limit times the watermark overflows an int well below the largest limit
+    const auto lineTarget = overLines ? lineCount - static_cast<qint64>(scrollbackMaxLines) * SCROLLBACK_LOW_WATERMARK / 100 : 0;
+    const auto byteTarget = overBytes ? documentBytes - scrollbackMaxBytes * SCROLLBACK_LOW_WATERMARK / 100 : 0;
+
+    // The last line is still being written to, never evict it
+    int evictLines {};
+    qint64 evictBytes {};
+    while (evictLines < lineCount - 1 && (evictLines < lineTarget || evictBytes < byteTarget)) {
+        evictBytes += utf8Length(doc->line(evictLines)) + 1;
+        evictLines++;
+    }
+    if (!evictLines) {
+        return;
+    }
+
+    const KTextEditor::Range range(0, 0, evictLines, 0);
+    if (longTermRunModeEnabled && !longTermRunModeStreaming) {
+        // Streaming mode has already archived these, snapshot mode still has them in snapshotData
+        if (scrollbackArchiveEvicted) {
+            snapshotEvictedLines += evictLines;
+        } else {
+            qsizetype cut {};
+            for (int i = 0; i < evictLines && cut < snapshotData.size(); i++) {
+                const auto newline = snapshotData.indexOf('\n', cut);
+                cut = newline < 0 ? snapshotData.size() : newline + 1;
             }
+            snapshotData.remove(0, cut);
         }
     }
 
     doc->setReadWrite(true);
-    doc->insertText(doc->documentEnd(), newData);
+    doc->removeText(range);
     doc->setReadWrite(false);
+    lineTimestamps.removeFirst(static_cast<size_t>(evictLines));
+    evictedLines += evictLines;
+    serialErrorNotes.erase(serialErrorNotes.begin(), serialErrorNotes.lower_bound(evictedLines));
+
+    documentBytes = std::max<qint64>(0, documentBytes - evictBytes);
+    documentLines = std::max<qint64>(0, documentLines - evictLines);
+}
+
+void MainWindow::handleScrollbackAction()
+{
+    if (!scrollbackDialog) {
+        scrollbackDialog = new ScrollbackDialog(this);
+        connect(scrollbackDialog, &QDialog::finished, this, &MainWindow::handleScrollbackDialogDone);
+    }
+    scrollbackDialog->open();
+}
+
+void MainWindow::handleStatisticsAction()
+{
+    if (!statsDialog) {
+        statsDialog = new StatsDialog(this);
+    }
+    statsDialog->show();
+    statsDialog->raise();
+}
+
+void MainWindow::handleHighlightingAction()
+{
+    if (!highlightingDialog) {
+        highlightingDialog = new HighlightingDialog(this);
+        connect(highlightingDialog, &QDialog::finished, this, &MainWindow::handleHighlightingDialogDone);
+    }
+    highlightingDialog->open();
+}
+
+void MainWindow::handleHighlightingDialogDone(int result)
+{
+    if (result != QDialog::Accepted) {
+        return;
+    }
+
+    highlighting.setEnabled(highlightingDialog->isAdaptive());
+    highlighting.setThresholds(highlightingDialog->getThresholds());
+    const auto& thresholds = highlighting.thresholds();
+    qInfo() << "Adaptive highlighting:" << highlighting.isEnabled() << thresholds.simpleRate << thresholds.plainRate
+            << thresholds.simpleDocumentSize << thresholds.plainDocumentSize;
+}
+
+void MainWindow::handleHighlightingTimer()
+{
+    if (!highlighting.update(documentBytes, LineTimestamps::now())) {
+        return;
+    }
+    Stats::instance().highlightingChanges.add();
+    qInfo() << "Switching to" << AdaptiveHighlighting::displayName(highlighting.level()) << "at" << highlighting.rate() << "bytes/s with" << documentBytes << "bytes";
+    applyHighlighting();
+}
+
+void MainWindow::applyHighlighting()
+{
+    auto mode = AdaptiveHighlighting::modeName(highlighting.level());
+    // Not every version of the syntax definitions has all of them
+    if (!doc->highlightingModes().contains(mode)) {
+        mode = AdaptiveHighlighting::modeName(AdaptiveHighlighting::Level::Plain);
+    }
+    if (doc->highlightingMode() != mode) {
+        doc->setHighlightingMode(mode);
+    }
+    highlightingLabel->setText(AdaptiveHighlighting::displayName(highlighting.level()));
+    highlightingLabel->setToolTip(highlighting.isEnabled() ? tr("Reduced automatically while data comes in fast or the document is large")
+                                                           : tr("Adaptive highlighting is disabled"));
+}
+
+void MainWindow::handleScrollbackDialogDone(int result)
+{
+    if (result != QDialog::Accepted) {
+        return;
+    }
+
+    scrollbackEnabled = scrollbackDialog->isEnabled();
+    scrollbackMaxLines = scrollbackDialog->getMaxLines();
+    scrollbackMaxBytes = static_cast<qint64>(scrollbackDialog->getMaxMemory()) * 1024 * 1024;
+    scrollbackArchiveEvicted = scrollbackDialog->archiveEvicted();
+    qInfo() << "Scrollback:" << scrollbackEnabled << scrollbackMaxLines << scrollbackMaxBytes << scrollbackArchiveEvicted;
+
+    enforceScrollback();
+    updateSizeLabel();
+}
+
+void MainWindow::updateSizeLabel()
+{
+    sizeLabel->setText(QString("%1 │ %2 lines").arg(QLocale().formattedDataSize(documentBytes), QString::number(documentLines)));
+}
+
+void MainWindow::handleRefreshRateAction(QAction* action)
+{
+    const auto rate = action->data().toInt();
+    qInfo() << "Setting refresh rate:" << rate;
+    flushIntervalMs = 1000 / rate;
+}
+
+void MainWindow::handleInvalidUtf8Action(QAction* action)
+{
+    const auto policy = static_cast<Utf8Decoder::InvalidPolicy>(action->data().toInt());
+    qInfo() << "Invalid UTF-8 policy:" << action->text();
+    utf8Decoder.setPolicy(policy);
+}
+
+void MainWindow::changeEvent(QEvent* event)
+{
+    if (event->type() == QEvent::WindowStateChange && !isMinimized()) {
+        flushPendingData();
+    }
+    QMainWindow::changeEvent(event);
+}
+
+void MainWindow::processChunk(char* data, const size_t len)
+{
+    // Need to remove '\0' from the input or else we might mess up the text shown or
+    // affect string operation downstream. We could replace it with "�" but
+    // the replace operation with multi byte unicode char will become be very expensive.
+    // The same pass builds the newline index used by the later stages. This is done in place in
+    // the ring buffer to avoid a copy.
+    auto& stats = Stats::instance();
+    stats.chunkSize.record(len);
+    {
+        StatTimer timer(stats.frameTime);
+        lineFramer.frame(data, len);
+    }
+
+    documentBytes += static_cast<qint64>(len);
+    documentLines += static_cast<qint64>(lineFramer.newlines().size());
+    highlighting.record(len);
+
+    // A line was received when its first byte was
+    chunkLineTimestamps.clear();
+    if (len && atLineStart) {
+        chunkLineTimestamps.push_back(serialReader->arrivalTime(ingestOffset));
+    }
+    for (const auto newline : lineFramer.newlines()) {
+        if (newline + 1 < len) {
+            chunkLineTimestamps.push_back(serialReader->arrivalTime(ingestOffset + newline + 1));
+        }
+    }
+    for (const auto timestamp : chunkLineTimestamps) {
+        lineTimestamps.append(timestamp);
+    }
+    if (len) {
+        atLineStart = data[len - 1] == '\n';
+    }
+    ingestOffset += len;
+
+    if (!triggerEngine.isEmpty()) {
+        bool playSound {};
+        QStringList matches;
+
+        {
+            StatTimer timer(stats.triggerScanTime);
+            triggerEngine.scan(data, len, lineFramer.newlines(), [&](const size_t keyword) {
+                const auto& trigger = triggerKeywords[static_cast<qsizetype>(keyword)];
+                playSound = playSound || trigger.playSound;
+                matches.append(QString("%1: %2").arg(trigger.keyword).arg(triggerEngine.matchCount(keyword)));
+            });
+        }
+
+        if (!matches.isEmpty()) {
+            ui->statusbar->showMessage(matches.join(" │ ") + " matches", 3000);
+        }
+
+        if (playSound) {
+            // TODO: This is broken. Qt plays the sound for a few times and then stops working.
+            sound->play();
+        }
+    }
+
+    if (longTermRunModeEnabled && longTermRunModeStreaming) {
+        archiveWriter->append(data, len, chunkLineTimestamps);
+        longTermRunModeStreamedBytes += static_cast<qint64>(len);
+    } else if (longTermRunModeEnabled) {
+        snapshotData.append(data, static_cast<qsizetype>(len));
+    }
+
+    pendingData.append(data, static_cast<qsizetype>(len));
+}
+
+QString MainWindow::textHint(KTextEditor::View* /*view*/, const KTextEditor::Cursor& position)
+{
+    const auto line = static_cast<size_t>(position.line());
+    if (position.line() < 0 || line >= lineTimestamps.size()) {
+        return {};
+    }
+
+    const auto timestamp = lineTimestamps.at(line);
+    const auto received = QDateTime::fromMSecsSinceEpoch(LineTimestamps::toWallClock(timestamp) / 1000000);
+    auto hint = tr("Received %1").arg(received.toString("yyyy-MM-dd hh:mm:ss.zzz"));
+    if (line > 0) {
+        const auto delta = static_cast<double>(timestamp - lineTimestamps.at(line - 1)) / 1e6;
+        hint += tr(" (+%1 ms)").arg(delta, 0, 'f', 3);
+    }
+    if (const auto it = serialErrorNotes.find(evictedLines + position.line()); it != serialErrorNotes.end()) {
+        hint += '\n' + it->second;
+    }
+    return hint;
+}
+
+void MainWindow::handleSerialErrors(const SerialErrorCounts& counts)
+{
+    // The affected bytes are the last ones read. Get them into the document so that the mark goes
+    // on the line that was being received.
+    handleDataAvailable();
+    flushPendingData();
+
+    const auto line = doc->lines() - 1;
+    const auto now = QDateTime::currentDateTime().toString("hh:mm:ss.zzz");
+    qWarning() << "Serial errors on" << currentPortName << "at line" << line + 1 << counts.toString();
+
+    auto& note = serialErrorNotes[evictedLines + line];
+    note += (note.isEmpty() ? "" : "\n") + tr("%1: %2, data was lost or corrupted before here").arg(now, counts.toString());
+    doc->addMark(line, KTextEditor::Document::Error);
+    view->setConfigValue("icon-bar", true);
+
+    serialErrorTotals += counts;
+    serialErrorLabel->setText("⚠ " + serialErrorTotals.toString());
+    serialErrorLabel->setToolTip(tr("Errors counted by the serial driver since the document was cleared"));
+    serialErrorLabel->show();
+    ui->statusbar->showMessage(tr("Serial errors at line %1: %2").arg(line + 1).arg(counts.toString()), 5000);
 }
 
 void MainWindow::handleError(const QSerialPort::SerialPortError error)
@@ -204,13 +635,15 @@ void MainWindow::handleError(const QSerialPort::SerialPortError error)
         return;
     }
 
-    if (serialPort->isOpen()) {
-        serialPort->close();
-    }
+    // The reader has already closed the port by the time we get here
+    lastSerialError = error;
+
+    // Don't leave whatever made it into the ring buffer before the error behind
+    handleDataAvailable();
 
     auto errMsg = "Error: " + QVariant::fromValue(error).toString();
 
-    const auto& portName = "/dev/" + serialPort->portName();
+    const auto& portName = currentPortName.startsWith("/dev/") ? currentPortName : "/dev/" + currentPortName;
 
     if (!QFile::exists(portName)) {
         errMsg += QString(": %1 detached").arg(portName);
@@ -235,16 +668,42 @@ void MainWindow::handleError(const QSerialPort::SerialPortError error)
 
 void MainWindow::handleSaveAction()
 {
+    flushPendingData();
     doc->documentSave();
 }
 
 void MainWindow::handleClearAction()
 {
+    resetDocumentState();
+    // Unlike a rotation the document isn't expected to fill up again soon, give the memory back
+    lineTimestamps.squeeze();
+    malloc_trim(0);
+}
+
+void MainWindow::resetDocumentState()
+{
+    closeLargeFile();
+    delete std::exchange(archiveReader, nullptr);
+    delete std::exchange(archiveTextFile, nullptr);
+    archiveChunksPending = 0;
+    archiveJumpLine = -1;
+    pendingData.resize(0);
+    utf8Decoder.reset();
+    snapshotData.clear();
+    snapshotEvictedLines = 0;
+    lineTimestamps.clear();
+    atLineStart = true;
+    documentBytes = 0;
+    documentLines = 0;
+    evictedLines = 0;
+    serialErrorNotes.clear();
+    serialErrorTotals = {};
+    serialErrorLabel->hide();
+    updateSizeLabel();
     doc->setReadWrite(true);
     doc->setModified(false);
     doc->closeUrl();
-    doc->setHighlightingMode(HIGHLIGHT_MODE);
-    malloc_trim(0);
+    applyHighlighting();
     doc->setReadWrite(false);
 }
 
@@ -267,8 +726,9 @@ void MainWindow::handleAboutAction()
 
 void MainWindow::handleConnectAction()
 {
-    serialPort->close();
-    const auto [port, baud] = getPortFromUser();
+    closeSerialPort();
+    const auto [port, baud, settings] = getPortFromUser();
+    currentPortSettings = settings;
     handleClearAction();
     connectToDevice(port, baud);
 }
@@ -286,13 +746,22 @@ void MainWindow::handleTriggerSetupDialogDone(int result)
 {
     if (result == QDialog::Accepted) {
 
-        const auto newKeyword = triggerSetupDialog->getKeyword().toUtf8();
-        if (newKeyword != triggerKeyword) {
-            qInfo() << "Setting new trigger keyword: " << triggerKeyword << " " << newKeyword;
-            triggerKeyword = newKeyword;
-            triggerActive = !newKeyword.isEmpty();
-            triggerMatchCount = 0;
+        const auto newTriggers = triggerSetupDialog->getKeywords();
+
+        std::vector<TriggerPattern> patterns;
+        for (const auto& trigger : newTriggers) {
+            qInfo() << "Setting trigger:" << trigger.keyword << trigger.isRegex << trigger.playSound;
+            patterns.push_back({ trigger.keyword.toStdString(), trigger.isRegex });
         }
+
+        try {
+            triggerEngine.setTriggers(patterns);
+        } catch (const std::invalid_argument& e) {
+            qWarning() << "Invalid trigger:" << e.what();
+            QMessageBox::warning(this, tr("Invalid trigger"), e.what());
+            return;
+        }
+        triggerKeywords = newTriggers;
     }
 }
 
@@ -300,11 +769,11 @@ void MainWindow::handleStartStopButton()
 {
     if (currentProgramState == ProgramState::Started) {
         qInfo() << "Closing connection on button press";
-        serialPort->close();
+        closeSerialPort();
         setProgramState(ProgramState::Stopped);
     } else {
         qInfo() << "Starting connection on button press";
-        connectToDevice(serialPort->portName(), serialPort->baudRate());
+        connectToDevice(currentPortName, currentBaud);
     }
 }
 
@@ -312,15 +781,16 @@ void MainWindow::handleRetryConnection()
 {
     // This can end up opening the wrong port if the user is plugging in multiple serial devices
     // and a new device enumerates to the same name as the old one.
-    if (serialPort->error() != QSerialPort::NoError) {
+    if (lastSerialError != QSerialPort::NoError) {
         qInfo() << "Retrying connection";
-        connectToDevice(serialPort->portName(), serialPort->baudRate(), false);
+        connectToDevice(currentPortName, currentBaud, false);
     }
 }
 
 void MainWindow::handleLongTermRunModeDialogDone(int result)
 {
     if (result == QDialog::Accepted) {
+        const auto wasSnapshot = longTermRunModeEnabled && !longTermRunModeStreaming;
         longTermRunModeEnabled = longTermRunModeDialog->isEnabled();
 
         if (longTermRunModeEnabled) {
@@ -329,16 +799,63 @@ void MainWindow::handleLongTermRunModeDialogDone(int result)
             longTermRunModeMaxMemory = longTermRunModeDialog->getMemory();
             longTermRunModeStartTime = elapsedTimer.elapsed();
             longTermRunModePath = longTermRunModeDialog->getDirectory().path();
+            longTermRunModeStreaming = longTermRunModeDialog->isStreaming();
+            longTermRunModeStreamedBytes = 0;
+
+            applyArchiveDictionary();
+            if (longTermRunModeStreaming) {
+                archiveWriter->startStream(longTermRunModePath);
+                snapshotData.clear();
+                snapshotEvictedLines = 0;
+            } else {
+                archiveWriter->stopStream();
+                if (!wasSnapshot) {
+                    // What is already shown goes into the first archive, this once from the document
+                    flushPendingData();
+                    snapshotData = doc->text().toUtf8();
+                    snapshotEvictedLines = 0;
+                }
+            }
 
-            qInfo() << "Long term run mode enabled:" << longTermRunModeMaxMemory << longTermRunModeMaxTime << longTermRunModePath;
+            qInfo() << "Long term run mode enabled:" << longTermRunModeMaxMemory << longTermRunModeMaxTime << longTermRunModePath << longTermRunModeStreaming;
         } else {
             qInfo() << "Long term run mode disabled";
             fileCounter = 0;
             longTermRunModeTimer->stop();
+            archiveWriter->stopStream();
+            snapshotData.clear();
+            snapshotEvictedLines = 0;
         }
     }
 }
 
+void MainWindow::applyArchiveDictionary()
+{
+    const auto file = longTermRunModeDialog->getDictionaryFile();
+    const auto trainingMiB = longTermRunModeDialog->getDictionaryTrainingMiB();
+    if (file == longTermRunModeDictionaryFile && trainingMiB == longTermRunModeDictionaryMiB) {
+        return;
+    }
+    longTermRunModeDictionaryFile = file;
+    longTermRunModeDictionaryMiB = trainingMiB;
+
+    if (!file.isEmpty()) {
+        try {
+            const auto dictionary = ArchiveDictionary::load(file);
+            qInfo() << "Archive dictionary:" << file << dictionary.id();
+            archiveWriter->setDictionary(dictionary);
+        } catch (const std::runtime_error& e) {
+            // Archives without a dictionary are better than none
+            handleArchiveError(e.what());
+            archiveWriter->setDictionary({});
+            longTermRunModeDictionaryFile.clear();
+        }
+    } else {
+        qInfo() << "Archive dictionary training:" << trainingMiB << "MiB";
+        archiveWriter->trainDictionary(static_cast<size_t>(trainingMiB) * 1024 * 1024);
+    }
+}
+
 void MainWindow::handleLongTermRunModeTimer()
 {
     Q_ASSERT(elapsedTimer.elapsed() > longTermRunModeStartTime);
@@ -350,7 +867,22 @@ void MainWindow::handleLongTermRunModeTimer()
         qInfo() << "Time since last save: " << timeSinceLastSave;
     }
 
-    if (const auto textSize = doc->text().size(); textSize > (longTermRunModeMaxMemory * 1024 * 1024)) {
+    if (longTermRunModeStreaming) {
+        // The data is already on its way to disk, all that is left is ending the frame
+        if (longTermRunModeStreamedBytes > (longTermRunModeMaxMemory * 1024 * 1024)) {
+            shouldSave = true;
+            qInfo() << "streamed size: " << longTermRunModeStreamedBytes;
+        }
+        // The view is left alone, it is bounded by the scrollback
+        if (shouldSave) {
+            archiveWriter->rotate();
+            longTermRunModeStreamedBytes = 0;
+            longTermRunModeStartTime = elapsedTimer.elapsed();
+        }
+        return;
+    }
+
+    if (const auto textSize = snapshotData.size(); textSize > (longTermRunModeMaxMemory * 1024 * 1024)) {
         shouldSave = true;
         qInfo() << "text size: " << textSize;
     }
@@ -358,13 +890,35 @@ void MainWindow::handleLongTermRunModeTimer()
     if (shouldSave) {
         Q_ASSERT(!longTermRunModePath.isEmpty());
 
+        // Compression and fsync happen on the archive writer's thread. If it is still busy with
+        // earlier rotations, keep the data in the document and try again on the next tick.
+        // Evicted lines have lost their timestamps, the ones in the document still have them
+        const auto timestamps = lineTimestamps.serialize(static_cast<uint64_t>(snapshotEvictedLines));
+        const QByteArray serializedTimestamps(reinterpret_cast<const char*>(timestamps.data()), static_cast<qsizetype>(timestamps.size()));
+        // Shared with the archive writer, not copied
+        if (!archiveWriter->submit(longTermRunModePath, snapshotData, fileCounter, serializedTimestamps)) {
+            ui->statusbar->showMessage(tr("Archive writer busy, postponing save"), 3000);
+            return;
+        }
+        fileCounter++;
         longTermRunModeStartTime = elapsedTimer.elapsed();
 
-        const auto utfTxt = doc->text().toUtf8();
-        writeCompressedFile(utfTxt, fileCounter++);
+        resetDocumentState();
+    }
+}
 
-        handleClearAction();
+void MainWindow::handleArchiveError(const QString& msg)
+{
+    const auto errMsg = tr("Failed to save archive: %1").arg(msg);
+    ui->statusbar->showMessage(errMsg);
+    // One message that shows the latest error, until it is closed
+    if (archiveErrorMsg) {
+        archiveErrorMsg->setText(errMsg);
+        return;
     }
+    archiveErrorMsg = new KTextEditor::Message(errMsg, KTextEditor::Message::Error);
+    archiveErrorMsg->setAutoHide(0);
+    doc->postMessage(archiveErrorMsg);
 }
 
 void MainWindow::handleLongTermRunModeAction()
@@ -378,30 +932,543 @@ void MainWindow::handleLongTermRunModeAction()
 
 void MainWindow::connectToDevice(const QString& port, const int baud, const bool showMsgOnOpenErr)
 {
-    serialPort->setPortName(port);
-    serialPort->setBaudRate(baud);
+    currentPortName = port;
+    currentBaud = baud;
 
     setWindowTitle(PROJECT_NAME + QString(" ") + port);
-    ui->portInfoLabel->setText(QString("%1 │ %2").arg(serialPort->portName(), QString::number(serialPort->baudRate())));
+    ui->portInfoLabel->setText(QString("%1 │ %2").arg(port, QString::number(baud)));
 
     qInfo() << "Connecting to: " << port << baud;
-    serialPort->clearError();
-    if (serialPort->open(QIODevice::ReadOnly)) {
+    lastSerialError = QSerialPort::NoError;
+
+    bool opened {};
+    QMetaObject::invokeMethod(
+        serialReader, [&]() { return serialReader->open(port, baud, currentPortSettings); }, Qt::BlockingQueuedConnection, &opened);
+
+    if (opened) {
+        const auto settings = serialReader->appliedSettings().toString();
+        if (!settings.isEmpty()) {
+            ui->portInfoLabel->setText(QString("%1 │ %2 │ %3").arg(port, QString::number(baud), settings));
+        }
+        closeLargeFile();
         ui->startStopButton->setEnabled(true);
         ui->statusbar->showMessage("Running...");
         setProgramState(ProgramState::Started);
     } else {
         // We allow the user to open non-serial, static plain text files.
         qInfo() << "Opening as ordinary file";
+        ui->startStopButton->setEnabled(false);
+        if (QFileInfo(port).isDir()) {
+            openArchives(ArchiveReader::archivesInDirectory(port));
+            return;
+        }
+        if (ArchiveReader::isArchive(port)) {
+            openArchives({ port });
+            return;
+        }
+        if (RawCaptureReader::isRawCapture(port)) {
+            openRawCapture(port);
+            return;
+        }
         QFile file(port);
         if (!file.open(QIODevice::ReadOnly) && showMsgOnOpenErr) {
             QMessageBox::warning(this,
                 tr("Failed to open file"),
                 tr("Failed to open file") + ": " + port + ' ' + strerror(errno));
         }
-        doc->setText(file.readAll());
-        ui->startStopButton->setEnabled(false);
+        if (file.size() > LARGE_FILE_THRESHOLD) {
+            openLargeFile(port);
+            return;
+        }
+        closeLargeFile();
+        const auto contents = file.readAll();
+        doc->setText(contents);
+        documentBytes = contents.size();
+        documentLines = contents.count('\n');
+        updateSizeLabel();
+    }
+}
+
+void MainWindow::openLargeFile(const QString& path)
+{
+    handleClearAction();
+    try {
+        largeFileView = new LargeFileView(path, this);
+    } catch (const std::runtime_error& e) {
+        qWarning() << "Failed to map file" << e.what();
+        QMessageBox::warning(this, tr("Failed to open file"), tr("Failed to open file") + ": " + path + ' ' + e.what());
+        return;
+    }
+    qInfo() << "Opening" << path << "in the large file viewer";
+
+    view->hide();
+    ui->verticalLayout->insertWidget(0, largeFileView);
+    largeFileView->setFocus();
+
+    const auto showSize = [this]() {
+        sizeLabel->setText(QString("%1 │ %2 lines").arg(QLocale().formattedDataSize(largeFileView->fileSize()), QString::number(largeFileView->lineCount())));
+    };
+    if (largeFileView->isFullyIndexed()) {
+        showSize();
+    } else {
+        sizeLabel->setText(QString("%1 │ indexing...").arg(QLocale().formattedDataSize(largeFileView->fileSize())));
+        connect(largeFileView, &LargeFileView::indexReady, this, showSize);
+    }
+}
+
+void MainWindow::closeLargeFile()
+{
+    if (!largeFileView) {
+        return;
+    }
+    delete largeFileView;
+    largeFileView = nullptr;
+    delete std::exchange(largeFileTemporary, nullptr);
+    view->show();
+    updateSizeLabel();
+}
+
+void MainWindow::openArchives(const QStringList& files)
+{
+    handleClearAction();
+    if (files.isEmpty()) {
+        QMessageBox::warning(this, tr("Failed to open archives"), tr("No archives found"));
+        return;
+    }
+    qInfo() << "Opening" << files.size() << "archives";
+
+    archiveReader = new ArchiveReader(files, this);
+    connect(archiveReader, &ArchiveReader::chunkDecoded, this, &MainWindow::handleArchiveChunk);
+    connect(archiveReader, &ArchiveReader::errorOccurred, this, &MainWindow::handleArchiveReadError);
+    connect(archiveReader, &QThread::finished, this, [this, reader = archiveReader, count = files.size()]() {
+        if (reader != archiveReader) {
+            return;
+        }
+        ui->statusbar->showMessage(tr("Opened %n archive(s)", nullptr, static_cast<int>(count)), 3000);
+        if (archiveTextFile) {
+            // The line can't be jumped to in the large file viewer
+            archiveJumpLine = -1;
+            std::exchange(archiveReader, nullptr)->deleteLater();
+            const auto textFile = std::exchange(archiveTextFile, nullptr);
+            if (!textFile->flush()) {
+                handleArchiveReadError(textFile->fileName() + ' ' + textFile->errorString());
+                delete textFile;
+                return;
+            }
+            openLargeFile(textFile->fileName());
+            if (!largeFileView) {
+                delete textFile;
+                return;
+            }
+            largeFileTemporary = textFile;
+            return;
+        }
+        if (archiveJumpLine >= 0) {
+            flushPendingData();
+            const auto line = std::exchange(archiveJumpLine, -1) - evictedLines;
+            if (line >= 0 && line < doc->lines()) {
+                view->setCursorPosition(KTextEditor::Cursor(static_cast<int>(line), 0));
+            }
+        }
+    });
+    ui->statusbar->showMessage(tr("Decompressing..."));
+    archiveReader->start();
+}
+
+bool MainWindow::openArchiveAt(const QString& path, qint64 line, const qint64 timestamp)
+{
+    QByteArray data;
+    qint64 firstLine {};
+    qint64 lastLine {};
+    try {
+        SeekableArchive archive(path);
+        const auto& index = archive.index();
+        const auto& frames = index.frames();
+        const auto frameCount = static_cast<qsizetype>(frames.size());
+        auto frame = line >= 0 ? index.frameForLine(line) : index.frameForTime(timestamp);
+        // A time ahead of the archive shows its beginning
+        if (frame < 0 && line < 0 && index.hasLineIndex()) {
+            frame = 0;
+        }
+        if (frame < 0) {
+            return false;
+        }
+
+        if (line < 0) {
+            // The frame's time is that of its first line, the line timestamps narrow it down to
+            // the first line received at or after the requested time
+            line = frames[static_cast<size_t>(frame)].firstLine;
+            const auto [lineOffset, timestamps] = archive.readLineTimestamps();
+            const auto offset = static_cast<qint64>(lineOffset);
+            const auto end = frame + 1 < frameCount ? frames[static_cast<size_t>(frame + 1)].firstLine : offset + static_cast<qint64>(timestamps.size());
+            auto low = std::max(line, offset);
+            auto high = std::min(end, offset + static_cast<qint64>(timestamps.size()));
+            while (low < high) {
+                const auto mid = low + (high - low) / 2;
+                if (timestamps.at(static_cast<size_t>(mid - offset)) < timestamp * 1000 * 1000) {
+                    low = mid + 1;
+                } else {
+                    high = mid;
+                }
+            }
+            if (high > line) {
+                line = std::min(low, high - 1);
+            }
+        }
+
+        const auto first = std::max<qsizetype>(frame - ARCHIVE_CONTEXT_FRAMES, 0);
+        const auto last = std::min(frame + ARCHIVE_CONTEXT_FRAMES, frameCount - 1);
+        for (auto i = first; i <= last; i++) {
+            data.append(archive.readFrame(i));
+        }
+        firstLine = frames[static_cast<size_t>(first)].firstLine;
+        lastLine = last + 1 < frameCount ? frames[static_cast<size_t>(last + 1)].firstLine : -1;
+    } catch (const std::exception& e) {
+        qInfo() << "Not seeking in" << path << e.what();
+        return false;
+    }
+    qInfo() << "Opening" << path << "at line" << line;
+
+    handleClearAction();
+    // The same cleanup as for live data, see handleArchiveChunk()
+    lineFramer.frame(data.data(), static_cast<size_t>(data.size()));
+    documentLines = static_cast<qint64>(lineFramer.newlines().size());
+    const auto& text = utf8Decoder.decode(data.constData(), static_cast<size_t>(data.size()));
+    documentBytes = data.size() + utf8Decoder.sizeDifference();
+    doc->setReadWrite(true);
+    doc->setText(text);
+    doc->setReadWrite(false);
+    utf8Decoder.reset();
+    // The lines ahead of the document count as evicted so that they keep their numbers
+    evictedLines = firstLine;
+    updateSizeLabel();
+
+    view->setCursorPosition(KTextEditor::Cursor(static_cast<int>(line - firstLine), 0));
+    const auto shown = lastLine < 0 ? tr("Showing lines %1 to the end").arg(firstLine + 1) : tr("Showing lines %1 to %2").arg(firstLine + 1).arg(lastLine);
+    ui->statusbar->showMessage(shown, 5000);
+    return true;
+}
+
+bool MainWindow::moveArchivesToFile()
+{
+    auto textFile = std::make_unique<QTemporaryFile>(QDir::temp().filePath("yeTTY-XXXXXX.txt"));
+    if (!textFile->open()) {
+        handleArchiveReadError(textFile->fileName() + ' ' + textFile->errorString());
+        return false;
+    }
+    flushPendingData();
+    const auto utf8 = doc->text().toUtf8();
+    if (textFile->write(utf8) != utf8.size()) {
+        handleArchiveReadError(textFile->fileName() + ' ' + textFile->errorString());
+        return false;
+    }
+    qInfo() << "Archives are larger than" << LARGE_FILE_THRESHOLD << "bytes, decoding into" << textFile->fileName();
+    doc->setReadWrite(true);
+    doc->clear();
+    doc->setReadWrite(false);
+    archiveTextFile = textFile.release();
+    archiveTextFile->setParent(this);
+    return true;
+}
+
+void MainWindow::openRawCapture(const QString& path)
+{
+    handleClearAction();
+
+    // The capture holds the bytes before any cleanup, they go through the same framing and
+    // decoding as received data so that they are shown the way they would have been live. A
+    // capture too large for the document is decoded into a file for the large file viewer.
+    QTemporaryFile* textFile {};
+    if (QFileInfo(path).size() > LARGE_FILE_THRESHOLD) {
+        textFile = new QTemporaryFile(QDir::temp().filePath("yeTTY-XXXXXX.txt"), this);
+        if (!textFile->open()) {
+            QMessageBox::warning(this, tr("Failed to open file"), tr("Failed to open file") + ": " + textFile->fileName() + ' ' + textFile->errorString());
+            delete textFile;
+            return;
+        }
+    }
+
+    QString text;
+    qint64 bytes {};
+    qint64 lines {};
+    try {
+        RawCaptureReader reader(path);
+        RawCaptureReader::Record record;
+        while (reader.next(record)) {
+            const auto len = static_cast<size_t>(record.data.size());
+            lineFramer.frame(record.data.data(), len);
+            lines += static_cast<qint64>(lineFramer.newlines().size());
+            const auto& decoded = utf8Decoder.decode(record.data.constData(), len);
+            bytes += static_cast<qint64>(len) + utf8Decoder.sizeDifference();
+            if (!textFile) {
+                text.append(decoded);
+                continue;
+            }
+            const auto utf8 = decoded.toUtf8();
+            if (textFile->write(utf8) != utf8.size()) {
+                throw std::runtime_error(QString("Failed to write %1: %2").arg(textFile->fileName(), textFile->errorString()).toStdString());
+            }
+        }
+        if (textFile && !textFile->flush()) {
+            throw std::runtime_error(QString("Failed to write %1: %2").arg(textFile->fileName(), textFile->errorString()).toStdString());
+        }
+        if (reader.isTruncated()) {
+            ui->statusbar->showMessage(tr("%1 ends in an incomplete record").arg(path), 3000);
+        }
+    } catch (const std::runtime_error& e) {
+        qWarning() << "Failed to read raw capture" << e.what();
+        QMessageBox::warning(this, tr("Failed to open file"), tr("Failed to open file") + ": " + path + ' ' + e.what());
+        utf8Decoder.reset();
+        delete textFile;
+        return;
+    }
+    // A sequence cut off at the end of the capture is never completed
+    utf8Decoder.reset();
+    qInfo() << "Opening raw capture" << path;
+
+    if (textFile) {
+        openLargeFile(textFile->fileName());
+        if (!largeFileView) {
+            delete textFile;
+            return;
+        }
+        largeFileTemporary = textFile;
+        return;
+    }
+
+    doc->setReadWrite(true);
+    doc->setText(text);
+    doc->setReadWrite(false);
+    documentBytes = bytes;
+    documentLines = lines;
+    updateSizeLabel();
+}
+
+void MainWindow::handleRawCaptureAction(const bool checked)
+{
+    if (!checked) {
+        stopRawCapture();
+        return;
+    }
+
+    const auto defaultName = QString("%1_%2.raw").arg(QFileInfo(currentPortName).fileName(), QDateTime::currentDateTime().toString(Qt::DateFormat::ISODate));
+    const auto path = QFileDialog::getSaveFileName(this,
+        tr("Raw capture"),
+        QDir(longTermRunModePath).filePath(defaultName),
+        tr("Raw captures (*.raw);;All files (*)"));
+    if (path.isEmpty()) {
+        ui->actionRawCapture->setChecked(false);
+        return;
+    }
+    // The writer refuses to overwrite, the dialog has already asked about it
+    if (QFile::exists(path) && !QFile::remove(path)) {
+        QMessageBox::warning(this, tr("Raw capture"), tr("Failed to replace %1").arg(path));
+        ui->actionRawCapture->setChecked(false);
+        return;
+    }
+
+    try {
+        rawCaptureWriter = new RawCaptureWriter(path, this);
+    } catch (const std::runtime_error& e) {
+        qWarning() << "Failed to start raw capture" << e.what();
+        QMessageBox::warning(this, tr("Raw capture"), e.what());
+        ui->actionRawCapture->setChecked(false);
+        return;
+    }
+    connect(rawCaptureWriter, &RawCaptureWriter::errorOccurred, this, &MainWindow::handleRawCaptureError);
+    rawCaptureWriter->start(QThread::LowPriority);
+    QMetaObject::invokeMethod(
+        serialReader, [this, writer = rawCaptureWriter]() { serialReader->setRawCapture(writer); }, Qt::BlockingQueuedConnection);
+
+    qInfo() << "Raw capture started:" << path;
+    ui->statusbar->showMessage(tr("Raw capture to %1").arg(path), 3000);
+}
+
+void MainWindow::stopRawCapture()
+{
+    if (!rawCaptureWriter) {
+        return;
+    }
+    // The reader must not append to a writer that is being destroyed
+    QMetaObject::invokeMethod(
+        serialReader, [this]() { serialReader->setRawCapture(nullptr); }, Qt::BlockingQueuedConnection);
+    const auto path = rawCaptureWriter->fileName();
+    delete rawCaptureWriter;
+    rawCaptureWriter = nullptr;
+
+    qInfo() << "Raw capture stopped:" << path;
+    ui->statusbar->showMessage(tr("Raw capture saved to %1").arg(path), 3000);
+}
+
+void MainWindow::handleRawCaptureError(const QString& msg)
+{
+    const auto errMsg = tr("Failed to write raw capture: %1").arg(msg);
+    ui->statusbar->showMessage(errMsg);
+    auto message = new KTextEditor::Message(errMsg, KTextEditor::Message::Error);
+    message->setAutoHide(0);
+    doc->postMessage(message);
+}
+
+void MainWindow::handleArchiveChunk(const QByteArray& data)
+{
+    // Chunks that were already queued when the reader was replaced
+    if (sender() != archiveReader) {
+        return;
+    }
+
+    // Archives hold exactly what was received, so they need the same cleanup as live data. The
+    // triggers and the long term run mode only apply to live data.
+    auto chunk = data;
+    lineFramer.frame(chunk.data(), static_cast<size_t>(chunk.size()));
+    documentBytes += chunk.size();
+    documentLines += static_cast<qint64>(lineFramer.newlines().size());
+
+    // Too much for the document, the rest goes into a file for the large file viewer
+    if (!archiveTextFile && documentBytes > LARGE_FILE_THRESHOLD && !moveArchivesToFile()) {
+        std::exchange(archiveReader, nullptr)->deleteLater();
+        archiveChunksPending = 0;
+        return;
+    }
+    if (archiveTextFile) {
+        const auto utf8 = utf8Decoder.decode(chunk.constData(), static_cast<size_t>(chunk.size())).toUtf8();
+        documentBytes += utf8Decoder.sizeDifference();
+        if (archiveTextFile->write(utf8) != utf8.size()) {
+            handleArchiveReadError(archiveTextFile->fileName() + ' ' + archiveTextFile->errorString());
+            std::exchange(archiveReader, nullptr)->deleteLater();
+            delete std::exchange(archiveTextFile, nullptr);
+            return;
+        }
+        archiveReader->chunkConsumed();
+        updateSizeLabel();
+        return;
+    }
+
+    pendingData.append(chunk);
+    archiveChunksPending++;
+
+    if (!flushTimer->isActive()) {
+        flushTimer->start(flushIntervalMs);
+    }
+}
+
+void MainWindow::handleArchiveReadError(const QString& msg)
+{
+    const auto errMsg = tr("Failed to read archive: %1").arg(msg);
+    ui->statusbar->showMessage(errMsg);
+    auto message = new KTextEditor::Message(errMsg, KTextEditor::Message::Warning);
+    message->setAutoHide(0);
+    doc->postMessage(message);
+}
+
+void MainWindow::handleOpenArchiveAction()
+{
+    const auto files = QFileDialog::getOpenFileNames(this,
+        tr("Open archive"),
+        longTermRunModePath,
+        tr("Archives (*.txt.zst);;All files (*)"));
+    if (files.isEmpty()) {
+        return;
+    }
+    closeSerialPort();
+    ui->startStopButton->setEnabled(false);
+    setWindowTitle(PROJECT_NAME + QString(" ") + files.first());
+
+    // Rotated archives are named by date, so name order is the order they were written in
+    auto sorted = files;
+    sorted.sort();
+    openArchives(sorted);
+}
+
+void MainWindow::handleOpenArchiveDirectoryAction()
+{
+    const auto directory = QFileDialog::getExistingDirectory(this, tr("Open archive directory"), longTermRunModePath);
+    if (directory.isEmpty()) {
+        return;
     }
+    closeSerialPort();
+    ui->startStopButton->setEnabled(false);
+    setWindowTitle(PROJECT_NAME + QString(" ") + directory);
+    openArchives(ArchiveReader::archivesInDirectory(directory));
+}
+
+void MainWindow::handleSearchArchivesAction()
+{
+    if (!archiveSearchDialog) {
+        archiveSearchDialog = new ArchiveSearchDialog(this);
+        connect(archiveSearchDialog, &ArchiveSearchDialog::archiveActivated, this, &MainWindow::handleSearchResultActivated);
+    }
+    archiveSearchDialog->setDirectory(longTermRunModePath);
+    archiveSearchDialog->show();
+    archiveSearchDialog->raise();
+}
+
+void MainWindow::handleSearchResultActivated(const QString& path, const qint64 line)
+{
+    closeSerialPort();
+    ui->startStopButton->setEnabled(false);
+    setWindowTitle(PROJECT_NAME + QString(" ") + path);
+    // Archives written before the line index existed have to be read in full
+    if (openArchiveAt(path, line)) {
+        return;
+    }
+    openArchives({ path });
+    if (archiveReader) {
+        archiveJumpLine = line;
+    }
+}
+
+void MainWindow::handleGoToArchiveAction()
+{
+    const auto path = QFileDialog::getOpenFileName(this,
+        tr("Go to line or time in archive"),
+        longTermRunModePath,
+        tr("Archives (*.txt.zst);;All files (*)"));
+    if (path.isEmpty()) {
+        return;
+    }
+    bool ok {};
+    const auto input = QInputDialog::getText(this,
+        tr("Go to line or time in archive"),
+        tr("Line number or time (yyyy-MM-dd hh:mm:ss):"),
+        QLineEdit::Normal,
+        {},
+        &ok);
+    const auto trimmed = input.trimmed();
+    if (!ok || trimmed.isEmpty()) {
+        return;
+    }
+
+    // Line numbers are entered the way the editor shows them, starting from 1
+    auto line = trimmed.toLongLong(&ok) - 1;
+    qint64 timestamp = -1;
+    if (!ok) {
+        auto time = QDateTime::fromString(trimmed, "yyyy-MM-dd hh:mm:ss");
+        if (!time.isValid()) {
+            time = QDateTime::fromString(trimmed, Qt::ISODate);
+        }
+        if (!time.isValid()) {
+            QMessageBox::warning(this, tr("Go to line or time in archive"), tr("Not a line number or a time: %1").arg(trimmed));
+            return;
+        }
+        line = -1;
+        timestamp = time.toMSecsSinceEpoch();
+    } else if (line < 0) {
+        QMessageBox::warning(this, tr("Go to line or time in archive"), tr("Not a line number or a time: %1").arg(trimmed));
+        return;
+    }
+
+    closeSerialPort();
+    ui->startStopButton->setEnabled(false);
+    setWindowTitle(PROJECT_NAME + QString(" ") + path);
+    if (!openArchiveAt(path, line, timestamp)) {
+        QMessageBox::warning(this, tr("Go to line or time in archive"), tr("%1 has no line index or can't be read").arg(path));
+    }
+}
+
+void MainWindow::closeSerialPort()
+{
+    QMetaObject::invokeMethod(serialReader, &SerialReader::close, Qt::BlockingQueuedConnection);
+    handleDataAvailable();
 }
 
 #ifdef SYSTEMD_AVAILABLE
@@ -462,68 +1529,3 @@ void MainWindow::setInhibit(const bool enabled)
     inhibitFd = newFd;
 }
 #endif
-
-void MainWindow::writeCompressedFile(const QByteArray& contents, const int counter)
-{
-    const auto contentsLen = contents.size();
-
-    if (!contentsLen) {
-        qWarning() << "Attempt to write empty file";
-        return;
-    }
-
-    // In case this function gets called multiple times rapidly, the `currentDateTime()` function
-    // will return the same value and therefore we will attempt to use the same filename more than
-    // once. In order to prevent this we prepend the filename with an incrementing counter.
-    const auto filename = QString("%1/%2_%3.txt.zst")
-                              .arg(longTermRunModePath,
-                                  QDateTime::currentDateTime().toString(Qt::DateFormat::ISODate),
-                                  (QStringLiteral("%1").arg(counter, 8, 10, QLatin1Char('0'))));
-
-    qInfo() << "Saving" << filename << contentsLen;
-
-    QFile file(filename);
-    if (const auto result = file.open(QIODevice::WriteOnly | QIODevice::NewOnly); !result) {
-        const auto msg = QString("Failed to open: %1 %2 %3").arg(filename).arg(static_cast<int>(result)).arg(errno);
-        qCritical() << msg;
-        throw std::runtime_error(msg.toStdString());
-    }
-
-    if (!zstdCtx) {
-        zstdCtx = ZSTD_createCCtx();
-        if (!zstdCtx) {
-            throw std::runtime_error("Failed to create zstd ctx");
-        }
-        validateZstdResult(ZSTD_CCtx_setParameter(zstdCtx, ZSTD_c_checksumFlag, 1));
-        validateZstdResult(ZSTD_CCtx_setParameter(zstdCtx, ZSTD_c_strategy, ZSTD_fast));
-        zstdOutBuffer.resize(ZSTD_CStreamOutSize()); // This returns approx 128KiB
-    } else {
-        validateZstdResult(ZSTD_CCtx_reset(zstdCtx, ZSTD_reset_session_only));
-    }
-
-    Q_ASSERT(contentsLen > 0);
-    ZSTD_inBuffer input = { contents.data(), static_cast<size_t>(contentsLen), 0 };
-
-    bool finished {};
-    do {
-        ZSTD_outBuffer out = { zstdOutBuffer.data(), zstdOutBuffer.size(), 0 };
-        const auto remaining = ZSTD_compressStream2(zstdCtx, &out, &input, ZSTD_e_end);
-        validateZstdResult(remaining);
-
-        file.write(zstdOutBuffer.data(), static_cast<qint64>(out.pos));
-
-        finished = (remaining == 0);
-
-    } while (!finished);
-
-    file.flush();
-    fsync(file.handle());
-    file.close();
-}
-
-void MainWindow::validateZstdResult(const size_t result, const std::experimental::source_location srcLoc)
-{
-    if (ZSTD_isError(result)) {
-        throw std::runtime_error(std::string("ZSTD error: ") + ZSTD_getErrorName(result) + " " + std::to_string(srcLoc.line()));
-    }
-}
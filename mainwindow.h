@@ -1,16 +1,25 @@
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
 
-#include <zstd.h>
-
 #include <QElapsedTimer>
 #include <QMainWindow>
 #include <QPointer>
 #include <QtSerialPort/QSerialPort>
 
+#include "adaptivehighlighting.h"
+#include "lineframer.h"
+#include "linetimestamps.h"
+#include "serialreader.h"
+#include "triggerengine.h"
+#include "triggersetupdialog.h"
+#include "utf8decoder.h"
+
+#include <KTextEditor/TextHintInterface>
+
+#include <map>
+#include <memory>
+#include <tuple>
 #include <vector>
-// #include <source_location>
-#include <experimental/source_location>
 
 QT_BEGIN_NAMESPACE
 namespace Ui {
@@ -33,20 +42,43 @@ enum class ProgramState {
 
 class QSoundEffect;
 class QTimer;
-class TriggerSetupDialog;
 class LongTermRunModeDialog;
+class ScrollbackDialog;
 class QElapsedTimer;
+class QLabel;
+class ArchiveWriter;
+class QThread;
+class LargeFileView;
+class QTemporaryFile;
+class ArchiveReader;
+class StatsDialog;
+class ArchiveSearchDialog;
+class RawCaptureWriter;
+class HighlightingDialog;
 
-class MainWindow : public QMainWindow {
+class MainWindow : public QMainWindow, public KTextEditor::TextHintProvider {
     Q_OBJECT
 
 public:
+    // Connects to the port given on the command line, or asks for one
     MainWindow(QWidget* parent = nullptr);
+    // Connects to `port`, which can also be a file or an archive directory like on the command line
+    MainWindow(const QString& port, const int baud, const PortSettings& settings = {}, QWidget* parent = nullptr);
     ~MainWindow();
 
+    // Shows when the line under the mouse was received
+    QString textHint(KTextEditor::View* view, const KTextEditor::Cursor& position) override;
+
+protected:
+    void changeEvent(QEvent* event) override;
+
 private slots:
-    void handleReadyRead();
+    void handleDataAvailable();
+    void handleFlushTimer();
+    void handleRefreshRateAction(QAction* action);
+    void handleInvalidUtf8Action(QAction* action);
     void handleError(const QSerialPort::SerialPortError error);
+    void handleSerialErrors(const SerialErrorCounts& counts);
 
     void handleSaveAction();
     void handleClearAction();
@@ -61,6 +93,22 @@ private slots:
     void handleLongTermRunModeAction();
     void handleLongTermRunModeDialogDone(int result);
     void handleLongTermRunModeTimer();
+    void handleArchiveError(const QString& msg);
+    void handleScrollbackAction();
+    void handleScrollbackDialogDone(int result);
+    void handleOpenArchiveAction();
+    void handleOpenArchiveDirectoryAction();
+    void handleSearchArchivesAction();
+    void handleSearchResultActivated(const QString& path, const qint64 line);
+    void handleGoToArchiveAction();
+    void handleArchiveChunk(const QByteArray& data);
+    void handleArchiveReadError(const QString& msg);
+    void handleStatisticsAction();
+    void handleRawCaptureAction(const bool checked);
+    void handleRawCaptureError(const QString& msg);
+    void handleHighlightingAction();
+    void handleHighlightingDialogDone(int result);
+    void handleHighlightingTimer();
 
 private:
     Ui::MainWindow* ui {};
@@ -69,39 +117,160 @@ private:
     KTextEditor::Document* doc {};
     KTextEditor::View* view {};
     QPointer<KTextEditor::Message> serialErrorMsg {};
+    QPointer<KTextEditor::Message> archiveErrorMsg {};
+
+    MainWindow(const std::tuple<QString, int, PortSettings>& port, QWidget* parent);
 
     void setProgramState(const ProgramState newState);
-    [[nodiscard]] std::pair<QString, int> getPortFromUser() const;
+    [[nodiscard]] static std::tuple<QString, int, PortSettings> getPortFromUser();
+    // The port given on the command line, or the one picked by the user if there is none. Throws
+    // std::runtime_error.
+    [[nodiscard]] static std::tuple<QString, int, PortSettings> portFromArguments();
 
     void connectToDevice(const QString& port, const int baud, const bool showMsgOnOpenErr = true);
-    QSerialPort* serialPort {};
+    void closeSerialPort();
+    void processChunk(char* data, const size_t len);
+    void flushPendingData();
+    void updateSizeLabel();
+    // Empties the document and everything kept along with it. The memory is kept for reuse, which
+    // is what a rotation wants; the Clear action also gives it back.
+    void resetDocumentState();
+    void enforceScrollback();
+    // Passes the dictionary settings of the long term run mode dialog on to the archive writer
+    void applyArchiveDictionary();
+    void openLargeFile(const QString& path);
+    void closeLargeFile();
+    void openArchives(const QStringList& files);
+    // Shows the frames of a seekable archive around `line`, or if it is negative around the first
+    // line received at `timestamp`, in milliseconds since the epoch. Only those frames are
+    // decompressed. False if the archive has no line index or can't be read.
+    [[nodiscard]] bool openArchiveAt(const QString& path, qint64 line, const qint64 timestamp = -1);
+    // Switches the archives being opened over to archiveTextFile, false if it can't be written
+    [[nodiscard]] bool moveArchivesToFile();
+    void openRawCapture(const QString& path);
+    void stopRawCapture();
+    void applyHighlighting();
+
+    // Serial port is read on its own thread and the data is handed to us through the ring buffer
+    std::unique_ptr<RingBuffer> ringBuffer;
+    QThread* readerThread {};
+    SerialReader* serialReader {};
+    QString currentPortName {};
+    int currentBaud {};
+    // Kept for reconnects
+    PortSettings currentPortSettings {};
+    QSerialPort::SerialPortError lastSerialError = QSerialPort::NoError;
+
+    // Lost or corrupted bytes reported by the kernel. The affected lines get an error mark and the
+    // details are shown in their text hint, keyed by line number counted from the first line
+    // received, i.e. including the lines evicted from the scrollback.
+    SerialErrorCounts serialErrorTotals {};
+    std::map<qint64, QString> serialErrorNotes {};
+    qint64 evictedLines {};
+    QLabel* serialErrorLabel {};
+
+    // Every byte exactly as it was read, written by the serial reader's thread while enabled
+    RawCaptureWriter* rawCaptureWriter {};
+
+    // Incoming data is collected here and inserted into the document at most once per frame
+    QByteArray pendingData {};
+    Utf8Decoder utf8Decoder {};
+    QTimer* flushTimer {};
+    int flushIntervalMs = 1000 / DEFAULT_REFRESH_RATE;
+
+    // Kept up to date by the ingest path so that size based decisions don't need doc->text().
+    // Covers the document and whatever is still pending.
+    qint64 documentBytes {};
+    qint64 documentLines {};
+    QLabel* sizeLabel {};
+
+    // Replaces the editor view while a file too large for the document is open
+    LargeFileView* largeFileView {};
+    // What largeFileView shows if it was decoded from a raw capture, removed along with it
+    QTemporaryFile* largeFileTemporary {};
+
+    // Decodes archives that were opened for viewing. Chunks are acknowledged once they have been
+    // inserted into the document.
+    ArchiveReader* archiveReader {};
+    int archiveChunksPending {};
+    // Line to show once the archive that is being opened has been read, -1 for none
+    qint64 archiveJumpLine = -1;
+    // Once the archives being opened pass LARGE_FILE_THRESHOLD, what has been decoded so far is
+    // moved here and the rest follows, to be shown in the large file viewer
+    QTemporaryFile* archiveTextFile {};
+    ArchiveSearchDialog* archiveSearchDialog {};
+
     QSoundEffect* sound {};
     TriggerSetupDialog* triggerSetupDialog {};
 
     QElapsedTimer elapsedTimer;
 
-    QByteArray triggerKeyword {};
-    bool triggerActive {};
-    int triggerMatchCount {};
+    // Receive time of every line in the document, evicted along with the scrollback. `ingestOffset`
+    // counts the bytes taken from the ring buffer so that they can be matched with the reader's
+    // arrival records.
+    LineTimestamps lineTimestamps {};
+    std::vector<int64_t> chunkLineTimestamps {};
+    uint64_t ingestOffset {};
+    bool atLineStart = true;
+
+    LineFramer lineFramer {};
+    TriggerEngine triggerEngine {};
+    QList<TriggerKeyword> triggerKeywords {};
 
     ProgramState currentProgramState = ProgramState::Unknown;
     QTimer* timer {};
 
-    QByteArray triggerSearchLine {};
-
     // Long term run mode
     LongTermRunModeDialog* longTermRunModeDialog {};
     bool longTermRunModeEnabled {};
+    bool longTermRunModeStreaming {};
+    qint64 longTermRunModeStreamedBytes {};
     int longTermRunModeMaxMemory {};
     int longTermRunModeMaxTime {};
     QString longTermRunModePath {};
+    // What the archive writer was last told, so that accepting the dialog again doesn't throw
+    // away a trained dictionary
+    QString longTermRunModeDictionaryFile {};
+    int longTermRunModeDictionaryMiB {};
     qint64 longTermRunModeStartTime {};
     QTimer* longTermRunModeTimer {};
-    ZSTD_CCtx* zstdCtx {};
-    std::vector<char> zstdOutBuffer {};
+    ArchiveWriter* archiveWriter {};
     int fileCounter {};
 
-    static inline constexpr auto HIGHLIGHT_MODE = "Log File (advanced)";
+    StatsDialog* statsDialog {};
+
+    // Highlighting is reduced while the data comes in fast or the document is large
+    AdaptiveHighlighting highlighting {};
+    HighlightingDialog* highlightingDialog {};
+    QTimer* highlightingTimer {};
+    QLabel* highlightingLabel {};
+
+    // Bounded scrollback
+    ScrollbackDialog* scrollbackDialog {};
+    bool scrollbackEnabled {};
+    int scrollbackMaxLines {};
+    qint64 scrollbackMaxBytes {};
+    bool scrollbackArchiveEvicted {};
+    // Snapshot mode: everything received since the last archive, which is written from this copy
+    // rather than from the document. Evicted lines stay in it if they are to be archived,
+    // `snapshotEvictedLines` of them.
+    QByteArray snapshotData {};
+    qint64 snapshotEvictedLines {};
+
+    static inline constexpr int DEFAULT_REFRESH_RATE = 60;
+    // Once over the scrollback limit, evict down to this percentage of it so that eviction
+    // happens in large, infrequent batches.
+    static inline constexpr int SCROLLBACK_LOW_WATERMARK = 90;
+    static inline constexpr int HIGHLIGHTING_INTERVAL_MS = 250;
+
+    // Roughly 13 seconds worth of data at 12 Mbaud before the reader has to start queueing in
+    // QSerialPort's internal buffer.
+    static inline constexpr size_t RING_BUFFER_SIZE = 16 * 1024 * 1024;
+
+    // Files larger than this are opened in the memory mapped viewer instead of the editor
+    static inline constexpr qint64 LARGE_FILE_THRESHOLD = 64 * 1024 * 1024;
+    // Frames shown on either side of the one jumped to in an archive, about a MiB each
+    static inline constexpr qsizetype ARCHIVE_CONTEXT_FRAMES = 2;
 
 #ifdef SYSTEMD_AVAILABLE
     int inhibitFd {};
@@ -109,8 +278,5 @@ private:
     void setInhibit(const bool enabled);
 
 #endif
-
-    void writeCompressedFile(const QByteArray& contents, const int counter);
-    static void validateZstdResult(const size_t result, const std::experimental::source_location = std::experimental::source_location::current());
 };
 #endif // MAINWINDOW_H
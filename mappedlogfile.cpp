@@ -0,0 +1,147 @@
+#include "mappedlogfile.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedLogFile::MappedLogFile(const std::string& path)
+{
+    const auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open " + path + ": " + strerror(errno));
+    }
+
+    struct stat st {};
+    if (fstat(fd, &st) < 0) {
+        const auto err = errno;
+        ::close(fd);
+        throw std::runtime_error("Failed to stat " + path + ": " + strerror(err));
+    }
+    fileSize = static_cast<uint64_t>(st.st_size);
+
+    if (fileSize) {
+        auto* mapping = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            const auto err = errno;
+            ::close(fd);
+            throw std::runtime_error("Failed to map " + path + ": " + strerror(err));
+        }
+        data = static_cast<const char*>(mapping);
+    }
+    // The mapping keeps the file alive
+    ::close(fd);
+
+    index.push_back(scanChunk(0, std::min(fileSize, PREFIX_SIZE), nullptr));
+    fullyIndexed = fileSize <= PREFIX_SIZE;
+}
+
+MappedLogFile::~MappedLogFile()
+{
+    if (data) {
+        munmap(const_cast<char*>(data), fileSize);
+    }
+}
+
+MappedLogFile::Chunk MappedLogFile::scanChunk(const uint64_t begin, const uint64_t end, const std::atomic_bool* cancel) const
+{
+    Chunk chunk;
+
+    // A line belongs to the chunk its first byte is in
+    auto addLineStart = [&](const uint64_t offset) {
+        if (chunk.lineCount % CHECKPOINT_INTERVAL == 0) {
+            chunk.checkpoints.push_back(offset);
+        }
+        chunk.lineCount++;
+    };
+
+    if (begin < end && (begin == 0 || data[begin - 1] == '\n')) {
+        addLineStart(begin);
+    }
+
+    auto pos = begin;
+    while (pos < end) {
+        const auto* nl = static_cast<const char*>(memchr(data + pos, '\n', end - pos));
+        if (!nl) {
+            break;
+        }
+        pos = static_cast<uint64_t>(nl - data) + 1;
+        if (pos < end) {
+            addLineStart(pos);
+        }
+
+        if (cancel && (chunk.lineCount % (1024 * 1024)) == 0 && cancel->load(std::memory_order_relaxed)) {
+            break;
+        }
+    }
+    return chunk;
+}
+
+MappedLogFile::Index MappedLogFile::buildIndex(const std::atomic_bool& cancel) const
+{
+    const auto threadCount = std::max(1u, std::thread::hardware_concurrency());
+    const auto chunkSize = std::max<uint64_t>(fileSize / threadCount + 1, PREFIX_SIZE);
+
+    Index newIndex((fileSize + chunkSize - 1) / chunkSize);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < newIndex.size(); i++) {
+        const auto begin = i * chunkSize;
+        const auto end = std::min(fileSize, begin + chunkSize);
+        threads.emplace_back([&, i, begin, end]() { newIndex[i] = scanChunk(begin, end, &cancel); });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    uint64_t firstLine {};
+    for (auto& chunk : newIndex) {
+        chunk.firstLine = firstLine;
+        firstLine += chunk.lineCount;
+    }
+    return newIndex;
+}
+
+void MappedLogFile::setIndex(Index&& newIndex)
+{
+    index = std::move(newIndex);
+    fullyIndexed = true;
+}
+
+uint64_t MappedLogFile::lineCount() const
+{
+    if (index.empty()) {
+        return 0;
+    }
+    return index.back().firstLine + index.back().lineCount;
+}
+
+std::string_view MappedLogFile::line(const uint64_t line) const
+{
+    if (line >= lineCount()) {
+        return {};
+    }
+
+    const auto chunk = std::upper_bound(index.begin(), index.end(), line,
+                           [](const uint64_t l, const Chunk& c) { return l < c.firstLine; })
+        - 1;
+
+    const auto local = line - chunk->firstLine;
+    auto offset = chunk->checkpoints[local / CHECKPOINT_INTERVAL];
+    for (auto skip = local % CHECKPOINT_INTERVAL; skip; skip--) {
+        const auto* nl = static_cast<const char*>(memchr(data + offset, '\n', fileSize - offset));
+        offset = static_cast<uint64_t>(nl - data) + 1;
+    }
+
+    const auto* nl = static_cast<const char*>(memchr(data + offset, '\n', fileSize - offset));
+    auto end = nl ? static_cast<uint64_t>(nl - data) : fileSize;
+    if (end > offset && data[end - 1] == '\r') {
+        end--;
+    }
+    return { data + offset, end - offset };
+}
@@ -0,0 +1,57 @@
+#ifndef MAPPEDLOGFILE_H
+#define MAPPEDLOGFILE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Read-only memory mapped log file with a sparse line index. Only the offset of every
+// CHECKPOINT_INTERVAL-th line is stored, so the index of a multi-gigabyte file stays small.
+//
+// Opening the file only indexes the first PREFIX_SIZE bytes so that the first screen can be
+// shown right away. The full index is built with `buildIndex()`, which splits the file across
+// all cores and can be run on a background thread, and then installed with `setIndex()`.
+class MappedLogFile {
+public:
+    struct Chunk {
+        uint64_t firstLine {};
+        uint64_t lineCount {};
+        // checkpoints[k] is the offset of line (firstLine + k * CHECKPOINT_INTERVAL)
+        std::vector<uint64_t> checkpoints {};
+    };
+    using Index = std::vector<Chunk>;
+
+    // Throws std::runtime_error if the file can't be opened or mapped
+    explicit MappedLogFile(const std::string& path);
+    ~MappedLogFile();
+
+    MappedLogFile(const MappedLogFile&) = delete;
+    MappedLogFile& operator=(const MappedLogFile&) = delete;
+
+    // Thread safe, doesn't touch the installed index
+    [[nodiscard]] Index buildIndex(const std::atomic_bool& cancel) const;
+    void setIndex(Index&& newIndex);
+
+    [[nodiscard]] bool isFullyIndexed() const { return fullyIndexed; }
+    [[nodiscard]] uint64_t lineCount() const;
+    [[nodiscard]] uint64_t size() const { return fileSize; }
+
+    // Without the line terminator. Empty if `line` is out of range.
+    [[nodiscard]] std::string_view line(const uint64_t line) const;
+
+private:
+    static inline constexpr uint64_t CHECKPOINT_INTERVAL = 64;
+    static inline constexpr uint64_t PREFIX_SIZE = 1024 * 1024;
+
+    const char* data {};
+    uint64_t fileSize {};
+    Index index {};
+    bool fullyIndexed {};
+
+    [[nodiscard]] Chunk scanChunk(const uint64_t begin, const uint64_t end, const std::atomic_bool* cancel) const;
+};
+
+#endif // MAPPEDLOGFILE_H
@@ -0,0 +1,292 @@
+#include "multiportwindow.h"
+#include "./ui_multiportwindow.h"
+#include "linetimestamps.h"
+#include "stats.h"
+#include "statsdialog.h"
+#include "triggersetupdialog.h"
+#include "yetty.version.h"
+
+#include <KTextEditor/Document>
+#include <KTextEditor/Editor>
+#include <KTextEditor/View>
+
+#include <QDebug>
+#include <QMessageBox>
+#include <QThread>
+#include <QTimer>
+
+#include <algorithm>
+
+MultiPortWindow::MultiPortWindow(const std::vector<PortCapture::Options>& ports, const int maxLines, QWidget* parent)
+    : QMainWindow(parent)
+    , ui(new Ui::MultiPortWindow)
+    , ioThread(new QThread(this))
+    , flushTimer(new QTimer(this))
+    , highlightingTimer(new QTimer(this))
+    , scrollbackLines(maxLines)
+{
+    elapsedTimer.start();
+    ui->setupUi(this);
+    setWindowTitle(QString("%1 (%2 ports)").arg(PROJECT_NAME).arg(ports.size()));
+
+    ioThread->setObjectName("SerialIO");
+    ioThread->start(QThread::TimeCriticalPriority);
+
+    auto* editor = KTextEditor::Editor::instance();
+    try {
+        for (const auto& port : ports) {
+            auto tab = std::make_unique<Tab>();
+            auto* t = tab.get();
+            tab->capture = new PortCapture(port, ioThread, this);
+            tab->doc = editor->createDocument(this);
+            tab->doc->setReadWrite(false);
+            tab->doc->setMarkDescription(KTextEditor::Document::Error, tr("Serial errors"));
+            tab->doc->setMarkIcon(KTextEditor::Document::Error, QIcon::fromTheme("dialog-error"));
+            tab->view = tab->doc->createView(ui->tabWidget);
+            ui->tabWidget->addTab(tab->view, port.port);
+            applyHighlighting(*tab);
+
+            connect(tab->capture, &PortCapture::dataProcessed, this, [this, t](const char* data, const size_t len) {
+                t->pendingData.append(data, static_cast<qsizetype>(len));
+                t->highlighting.record(len);
+                if (!flushTimer->isActive()) {
+                    flushTimer->start(FLUSH_INTERVAL_MS);
+                }
+            }, Qt::DirectConnection);
+            connect(tab->capture, &PortCapture::triggerMatched, this, [this, t](const QStringList& matches) {
+                handleTrigger(*t, matches);
+            });
+            connect(tab->capture, &PortCapture::connected, this, [this, t]() {
+                ui->tabWidget->setTabIcon(ui->tabWidget->indexOf(t->view), {});
+            });
+            connect(tab->capture, &PortCapture::errorOccurred, this, [this, t](const QString& msg) {
+                ui->tabWidget->setTabIcon(ui->tabWidget->indexOf(t->view), QIcon::fromTheme("network-disconnect"));
+                ui->statusbar->showMessage(QString("%1: %2").arg(t->capture->options().port, msg));
+            });
+            connect(tab->capture, &PortCapture::serialErrors, this, [this, t](const SerialErrorCounts& counts) {
+                handleSerialErrors(*t, counts);
+            });
+            connect(tab->capture, &PortCapture::archiveErrorOccurred, this, [this, t](const QString& msg) {
+                ui->statusbar->showMessage(tr("%1: Failed to write archive: %2").arg(t->capture->options().port, msg));
+            });
+            tabs.push_back(std::move(tab));
+        }
+    } catch (...) {
+        for (auto& tab : tabs) {
+            delete tab->capture;
+        }
+        ioThread->quit();
+        ioThread->wait();
+        delete ui;
+        throw;
+    }
+
+    flushTimer->setSingleShot(true);
+    connect(flushTimer, &QTimer::timeout, this, &MultiPortWindow::handleFlushTimer);
+    connect(ui->tabWidget, &QTabWidget::currentChanged, this, &MultiPortWindow::handleCurrentTabChanged);
+    connect(highlightingTimer, &QTimer::timeout, this, &MultiPortWindow::handleHighlightingTimer);
+    highlightingTimer->start(HIGHLIGHTING_INTERVAL_MS);
+
+    connect(ui->actionQuit, &QAction::triggered, this, &QWidget::close);
+    ui->actionQuit->setShortcut(QKeySequence::Quit);
+    ui->actionQuit->setIcon(QIcon::fromTheme("application-exit"));
+
+    connect(ui->actionClear, &QAction::triggered, this, &MultiPortWindow::handleClearAction);
+    ui->actionClear->setShortcut(QKeySequence(Qt::CTRL | Qt::SHIFT | Qt::Key_K));
+    ui->actionClear->setIcon(QIcon::fromTheme("edit-clear-all"));
+
+    connect(ui->actionTrigger, &QAction::triggered, this, &MultiPortWindow::handleTriggerSetupAction);
+    ui->actionTrigger->setIcon(QIcon::fromTheme("mail-thread-watch"));
+
+    connect(ui->actionStatistics, &QAction::triggered, this, &MultiPortWindow::handleStatisticsAction);
+
+    for (auto& tab : tabs) {
+        tab->capture->start();
+    }
+}
+
+MultiPortWindow::~MultiPortWindow()
+{
+    // The captures need the I/O thread to shut down their readers
+    for (auto& tab : tabs) {
+        delete tab->capture;
+    }
+    ioThread->quit();
+    ioThread->wait();
+    delete ui;
+}
+
+MultiPortWindow::Tab* MultiPortWindow::currentTab() const
+{
+    const auto index = ui->tabWidget->currentIndex();
+    if (index < 0 || static_cast<size_t>(index) >= tabs.size()) {
+        return nullptr;
+    }
+    return tabs[static_cast<size_t>(index)].get();
+}
+
+void MultiPortWindow::handleFlushTimer()
+{
+    // Nobody is looking at the documents while we are minimized
+    if (isMinimized()) {
+        flushTimer->start(BACKGROUND_FLUSH_INTERVAL_MS);
+        return;
+    }
+
+    const auto* current = currentTab();
+    const auto now = elapsedTimer.elapsed();
+    bool pending {};
+    for (auto& tab : tabs) {
+        if (tab->pendingData.isEmpty()) {
+            continue;
+        }
+        if (tab.get() == current || now - tab->lastFlushTime >= BACKGROUND_FLUSH_INTERVAL_MS) {
+            flush(*tab);
+        } else {
+            pending = true;
+        }
+    }
+
+    if (pending) {
+        flushTimer->start(FLUSH_INTERVAL_MS);
+    }
+}
+
+void MultiPortWindow::flush(Tab& tab)
+{
+    tab.lastFlushTime = elapsedTimer.elapsed();
+    if (tab.pendingData.isEmpty()) {
+        return;
+    }
+
+    auto& stats = Stats::instance();
+    stats.pendingBytes.set(static_cast<uint64_t>(tab.pendingData.size()));
+    const auto& text = [&]() -> const QString& {
+        StatTimer timer(stats.decodeTime);
+        return tab.decoder.decode(tab.pendingData.constData(), static_cast<size_t>(tab.pendingData.size()));
+    }();
+    stats.invalidUtf8Bytes.add(tab.decoder.invalidBytes());
+    tab.documentBytes += tab.pendingData.size() + tab.decoder.sizeDifference();
+    tab.doc->setReadWrite(true);
+    {
+        StatTimer timer(stats.insertTextTime);
+        tab.doc->insertText(tab.doc->documentEnd(), text);
+    }
+    if (scrollbackLines > 0 && tab.doc->lines() > scrollbackLines) {
+        const auto evictLines = tab.doc->lines() - static_cast<qint64>(scrollbackLines) * SCROLLBACK_LOW_WATERMARK / 100;
+        const KTextEditor::Range range(0, 0, static_cast<int>(evictLines), 0);
+        // Only once the scrollback has grown by a tenth, so converting the evicted text is cheap
+        tab.documentBytes = std::max<qint64>(0, tab.documentBytes - tab.doc->text(range).toUtf8().size());
+        tab.doc->removeText(range);
+    }
+    tab.doc->setReadWrite(false);
+
+    // clear() will free memory, resize(0) will not
+    tab.pendingData.resize(0);
+}
+
+void MultiPortWindow::handleHighlightingTimer()
+{
+    const auto now = LineTimestamps::now();
+    for (auto& tab : tabs) {
+        if (tab->highlighting.update(tab->documentBytes, now)) {
+            Stats::instance().highlightingChanges.add();
+            qInfo() << tab->capture->options().port << "switching to" << AdaptiveHighlighting::displayName(tab->highlighting.level())
+                    << "at" << tab->highlighting.rate() << "bytes/s with" << tab->documentBytes << "bytes";
+            applyHighlighting(*tab);
+        }
+    }
+}
+
+void MultiPortWindow::applyHighlighting(Tab& tab)
+{
+    auto mode = AdaptiveHighlighting::modeName(tab.highlighting.level());
+    if (!tab.doc->highlightingModes().contains(mode)) {
+        mode = AdaptiveHighlighting::modeName(AdaptiveHighlighting::Level::Plain);
+    }
+    tab.doc->setHighlightingMode(mode);
+    ui->tabWidget->setTabToolTip(ui->tabWidget->indexOf(tab.view), AdaptiveHighlighting::displayName(tab.highlighting.level()));
+}
+
+void MultiPortWindow::handleCurrentTabChanged(int index)
+{
+    ui->tabWidget->setTabIcon(index, {});
+    if (auto* tab = currentTab()) {
+        flush(*tab);
+    }
+}
+
+void MultiPortWindow::handleTrigger(Tab& tab, const QStringList& matches)
+{
+    ui->statusbar->showMessage(QString("%1: %2 matches").arg(tab.capture->options().port, matches.join(" │ ")), 3000);
+    if (&tab != currentTab()) {
+        ui->tabWidget->setTabIcon(ui->tabWidget->indexOf(tab.view), QIcon::fromTheme("dialog-warning"));
+    }
+}
+
+void MultiPortWindow::handleSerialErrors(Tab& tab, const SerialErrorCounts& counts)
+{
+    // The affected bytes are the last ones received, mark the line they went into
+    flush(tab);
+    const auto line = tab.doc->lines() - 1;
+    tab.doc->addMark(line, KTextEditor::Document::Error);
+    tab.view->setConfigValue("icon-bar", true);
+
+    ui->statusbar->showMessage(tr("%1: Serial errors at line %2: %3").arg(tab.capture->options().port).arg(line + 1).arg(counts.toString()));
+    if (&tab != currentTab()) {
+        ui->tabWidget->setTabIcon(ui->tabWidget->indexOf(tab.view), QIcon::fromTheme("dialog-error"));
+    }
+}
+
+void MultiPortWindow::handleClearAction()
+{
+    auto* tab = currentTab();
+    if (!tab) {
+        return;
+    }
+    tab->pendingData.resize(0);
+    tab->decoder.reset();
+    tab->documentBytes = 0;
+    tab->doc->setReadWrite(true);
+    tab->doc->clear();
+    tab->doc->setReadWrite(false);
+}
+
+void MultiPortWindow::handleTriggerSetupAction()
+{
+    auto* tab = currentTab();
+    if (!tab) {
+        return;
+    }
+
+    // Every port has its own dialog, so that it remembers that port's triggers
+    if (!tab->triggerSetupDialog) {
+        tab->triggerSetupDialog = new TriggerSetupDialog(this);
+        tab->triggerSetupDialog->setWindowTitle(tr("Triggers for %1").arg(tab->capture->options().port));
+        connect(tab->triggerSetupDialog, &QDialog::finished, this, [this, tab](int result) {
+            if (result != QDialog::Accepted) {
+                return;
+            }
+            std::vector<TriggerPattern> patterns;
+            for (const auto& trigger : tab->triggerSetupDialog->getKeywords()) {
+                patterns.push_back({ trigger.keyword.toStdString(), trigger.isRegex });
+            }
+            try {
+                tab->capture->setTriggers(patterns);
+            } catch (const std::invalid_argument& e) {
+                qWarning() << "Invalid trigger:" << e.what();
+                QMessageBox::warning(this, tr("Invalid trigger"), e.what());
+            }
+        });
+    }
+    tab->triggerSetupDialog->open();
+}
+
+void MultiPortWindow::handleStatisticsAction()
+{
+    if (!statsDialog) {
+        statsDialog = new StatsDialog(this);
+    }
+    statsDialog->show();
+    statsDialog->raise();
+}
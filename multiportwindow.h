@@ -0,0 +1,86 @@
+#ifndef MULTIPORTWINDOW_H
+#define MULTIPORTWINDOW_H
+
+#include "adaptivehighlighting.h"
+#include "portcapture.h"
+#include "utf8decoder.h"
+
+#include <QElapsedTimer>
+#include <QMainWindow>
+
+#include <memory>
+#include <vector>
+
+QT_BEGIN_NAMESPACE
+namespace Ui {
+class MultiPortWindow;
+}
+QT_END_NAMESPACE
+
+namespace KTextEditor {
+class Document;
+class View;
+}
+
+class QThread;
+class QTimer;
+class StatsDialog;
+class TriggerSetupDialog;
+
+// Shows several serial ports at once, one tab per port. The ports are all read on one I/O
+// thread, the documents share the KTextEditor instance and all tabs are flushed by one timer.
+// Tabs that aren't visible are only flushed every BACKGROUND_FLUSH_INTERVAL_MS. Every tab reduces
+// its highlighting on its own while its port is busy, see AdaptiveHighlighting.
+class MultiPortWindow : public QMainWindow {
+    Q_OBJECT
+
+public:
+    // Throws std::invalid_argument if one of the triggers can't be compiled
+    MultiPortWindow(const std::vector<PortCapture::Options>& ports, const int maxLines, QWidget* parent = nullptr);
+    ~MultiPortWindow();
+
+private slots:
+    void handleFlushTimer();
+    void handleCurrentTabChanged(int index);
+    void handleClearAction();
+    void handleTriggerSetupAction();
+    void handleStatisticsAction();
+    void handleHighlightingTimer();
+
+private:
+    struct Tab {
+        PortCapture* capture {};
+        KTextEditor::Document* doc {};
+        KTextEditor::View* view {};
+        TriggerSetupDialog* triggerSetupDialog {};
+        QByteArray pendingData {};
+        Utf8Decoder decoder {};
+        qint64 lastFlushTime {};
+        // UTF-8 size of the document, for the highlighting
+        qint64 documentBytes {};
+        AdaptiveHighlighting highlighting {};
+    };
+
+    Ui::MultiPortWindow* ui {};
+    QThread* ioThread {};
+    QTimer* flushTimer {};
+    QTimer* highlightingTimer {};
+    StatsDialog* statsDialog {};
+    QElapsedTimer elapsedTimer;
+    std::vector<std::unique_ptr<Tab>> tabs {};
+    const int scrollbackLines {};
+
+    static inline constexpr int FLUSH_INTERVAL_MS = 1000 / 60;
+    static inline constexpr int BACKGROUND_FLUSH_INTERVAL_MS = 1000;
+    // See MainWindow::SCROLLBACK_LOW_WATERMARK
+    static inline constexpr int SCROLLBACK_LOW_WATERMARK = 90;
+    static inline constexpr int HIGHLIGHTING_INTERVAL_MS = 250;
+
+    void flush(Tab& tab);
+    void applyHighlighting(Tab& tab);
+    [[nodiscard]] Tab* currentTab() const;
+    void handleTrigger(Tab& tab, const QStringList& matches);
+    void handleSerialErrors(Tab& tab, const SerialErrorCounts& counts);
+};
+
+#endif // MULTIPORTWINDOW_H
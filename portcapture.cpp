@@ -0,0 +1,215 @@
+#include "portcapture.h"
+#include "archivewriter.h"
+#include "rawcapture.h"
+#include "ringbuffer.h"
+#include "stats.h"
+
+#include <QDebug>
+#include <QThread>
+#include <QTimer>
+
+PortCapture::PortCapture(const Options& options, QThread* ioThread, QObject* parent)
+    : QObject(parent)
+    , captureOptions(options)
+    , ringBuffer(std::make_unique<RingBuffer>(RING_BUFFER_SIZE))
+    , retryTimer(new QTimer(this))
+    , rotateTimer(new QTimer(this))
+{
+    triggerEngine.setTriggers(captureOptions.triggers);
+    if (!captureOptions.rawCaptureFile.isEmpty()) {
+        rawCapture = new RawCaptureWriter(captureOptions.rawCaptureFile, this);
+        connect(rawCapture, &RawCaptureWriter::errorOccurred, this, &PortCapture::archiveErrorOccurred, Qt::DirectConnection);
+    }
+
+    // The reader has no parent, it is only created once nothing can throw anymore
+    serialReader = new SerialReader(*ringBuffer);
+    serialReader->setRawCapture(rawCapture);
+    serialReader->moveToThread(ioThread);
+    connect(serialReader, &SerialReader::dataAvailable, this, &PortCapture::handleDataAvailable);
+    connect(serialReader, &SerialReader::errorOccurred, this, &PortCapture::handleError);
+    connect(serialReader, &SerialReader::serialErrors, this, &PortCapture::handleSerialErrors);
+
+    if (!captureOptions.archiveDirectory.isEmpty()) {
+        archiveWriter = new ArchiveWriter(this);
+        // Forwarded directly so that the receiver can choose to still hear about the last archive
+        // while the capture is being destroyed
+        connect(archiveWriter, &ArchiveWriter::fileWritten, this, &PortCapture::fileWritten, Qt::DirectConnection);
+        connect(archiveWriter, &ArchiveWriter::errorOccurred, this, &PortCapture::archiveErrorOccurred, Qt::DirectConnection);
+        if (!captureOptions.dictionary.isEmpty()) {
+            archiveWriter->setDictionary(captureOptions.dictionary);
+        } else if (captureOptions.dictionaryTrainingMiB > 0) {
+            archiveWriter->trainDictionary(static_cast<size_t>(captureOptions.dictionaryTrainingMiB) * 1024 * 1024);
+        }
+    }
+
+    retryTimer->setSingleShot(true);
+    connect(retryTimer, &QTimer::timeout, this, &PortCapture::handleRetryTimer);
+    connect(rotateTimer, &QTimer::timeout, this, &PortCapture::handleRotateTimer);
+}
+
+PortCapture::~PortCapture()
+{
+    // The reader has to be gone before the ring buffer it writes to
+    auto* reader = serialReader;
+    QMetaObject::invokeMethod(
+        reader, [reader]() { reader->close(); }, Qt::BlockingQueuedConnection);
+    handleDataAvailable();
+    QMetaObject::invokeMethod(
+        reader, [reader]() { delete reader; }, Qt::BlockingQueuedConnection);
+
+    if (archiveWriter) {
+        // The writer's destructor writes out whatever is left and closes the archive
+        archiveWriter->stopStream();
+        delete archiveWriter;
+    }
+    delete rawCapture;
+}
+
+void PortCapture::start()
+{
+    elapsedTimer.start();
+    rotationStartTime = 0;
+
+    if (rawCapture) {
+        rawCapture->start(QThread::LowPriority);
+    }
+    if (archiveWriter) {
+        archiveWriter->start(QThread::LowPriority);
+        archiveWriter->startStream(captureOptions.archiveDirectory);
+        rotateTimer->start(ROTATE_CHECK_INTERVAL_MS);
+    }
+
+    if (!open()) {
+        retryTimer->start(RETRY_INTERVAL_MS);
+    }
+}
+
+void PortCapture::setTriggers(const std::vector<TriggerPattern>& triggers)
+{
+    triggerEngine.setTriggers(triggers);
+    captureOptions.triggers = triggers;
+}
+
+size_t PortCapture::bufferedBytes() const
+{
+    return ringBuffer->size();
+}
+
+bool PortCapture::open()
+{
+    bool opened {};
+    QMetaObject::invokeMethod(
+        serialReader, [&]() { return serialReader->open(captureOptions.port, captureOptions.baud, captureOptions.portSettings); }, Qt::BlockingQueuedConnection, &opened);
+
+    if (opened) {
+        qInfo() << "Connected to" << captureOptions.port << captureOptions.baud << serialReader->appliedSettings().toString();
+        emit connected();
+    } else {
+        qWarning() << "Failed to open" << captureOptions.port;
+    }
+    return opened;
+}
+
+void PortCapture::handleDataAvailable()
+{
+    if (!serialReader->acknowledgeData()) {
+        return;
+    }
+    Stats::instance().ringBufferDepth.set(ringBuffer->size());
+
+    while (true) {
+        const auto [data, len] = ringBuffer->readRegion();
+        if (!len) {
+            break;
+        }
+        processChunk(data, len);
+        ringBuffer->commitRead(len);
+    }
+
+    if (serialReader->isBackpressured()) {
+        QMetaObject::invokeMethod(serialReader, &SerialReader::resume, Qt::QueuedConnection);
+    }
+}
+
+void PortCapture::processChunk(char* data, const size_t len)
+{
+    auto& stats = Stats::instance();
+    stats.chunkSize.record(len);
+    {
+        StatTimer timer(stats.frameTime);
+        lineFramer.frame(data, len);
+    }
+
+    receivedBytes += static_cast<qint64>(len);
+    receivedLines += static_cast<qint64>(lineFramer.newlines().size());
+
+    if (!triggerEngine.isEmpty()) {
+        QStringList matches;
+        {
+            StatTimer timer(stats.triggerScanTime);
+            triggerEngine.scan(data, len, lineFramer.newlines(), [&](const size_t trigger) {
+                matches.append(QString("%1: %2").arg(QString::fromStdString(captureOptions.triggers[trigger].pattern)).arg(triggerEngine.matchCount(trigger)));
+            });
+        }
+        if (!matches.isEmpty()) {
+            emit triggerMatched(matches);
+        }
+    }
+
+    if (archiveWriter) {
+        chunkLineTimestamps.clear();
+        if (len && atLineStart) {
+            chunkLineTimestamps.push_back(serialReader->arrivalTime(ingestOffset));
+        }
+        for (const auto newline : lineFramer.newlines()) {
+            if (newline + 1 < len) {
+                chunkLineTimestamps.push_back(serialReader->arrivalTime(ingestOffset + newline + 1));
+            }
+        }
+        archiveWriter->append(data, len, chunkLineTimestamps);
+        rotationBytes += static_cast<qint64>(len);
+    }
+    if (len) {
+        atLineStart = data[len - 1] == '\n';
+    }
+    ingestOffset += len;
+
+    emit dataProcessed(data, len);
+}
+
+void PortCapture::handleError(const QSerialPort::SerialPortError error)
+{
+    if (error == QSerialPort::SerialPortError::NoError) {
+        return;
+    }
+    handleDataAvailable();
+
+    qCritical() << "Serial port error:" << captureOptions.port << error;
+    emit errorOccurred("Error: " + QVariant::fromValue(error).toString());
+    retryTimer->start(RETRY_INTERVAL_MS);
+}
+
+void PortCapture::handleSerialErrors(const SerialErrorCounts& counts)
+{
+    handleDataAvailable();
+    emit serialErrors(counts);
+}
+
+void PortCapture::handleRetryTimer()
+{
+    if (!open()) {
+        retryTimer->start(RETRY_INTERVAL_MS);
+    }
+}
+
+void PortCapture::handleRotateTimer()
+{
+    const auto elapsed = elapsedTimer.elapsed() - rotationStartTime;
+    if (elapsed > static_cast<qint64>(captureOptions.rotateMinutes) * 60 * 1000
+        || rotationBytes > static_cast<qint64>(captureOptions.rotateMiB) * 1024 * 1024) {
+        qInfo() << "Rotating archive of" << captureOptions.port << "after" << elapsed << "ms and" << rotationBytes << "bytes";
+        archiveWriter->rotate();
+        rotationStartTime = elapsedTimer.elapsed();
+        rotationBytes = 0;
+    }
+}
@@ -0,0 +1,119 @@
+#ifndef PORTCAPTURE_H
+#define PORTCAPTURE_H
+
+#include "archivedictionary.h"
+#include "lineframer.h"
+#include "serialreader.h"
+#include "triggerengine.h"
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QStringList>
+#include <QtSerialPort/QSerialPort>
+
+#include <memory>
+#include <vector>
+
+class ArchiveWriter;
+class RawCaptureWriter;
+class QThread;
+class QTimer;
+
+// Capture pipeline of one serial port: reading, NUL scrubbing, triggers and optionally streaming
+// zstd archives with rotation. The port is read on an I/O thread that is passed in, so any number
+// of captures can share one thread and its event loop. Everything else runs on the thread the
+// capture lives on. Lost connections are retried every RETRY_INTERVAL_MS.
+class PortCapture : public QObject {
+    Q_OBJECT
+
+public:
+    struct Options {
+        QString port {};
+        int baud {};
+        PortSettings portSettings {};
+        // No archives are written if empty
+        QString archiveDirectory {};
+        std::vector<TriggerPattern> triggers {};
+        // Every byte exactly as received is written to this file if set, see RawCaptureWriter
+        QString rawCaptureFile {};
+        int rotateMinutes = 60;
+        int rotateMiB = 512;
+        // The archives are compressed with `dictionary` if it isn't empty, otherwise with one
+        // trained from the first `dictionaryTrainingMiB` if that isn't 0
+        ArchiveDictionary dictionary {};
+        int dictionaryTrainingMiB {};
+    };
+
+    // Throws std::invalid_argument if one of the triggers can't be compiled and
+    // std::runtime_error if the raw capture file can't be created. `ioThread` has to keep running
+    // until the capture is destroyed.
+    PortCapture(const Options& options, QThread* ioThread, QObject* parent = nullptr);
+    // Closes the port and finishes the current archive
+    ~PortCapture();
+
+    void start();
+
+    // Throws std::invalid_argument if one of the triggers can't be compiled
+    void setTriggers(const std::vector<TriggerPattern>& triggers);
+
+    [[nodiscard]] const Options& options() const { return captureOptions; }
+    [[nodiscard]] qint64 totalBytes() const { return receivedBytes; }
+    [[nodiscard]] qint64 totalLines() const { return receivedLines; }
+    [[nodiscard]] size_t bufferedBytes() const;
+
+signals:
+    // Emitted for every chunk once it has been processed. `data` is only valid during the call,
+    // so this must not be connected through a queued connection.
+    void dataProcessed(const char* data, const size_t len);
+    void triggerMatched(const QStringList& matches);
+    void connected();
+    void errorOccurred(const QString& msg);
+    // Bytes were lost or corrupted. Everything read before the errors were noticed has already
+    // been passed on through `dataProcessed()`.
+    void serialErrors(const SerialErrorCounts& counts);
+    // These two are emitted from the archive writer's thread, errors of the raw capture from its
+    // own thread
+    void fileWritten(const QString& filename, const qint64 uncompressedSize, const qint64 compressedSize);
+    void archiveErrorOccurred(const QString& msg);
+
+private slots:
+    void handleDataAvailable();
+    void handleError(const QSerialPort::SerialPortError error);
+    void handleSerialErrors(const SerialErrorCounts& counts);
+    void handleRetryTimer();
+    void handleRotateTimer();
+
+private:
+    Options captureOptions;
+
+    std::unique_ptr<RingBuffer> ringBuffer;
+    SerialReader* serialReader {};
+
+    LineFramer lineFramer {};
+    TriggerEngine triggerEngine {};
+    ArchiveWriter* archiveWriter {};
+    RawCaptureWriter* rawCapture {};
+
+    std::vector<int64_t> chunkLineTimestamps {};
+    uint64_t ingestOffset {};
+    bool atLineStart = true;
+
+    QTimer* retryTimer {};
+    QTimer* rotateTimer {};
+    QElapsedTimer elapsedTimer;
+    qint64 rotationStartTime {};
+    qint64 rotationBytes {};
+
+    qint64 receivedBytes {};
+    qint64 receivedLines {};
+
+    // Every capture has its own, so this is kept smaller than the single port window's
+    static inline constexpr size_t RING_BUFFER_SIZE = 4 * 1024 * 1024;
+    static inline constexpr int RETRY_INTERVAL_MS = 1000;
+    static inline constexpr int ROTATE_CHECK_INTERVAL_MS = 5000;
+
+    bool open();
+    void processChunk(char* data, const size_t len);
+};
+
+#endif // PORTCAPTURE_H
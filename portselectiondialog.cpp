@@ -12,6 +12,7 @@ PortSelectionDialog::PortSelectionDialog(QWidget* parent)
 {
     ui->setupUi(this);
     connect(ui->portsComboBox, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &PortSelectionDialog::onCurrentIdxChanged);
+    connect(ui->lowestLatencyButton, &QPushButton::clicked, this, &PortSelectionDialog::onLowestLatencyClicked);
 
     ui->baudRateLineEdit->setText("115200");
     availablePorts = QSerialPortInfo::availablePorts();
@@ -61,3 +62,26 @@ int PortSelectionDialog::getSelectedBaud() const
     }
     return baudInt;
 }
+
+PortSettings PortSelectionDialog::getPortSettings() const
+{
+    PortSettings settings;
+    settings.lowLatency = ui->lowLatencyCheckBox->isChecked();
+    // 0 is the spin box's "Unchanged"
+    if (ui->ftdiLatencySpinBox->value()) {
+        settings.ftdiLatencyTimer = ui->ftdiLatencySpinBox->value();
+    }
+    settings.vmin = ui->vminSpinBox->value();
+    settings.vtime = ui->vtimeSpinBox->value();
+    settings.readBufferSize = static_cast<qint64>(ui->readBufferSpinBox->value()) * 1024;
+    return settings;
+}
+
+void PortSelectionDialog::onLowestLatencyClicked()
+{
+    const auto settings = PortSettings::lowestLatency();
+    ui->lowLatencyCheckBox->setChecked(settings.lowLatency);
+    ui->ftdiLatencySpinBox->setValue(settings.ftdiLatencyTimer);
+    ui->vminSpinBox->setValue(settings.vmin);
+    ui->vtimeSpinBox->setValue(settings.vtime);
+}
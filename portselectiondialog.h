@@ -1,6 +1,8 @@
 #ifndef PORTSELECTIONDIALOG_H
 #define PORTSELECTIONDIALOG_H
 
+#include "serialreader.h"
+
 #include <QDialog>
 #include <QSerialPortInfo>
 
@@ -17,9 +19,11 @@ public:
 
     int getSelectedBaud() const;
     const QString& getSelectedPortLocation() const;
+    PortSettings getPortSettings() const;
 
 public slots:
     void onCurrentIdxChanged(int idx);
+    void onLowestLatencyClicked();
 
 private:
     Ui::PortSelectionDialog* ui {};
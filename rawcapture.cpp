@@ -0,0 +1,350 @@
+#include "rawcapture.h"
+#include "linetimestamps.h"
+#include "stats.h"
+
+#include <QDebug>
+#include <QDeadlineTimer>
+#include <QtEndian>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef URING_AVAILABLE
+#include <liburing.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+static constexpr char RAW_MAGIC[] = { 'y', 'e', 'T', 'T', 'Y', 'r', 'a', 'w' };
+static constexpr qsizetype RAW_MAGIC_SIZE = sizeof(RAW_MAGIC);
+static constexpr uint32_t RAW_VERSION = 1;
+static constexpr qsizetype RAW_HEADER_SIZE = 16;
+static constexpr qsizetype RAW_RECORD_HEADER_SIZE = 12;
+
+#ifdef URING_AVAILABLE
+struct RawCaptureWriter::Ring {
+    io_uring ring {};
+};
+#else
+struct RawCaptureWriter::Ring {
+};
+#endif
+
+template <typename T>
+static void appendLittleEndian(QByteArray& out, const T value)
+{
+    const auto le = qToLittleEndian(value);
+    out.append(reinterpret_cast<const char*>(&le), sizeof(le));
+}
+
+void RawCaptureWriter::AlignedFree::operator()(char* p) const
+{
+    std::free(p);
+}
+
+RawCaptureWriter::RawCaptureWriter(const QString& filePath, QObject* parent)
+    : QThread(parent)
+    , path(filePath)
+{
+    setObjectName("RawCapture");
+
+    fd = ::open(QFile::encodeName(path).constData(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error(QString("Failed to create %1: %2").arg(path, strerror(errno)).toStdString());
+    }
+    // Not every file system does direct I/O, the page cache works too
+    if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_DIRECT) != 0) {
+        qInfo() << "No O_DIRECT for" << path << strerror(errno);
+    }
+
+    for (auto& block : blocks) {
+        block.reset(static_cast<char*>(std::aligned_alloc(ALIGNMENT, BLOCK_SIZE)));
+        if (!block) {
+            ::close(fd);
+            throw std::runtime_error("Failed to allocate the raw capture buffers");
+        }
+    }
+
+#ifdef URING_AVAILABLE
+    uring = std::make_unique<Ring>();
+    if (const auto result = io_uring_queue_init(4, &uring->ring, 0); result < 0) {
+        qInfo() << "io_uring not available, writing synchronously:" << strerror(-result);
+        uring.reset();
+    }
+#endif
+
+    QByteArray header(RAW_MAGIC, RAW_MAGIC_SIZE);
+    appendLittleEndian<uint32_t>(header, RAW_VERSION);
+    appendLittleEndian<uint32_t>(header, 0);
+    Q_ASSERT(header.size() == RAW_HEADER_SIZE);
+    consume(header.constData(), static_cast<size_t>(header.size()));
+}
+
+RawCaptureWriter::~RawCaptureWriter()
+{
+    {
+        QMutexLocker locker(&mutex);
+        stopping = true;
+        dataAvailable.wakeAll();
+    }
+    wait();
+
+    // In case the thread was never started. Otherwise there is nothing left to do.
+    try {
+        consume(pending.constData(), static_cast<size_t>(pending.size()));
+        pending.clear();
+        flush();
+    } catch (const std::exception& e) {
+        qCritical() << "Failed to write raw capture:" << e.what();
+    }
+
+#ifdef URING_AVAILABLE
+    if (uring) {
+        io_uring_queue_exit(&uring->ring);
+    }
+#endif
+    ::close(fd);
+}
+
+void RawCaptureWriter::append(const char* data, const size_t len, const int64_t timestamp)
+{
+    if (!len) {
+        return;
+    }
+    const auto wallClock = LineTimestamps::toWallClock(timestamp);
+
+    QMutexLocker locker(&mutex);
+    if (failed) {
+        return;
+    }
+    const auto wasEmpty = pending.isEmpty();
+    appendLittleEndian<int64_t>(pending, wallClock);
+    appendLittleEndian<uint32_t>(pending, static_cast<uint32_t>(len));
+    pending.append(data, static_cast<qsizetype>(len));
+    Stats::instance().rawCaptureBacklog.set(static_cast<uint64_t>(pending.size()));
+
+    if (pending.size() > BACKLOG_WARNING && !backlogWarned) {
+        backlogWarned = true;
+        qWarning() << "Raw capture backlog:" << pending.size();
+    }
+    // The first record wakes the worker up so that it can start the flush deadline
+    if (wasEmpty || pending.size() >= WAKE_SIZE) {
+        dataAvailable.wakeOne();
+    }
+}
+
+void RawCaptureWriter::run()
+{
+    QDeadlineTimer flushDeadline(QDeadlineTimer::Forever);
+
+    while (true) {
+        bool exiting {};
+        {
+            QMutexLocker locker(&mutex);
+            while (pending.size() < WAKE_SIZE && !stopping) {
+                if (!dataAvailable.wait(&mutex, flushDeadline) || (!pending.isEmpty() && flushDeadline.isForever())) {
+                    break;
+                }
+            }
+            // Swap instead of copying so that both buffers keep their capacity
+            work.resize(0);
+            std::swap(work, pending);
+            Stats::instance().rawCaptureBacklog.set(0);
+            backlogWarned = false;
+            exiting = stopping;
+        }
+
+        try {
+            consume(work.constData(), static_cast<size_t>(work.size()));
+            if (dirty && flushDeadline.isForever()) {
+                flushDeadline.setRemainingTime(FLUSH_INTERVAL_MS);
+            }
+            if (exiting || flushDeadline.hasExpired()) {
+                flush();
+                flushDeadline = QDeadlineTimer(QDeadlineTimer::Forever);
+            }
+        } catch (const std::exception& e) {
+            qCritical() << "Failed to write raw capture:" << e.what();
+            emit errorOccurred(e.what());
+            // Records can't be skipped without breaking the file, so nothing more is written
+            QMutexLocker locker(&mutex);
+            failed = true;
+            pending.clear();
+            return;
+        }
+
+        if (exiting) {
+            return;
+        }
+    }
+}
+
+void RawCaptureWriter::consume(const char* data, size_t len)
+{
+    while (len) {
+        const auto take = std::min(len, BLOCK_SIZE - blockUsed);
+        memcpy(blocks[currentBlock].get() + blockUsed, data, take);
+        blockUsed += take;
+        data += take;
+        len -= take;
+        dirty = true;
+        if (blockUsed == BLOCK_SIZE) {
+            submitBlock();
+        }
+    }
+}
+
+void RawCaptureWriter::submitBlock()
+{
+#ifdef URING_AVAILABLE
+    if (uring) {
+        auto* sqe = io_uring_get_sqe(&uring->ring);
+        if (!sqe) {
+            throw std::runtime_error("io_uring submission queue full");
+        }
+        io_uring_prep_write(sqe, fd, blocks[currentBlock].get(), BLOCK_SIZE, static_cast<__u64>(blockOffset));
+        io_uring_sqe_set_data64(sqe, currentBlock);
+        if (const auto result = io_uring_submit(&uring->ring); result < 0) {
+            throw std::runtime_error(std::string("io_uring_submit: ") + strerror(-result));
+        }
+        inFlight[currentBlock] = true;
+    } else
+#endif
+    {
+        writeFully(blocks[currentBlock].get(), BLOCK_SIZE, blockOffset);
+    }
+
+    blockOffset += static_cast<qint64>(BLOCK_SIZE);
+    currentBlock ^= 1;
+    blockUsed = 0;
+    waitForBlock(currentBlock);
+}
+
+void RawCaptureWriter::waitForBlock(const size_t block)
+{
+#ifdef URING_AVAILABLE
+    if (!inFlight[block]) {
+        return;
+    }
+    StatTimer timer(Stats::instance().rawCaptureWriteTime);
+    while (inFlight[block]) {
+        io_uring_cqe* cqe {};
+        if (const auto result = io_uring_wait_cqe(&uring->ring, &cqe); result < 0) {
+            throw std::runtime_error(std::string("io_uring_wait_cqe: ") + strerror(-result));
+        }
+        const auto completed = static_cast<size_t>(io_uring_cqe_get_data64(cqe));
+        const auto written = cqe->res;
+        io_uring_cqe_seen(&uring->ring, cqe);
+        inFlight[completed] = false;
+        if (written < 0) {
+            throw std::runtime_error(QString("Failed to write %1: %2").arg(path, strerror(-written)).toStdString());
+        }
+        if (static_cast<size_t>(written) != BLOCK_SIZE) {
+            throw std::runtime_error(QString("Short write to %1").arg(path).toStdString());
+        }
+        Stats::instance().rawCaptureBytes.add(BLOCK_SIZE);
+    }
+#else
+    Q_UNUSED(block);
+#endif
+}
+
+void RawCaptureWriter::flush()
+{
+    if (!dirty) {
+        return;
+    }
+    waitForBlock(0);
+    waitForBlock(1);
+
+    // The partial block is padded to the alignment, written and cut back to its real length. It
+    // is written again at the same offset once it is full.
+    if (blockUsed) {
+        const auto padded = (blockUsed + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        memset(blocks[currentBlock].get() + blockUsed, 0, padded - blockUsed);
+        writeFully(blocks[currentBlock].get(), padded, blockOffset);
+    }
+    if (ftruncate(fd, blockOffset + static_cast<qint64>(blockUsed)) != 0) {
+        throw std::runtime_error(QString("Failed to truncate %1: %2").arg(path, strerror(errno)).toStdString());
+    }
+    if (fdatasync(fd) != 0) {
+        throw std::runtime_error(QString("Failed to sync %1: %2").arg(path, strerror(errno)).toStdString());
+    }
+    dirty = false;
+}
+
+void RawCaptureWriter::writeFully(const char* data, const size_t len, const qint64 offset)
+{
+    StatTimer timer(Stats::instance().rawCaptureWriteTime);
+    size_t written {};
+    while (written < len) {
+        const auto result = pwrite(fd, data + written, len - written, offset + static_cast<qint64>(written));
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error(QString("Failed to write %1: %2").arg(path, strerror(errno)).toStdString());
+        }
+        written += static_cast<size_t>(result);
+    }
+    Stats::instance().rawCaptureBytes.add(len);
+}
+
+RawCaptureReader::RawCaptureReader(const QString& path)
+    : file(path)
+{
+    if (!file.open(QIODevice::ReadOnly)) {
+        throw std::runtime_error(QString("Failed to open %1: %2").arg(path, file.errorString()).toStdString());
+    }
+    const auto header = file.read(RAW_HEADER_SIZE);
+    if (header.size() != RAW_HEADER_SIZE || memcmp(header.constData(), RAW_MAGIC, sizeof(RAW_MAGIC)) != 0) {
+        throw std::runtime_error(QString("%1 is not a raw capture").arg(path).toStdString());
+    }
+    if (const auto version = qFromLittleEndian<uint32_t>(header.constData() + RAW_MAGIC_SIZE); version > RAW_VERSION) {
+        throw std::runtime_error(QString("%1 is a raw capture of a newer version: %2").arg(path).arg(version).toStdString());
+    }
+}
+
+bool RawCaptureReader::isRawCapture(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    const auto magic = file.read(RAW_MAGIC_SIZE);
+    return magic.size() == RAW_MAGIC_SIZE && memcmp(magic.constData(), RAW_MAGIC, sizeof(RAW_MAGIC)) == 0;
+}
+
+bool RawCaptureReader::next(Record& record)
+{
+    const auto header = file.read(RAW_RECORD_HEADER_SIZE);
+    if (header.isEmpty()) {
+        if (file.error() != QFileDevice::NoError) {
+            throw std::runtime_error(file.errorString().toStdString());
+        }
+        return false;
+    }
+    if (header.size() != RAW_RECORD_HEADER_SIZE) {
+        truncated = true;
+        return false;
+    }
+
+    record.timestamp = qFromLittleEndian<int64_t>(header.constData());
+    const auto len = static_cast<qint64>(qFromLittleEndian<uint32_t>(header.constData() + 8));
+    // Padding of a block that was written out but never cut back to its length
+    if (!record.timestamp && !len) {
+        truncated = true;
+        return false;
+    }
+
+    record.data = file.read(len);
+    if (record.data.size() != len) {
+        truncated = true;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,118 @@
+#ifndef RAWCAPTURE_H
+#define RAWCAPTURE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+
+// Lossless capture of the bytes exactly as they were read from the port, before NUL scrubbing or
+// any other cleanup, so that binary or corrupted traffic can be looked at later and replayed
+// byte for byte. The file is little endian:
+//
+// - Header: the magic "yeTTYraw", the format version (u32) and four reserved bytes.
+// - One record per read: receive time in nanoseconds since the epoch (i64), length (u32), then
+//   that many bytes.
+//
+// A capture that was cut short by a crash can end in the middle of a record, or in zero padding.
+// Both are ignored by the reader.
+
+// Appends records on a background thread. `append()` only copies the bytes into a queue, the
+// worker thread writes them out in BLOCK_SIZE blocks at aligned offsets, with O_DIRECT where the
+// file system supports it and through io_uring if yeTTY was built with liburing, so that the
+// next block is filled while the previous one is being written. The partial last block is
+// written out every FLUSH_INTERVAL_MS, which bounds what an unclean exit can lose.
+class RawCaptureWriter : public QThread {
+    Q_OBJECT
+
+public:
+    // Throws std::runtime_error if the file exists or can't be created
+    explicit RawCaptureWriter(const QString& path, QObject* parent = nullptr);
+    // Writes out whatever is still queued and closes the file
+    ~RawCaptureWriter();
+
+    // Can be called from any thread. `timestamp` is taken with LineTimestamps::now().
+    void append(const char* data, const size_t len, const int64_t timestamp);
+
+    [[nodiscard]] const QString& fileName() const { return path; }
+
+signals:
+    void errorOccurred(const QString& msg);
+
+protected:
+    void run() override;
+
+private:
+    static inline constexpr size_t BLOCK_SIZE = 1024 * 1024;
+    static inline constexpr size_t ALIGNMENT = 4096;
+    // The worker is woken up once this much is queued, or after FLUSH_INTERVAL_MS
+    static inline constexpr qsizetype WAKE_SIZE = 256 * 1024;
+    static inline constexpr int FLUSH_INTERVAL_MS = 1000;
+    // Only used to warn about a disk that can't keep up, the data is never dropped
+    static inline constexpr qsizetype BACKLOG_WARNING = 64 * 1024 * 1024;
+
+    struct AlignedFree {
+        void operator()(char* p) const;
+    };
+    using Block = std::unique_ptr<char, AlignedFree>;
+
+    const QString path;
+    int fd = -1;
+
+    // Shared with the producers, protected by `mutex`
+    QMutex mutex;
+    QWaitCondition dataAvailable;
+    QByteArray pending {};
+    bool stopping {};
+    bool failed {};
+    bool backlogWarned {};
+
+    // Only touched by the worker thread. The block being filled starts at `blockOffset` in the
+    // file. The other block may still be in flight.
+    QByteArray work {};
+    std::array<Block, 2> blocks {};
+    std::array<bool, 2> inFlight {};
+    size_t currentBlock {};
+    size_t blockUsed {};
+    qint64 blockOffset {};
+    bool dirty {};
+    struct Ring;
+    std::unique_ptr<Ring> uring;
+
+    void consume(const char* data, size_t len);
+    void submitBlock();
+    void waitForBlock(const size_t block);
+    void flush();
+    void writeFully(const char* data, const size_t len, const qint64 offset);
+};
+
+// Reads a raw capture one record at a time
+class RawCaptureReader {
+public:
+    struct Record {
+        // Nanoseconds since the epoch
+        int64_t timestamp {};
+        QByteArray data {};
+    };
+
+    // Throws std::runtime_error if the file can't be opened or isn't a raw capture
+    explicit RawCaptureReader(const QString& path);
+
+    [[nodiscard]] static bool isRawCapture(const QString& path);
+
+    // Returns false at the end of the capture. Throws std::runtime_error on read errors.
+    bool next(Record& record);
+    // True once next() has hit a record that was cut short
+    [[nodiscard]] bool isTruncated() const { return truncated; }
+
+private:
+    QFile file;
+    bool truncated {};
+};
+
+#endif // RAWCAPTURE_H
@@ -0,0 +1,660 @@
+#include "regexmatcher.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+struct RegexMatcher::NfaState {
+    enum class Type {
+        Chars,
+        Split,
+        Match
+    };
+
+    Type type {};
+    std::bitset<256> chars {};
+    uint32_t out = UNKNOWN;
+    uint32_t out1 = UNKNOWN;
+    uint32_t pattern {};
+};
+
+struct RegexMatcher::Node {
+    enum class Type {
+        Empty,
+        Chars,
+        Concat,
+        Alternation,
+        Repeat
+    };
+
+    Type type {};
+    std::bitset<256> chars {};
+    std::vector<std::unique_ptr<Node>> children {};
+    int min {};
+    int max {}; // -1 for unbounded
+};
+
+namespace {
+
+using Node = std::unique_ptr<RegexMatcher::Node>;
+
+constexpr int MAX_REPEAT = 1000;
+
+std::bitset<256> charRange(const uint8_t first, const uint8_t last)
+{
+    std::bitset<256> chars;
+    for (unsigned c = first; c <= last; c++) {
+        chars.set(c);
+    }
+    return chars;
+}
+
+std::bitset<256> digitChars()
+{
+    return charRange('0', '9');
+}
+
+std::bitset<256> wordChars()
+{
+    auto chars = charRange('a', 'z') | charRange('A', 'Z') | charRange('0', '9');
+    chars.set('_');
+    return chars;
+}
+
+std::bitset<256> spaceChars()
+{
+    std::bitset<256> chars;
+    for (const auto c : { ' ', '\t', '\n', '\r', '\f', '\v' }) {
+        chars.set(static_cast<uint8_t>(c));
+    }
+    return chars;
+}
+
+// Negated classes never match a newline since matching is line oriented
+std::bitset<256> negate(const std::bitset<256>& chars)
+{
+    auto negated = ~chars;
+    negated.reset('\n');
+    return negated;
+}
+
+int hexValue(const char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+class Parser {
+public:
+    explicit Parser(const std::string& pattern)
+        : str(pattern)
+    {
+    }
+
+    Node parse(const size_t patternBegin, const size_t patternEnd)
+    {
+        pos = patternBegin;
+        end = patternEnd;
+        auto node = parseAlternation();
+        if (pos != end) {
+            error("Unmatched ')'");
+        }
+        return node;
+    }
+
+private:
+    const std::string& str;
+    size_t pos {};
+    size_t end {};
+
+    [[noreturn]] void error(const std::string& msg) const
+    {
+        throw std::invalid_argument(msg + " at position " + std::to_string(pos) + " in: " + str);
+    }
+
+    bool atEnd() const { return pos >= end; }
+    char peek() const { return str[pos]; }
+
+    static Node makeNode(const RegexMatcher::Node::Type type)
+    {
+        auto node = std::make_unique<RegexMatcher::Node>();
+        node->type = type;
+        return node;
+    }
+
+    static Node makeChars(const std::bitset<256>& chars)
+    {
+        auto node = makeNode(RegexMatcher::Node::Type::Chars);
+        node->chars = chars;
+        return node;
+    }
+
+    Node parseAlternation()
+    {
+        auto first = parseConcat();
+        if (atEnd() || peek() != '|') {
+            return first;
+        }
+
+        auto node = makeNode(RegexMatcher::Node::Type::Alternation);
+        node->children.push_back(std::move(first));
+        while (!atEnd() && peek() == '|') {
+            pos++;
+            node->children.push_back(parseConcat());
+        }
+        return node;
+    }
+
+    Node parseConcat()
+    {
+        auto node = makeNode(RegexMatcher::Node::Type::Concat);
+        while (!atEnd() && peek() != '|' && peek() != ')') {
+            node->children.push_back(parseRepeat());
+        }
+        if (node->children.empty()) {
+            return makeNode(RegexMatcher::Node::Type::Empty);
+        }
+        if (node->children.size() == 1) {
+            return std::move(node->children.front());
+        }
+        return node;
+    }
+
+    bool parseNumber(int& value)
+    {
+        const auto start = pos;
+        value = 0;
+        while (!atEnd() && peek() >= '0' && peek() <= '9') {
+            value = value * 10 + (peek() - '0');
+            if (value > MAX_REPEAT) {
+                error("Repetition count too large");
+            }
+            pos++;
+        }
+        return pos != start;
+    }
+
+    Node parseRepeat()
+    {
+        auto atom = parseAtom();
+
+        while (!atEnd()) {
+            int min {}, max {};
+            const auto c = peek();
+            if (c == '*') {
+                min = 0;
+                max = -1;
+                pos++;
+            } else if (c == '+') {
+                min = 1;
+                max = -1;
+                pos++;
+            } else if (c == '?') {
+                min = 0;
+                max = 1;
+                pos++;
+            } else if (c == '{') {
+                pos++;
+                if (!parseNumber(min)) {
+                    error("Expected number");
+                }
+                max = min;
+                if (!atEnd() && peek() == ',') {
+                    pos++;
+                    if (!parseNumber(max)) {
+                        max = -1;
+                    } else if (max < min) {
+                        error("Invalid repetition range");
+                    }
+                }
+                if (atEnd() || peek() != '}') {
+                    error("Expected '}'");
+                }
+                pos++;
+            } else {
+                break;
+            }
+
+            // Lazy and possessive modifiers make no difference for detecting a match
+            if (!atEnd() && (peek() == '?' || peek() == '+')) {
+                pos++;
+            }
+
+            auto node = makeNode(RegexMatcher::Node::Type::Repeat);
+            node->min = min;
+            node->max = max;
+            node->children.push_back(std::move(atom));
+            atom = std::move(node);
+        }
+        return atom;
+    }
+
+    std::bitset<256> parseEscape()
+    {
+        if (atEnd()) {
+            error("Trailing backslash");
+        }
+        const auto c = peek();
+        pos++;
+        switch (c) {
+        case 'd':
+            return digitChars();
+        case 'D':
+            return negate(digitChars());
+        case 'w':
+            return wordChars();
+        case 'W':
+            return negate(wordChars());
+        case 's':
+            return spaceChars();
+        case 'S':
+            return negate(spaceChars());
+        case 't':
+            return charRange('\t', '\t');
+        case 'n':
+            return charRange('\n', '\n');
+        case 'r':
+            return charRange('\r', '\r');
+        case 'x': {
+            if (end - pos < 2 || hexValue(str[pos]) < 0 || hexValue(str[pos + 1]) < 0) {
+                error("Invalid hex escape");
+            }
+            const auto value = static_cast<uint8_t>(hexValue(str[pos]) * 16 + hexValue(str[pos + 1]));
+            pos += 2;
+            return charRange(value, value);
+        }
+        default:
+            if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')) {
+                error(std::string("Unsupported escape \\") + c);
+            }
+            return charRange(static_cast<uint8_t>(c), static_cast<uint8_t>(c));
+        }
+    }
+
+    std::bitset<256> parseClass()
+    {
+        std::bitset<256> chars;
+        bool negated {};
+        if (!atEnd() && peek() == '^') {
+            negated = true;
+            pos++;
+        }
+
+        bool first = true;
+        while (true) {
+            if (atEnd()) {
+                error("Unterminated character class");
+            }
+            auto c = peek();
+            if (c == ']' && !first) {
+                pos++;
+                break;
+            }
+            first = false;
+            pos++;
+
+            if (c == '\\') {
+                const auto escaped = parseEscape();
+                if (escaped.count() != 1) {
+                    chars |= escaped;
+                    continue;
+                }
+                for (unsigned i = 0; i < 256; i++) {
+                    if (escaped.test(i)) {
+                        c = static_cast<char>(i);
+                    }
+                }
+            }
+
+            if (end - pos >= 2 && peek() == '-' && str[pos + 1] != ']') {
+                pos++;
+                auto last = peek();
+                pos++;
+                if (last == '\\') {
+                    const auto escaped = parseEscape();
+                    if (escaped.count() != 1) {
+                        error("Invalid range");
+                    }
+                    for (unsigned i = 0; i < 256; i++) {
+                        if (escaped.test(i)) {
+                            last = static_cast<char>(i);
+                        }
+                    }
+                }
+                if (static_cast<uint8_t>(last) < static_cast<uint8_t>(c)) {
+                    error("Invalid range");
+                }
+                chars |= charRange(static_cast<uint8_t>(c), static_cast<uint8_t>(last));
+            } else {
+                chars.set(static_cast<uint8_t>(c));
+            }
+        }
+        return negated ? negate(chars) : chars;
+    }
+
+    Node parseAtom()
+    {
+        const auto c = peek();
+        pos++;
+        switch (c) {
+        case '(': {
+            if (end - pos >= 2 && str[pos] == '?' && str[pos + 1] == ':') {
+                pos += 2;
+            }
+            auto node = parseAlternation();
+            if (atEnd() || peek() != ')') {
+                error("Missing ')'");
+            }
+            pos++;
+            return node;
+        }
+        case '[':
+            return makeChars(parseClass());
+        case '.':
+            return makeChars(negate({}));
+        case '\\':
+            return makeChars(parseEscape());
+        case '*':
+        case '+':
+        case '?':
+        case '{':
+            pos--;
+            error("Nothing to repeat");
+        case '^':
+        case '$':
+            pos--;
+            error("Anchors are only supported at the start and end of a pattern");
+        default:
+            return makeChars(charRange(static_cast<uint8_t>(c), static_cast<uint8_t>(c)));
+        }
+    }
+};
+
+}
+
+RegexMatcher::RegexMatcher() = default;
+RegexMatcher::~RegexMatcher() = default;
+
+std::unique_ptr<RegexMatcher::Node> RegexMatcher::parse(const std::string& pattern, bool& anchoredStart)
+{
+    size_t begin = 0;
+    auto end = pattern.size();
+
+    anchoredStart = !pattern.empty() && pattern.front() == '^';
+    if (anchoredStart) {
+        begin++;
+    }
+
+    // A trailing '$' that is not escaped matches the line ending
+    bool anchoredEnd {};
+    if (end > begin && pattern[end - 1] == '$') {
+        size_t backslashes {};
+        for (auto i = end - 1; i > begin && pattern[i - 1] == '\\'; i--) {
+            backslashes++;
+        }
+        anchoredEnd = (backslashes % 2) == 0;
+    }
+    if (anchoredEnd) {
+        end--;
+    }
+
+    Parser parser(pattern);
+    auto node = parser.parse(begin, end);
+
+    if (anchoredEnd) {
+        auto concat = std::make_unique<Node>();
+        concat->type = Node::Type::Concat;
+        concat->children.push_back(std::move(node));
+
+        auto lineEnd = std::make_unique<Node>();
+        lineEnd->type = Node::Type::Chars;
+        lineEnd->chars.set('\n');
+        lineEnd->chars.set('\r');
+        concat->children.push_back(std::move(lineEnd));
+        node = std::move(concat);
+    }
+    return node;
+}
+
+uint32_t RegexMatcher::addNfaState(NfaState&& nfaState)
+{
+    if (nfa.size() >= MAX_NFA_STATES) {
+        throw std::invalid_argument("Regular expression too large");
+    }
+    nfa.push_back(std::move(nfaState));
+    return static_cast<uint32_t>(nfa.size() - 1);
+}
+
+// Compiles `node` so that it continues into `next` and returns the entry state
+uint32_t RegexMatcher::compile(const Node& node, uint32_t next)
+{
+    switch (node.type) {
+    case Node::Type::Empty:
+        return next;
+
+    case Node::Type::Chars: {
+        NfaState nfaState;
+        nfaState.type = NfaState::Type::Chars;
+        nfaState.chars = node.chars;
+        nfaState.out = next;
+        return addNfaState(std::move(nfaState));
+    }
+
+    case Node::Type::Concat:
+        for (auto it = node.children.rbegin(); it != node.children.rend(); ++it) {
+            next = compile(**it, next);
+        }
+        return next;
+
+    case Node::Type::Alternation: {
+        auto entry = compile(*node.children.back(), next);
+        for (auto it = std::next(node.children.rbegin()); it != node.children.rend(); ++it) {
+            NfaState split;
+            split.type = NfaState::Type::Split;
+            split.out = compile(**it, next);
+            split.out1 = entry;
+            entry = addNfaState(std::move(split));
+        }
+        return entry;
+    }
+
+    case Node::Type::Repeat: {
+        const auto& child = *node.children.front();
+
+        if (node.max < 0) {
+            // Loop: split -> child -> split, or split -> next
+            NfaState split;
+            split.type = NfaState::Type::Split;
+            split.out1 = next;
+            const auto loop = addNfaState(std::move(split));
+            nfa[loop].out = compile(child, loop);
+            next = loop;
+        } else {
+            for (int i = node.min; i < node.max; i++) {
+                NfaState split;
+                split.type = NfaState::Type::Split;
+                split.out = compile(child, next);
+                split.out1 = next;
+                next = addNfaState(std::move(split));
+            }
+        }
+
+        for (int i = 0; i < node.min; i++) {
+            next = compile(child, next);
+        }
+        return next;
+    }
+
+    default:
+        throw std::logic_error("Unknown regex node");
+    }
+}
+
+void RegexMatcher::setPatterns(const std::vector<std::string>& patterns)
+{
+    std::vector<NfaState> previousNfa;
+    std::vector<uint32_t> previousUnanchoredStarts;
+    std::vector<uint32_t> previousLineStarts;
+
+    // Keep the previous patterns around so that a bad pattern leaves the matcher untouched
+    std::swap(nfa, previousNfa);
+    std::swap(unanchoredStarts, previousUnanchoredStarts);
+    std::swap(lineStarts, previousLineStarts);
+
+    try {
+        for (size_t i = 0; i < patterns.size(); i++) {
+            bool anchoredStart {};
+            const auto ast = parse(patterns[i], anchoredStart);
+
+            NfaState match;
+            match.type = NfaState::Type::Match;
+            match.pattern = static_cast<uint32_t>(i);
+            const auto start = compile(*ast, addNfaState(std::move(match)));
+
+            (anchoredStart ? lineStarts : unanchoredStarts).push_back(start);
+        }
+    } catch (...) {
+        std::swap(nfa, previousNfa);
+        std::swap(unanchoredStarts, previousUnanchoredStarts);
+        std::swap(lineStarts, previousLineStarts);
+        throw;
+    }
+
+    patternCount = patterns.size();
+    closureMark.assign(nfa.size(), 0);
+    closureGeneration = 0;
+    clearDfa();
+    reset();
+}
+
+void RegexMatcher::reset()
+{
+    if (isEmpty()) {
+        return;
+    }
+    state = startState();
+}
+
+void RegexMatcher::clearDfa()
+{
+    transitions.clear();
+    dfaSets.clear();
+    dfaMatches.clear();
+    dfaIndex.clear();
+}
+
+void RegexMatcher::addClosure(const uint32_t nfaState, std::vector<uint32_t>& set)
+{
+    closureStack.push_back(nfaState);
+    while (!closureStack.empty()) {
+        const auto s = closureStack.back();
+        closureStack.pop_back();
+        if (s == UNKNOWN || closureMark[s] == closureGeneration) {
+            continue;
+        }
+        closureMark[s] = closureGeneration;
+
+        const auto& n = nfa[s];
+        if (n.type == NfaState::Type::Split) {
+            closureStack.push_back(n.out1);
+            closureStack.push_back(n.out);
+        } else {
+            set.push_back(s);
+        }
+    }
+}
+
+uint32_t RegexMatcher::startState()
+{
+    if (++closureGeneration == 0) {
+        std::fill(closureMark.begin(), closureMark.end(), 0);
+        closureGeneration = 1;
+    }
+
+    std::vector<uint32_t> set;
+    for (const auto s : unanchoredStarts) {
+        addClosure(s, set);
+    }
+    for (const auto s : lineStarts) {
+        addClosure(s, set);
+    }
+    std::sort(set.begin(), set.end());
+
+    if (const auto it = dfaIndex.find(set); it != dfaIndex.end()) {
+        return it->second;
+    }
+    return addDfaState(std::move(set));
+}
+
+uint32_t RegexMatcher::addDfaState(std::vector<uint32_t>&& set)
+{
+    const auto index = static_cast<uint32_t>(dfaSets.size());
+
+    std::vector<uint32_t> matches;
+    for (const auto s : set) {
+        if (nfa[s].type == NfaState::Type::Match) {
+            matches.push_back(nfa[s].pattern);
+        }
+    }
+
+    dfaIndex.emplace(set, index);
+    dfaSets.push_back(std::move(set));
+    dfaMatches.push_back(std::move(matches));
+    transitions.resize(transitions.size() + 256, UNKNOWN);
+    return index;
+}
+
+uint32_t RegexMatcher::computeTransition(const uint32_t from, const uint8_t byte)
+{
+    if (++closureGeneration == 0) {
+        std::fill(closureMark.begin(), closureMark.end(), 0);
+        closureGeneration = 1;
+    }
+
+    std::vector<uint32_t> set;
+    for (const auto s : dfaSets[from]) {
+        const auto& n = nfa[s];
+        if (n.type == NfaState::Type::Chars && n.chars.test(byte)) {
+            addClosure(n.out, set);
+        }
+    }
+
+    // Unanchored patterns can start at any byte, anchored ones only at the start of a line
+    for (const auto s : unanchoredStarts) {
+        addClosure(s, set);
+    }
+    if (byte == '\n') {
+        for (const auto s : lineStarts) {
+            addClosure(s, set);
+        }
+    }
+    std::sort(set.begin(), set.end());
+
+    uint32_t to {};
+    bool cacheable = true;
+    if (const auto it = dfaIndex.find(set); it != dfaIndex.end()) {
+        to = it->second;
+    } else {
+        if (dfaSets.size() >= MAX_CACHED_STATES) {
+            // Pathological pattern/input combination. Start over instead of growing without bound.
+            clearDfa();
+            cacheable = false;
+        }
+        to = addDfaState(std::move(set));
+    }
+
+    if (!dfaMatches[to].empty()) {
+        to |= MATCH_FLAG;
+    }
+    if (cacheable) {
+        transitions[from * 256 + byte] = to;
+    }
+    return to;
+}
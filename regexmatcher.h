@@ -0,0 +1,109 @@
+#ifndef REGEXMATCHER_H
+#define REGEXMATCHER_H
+
+#include <bitset>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Streaming regular expression matcher. All the patterns are compiled into a single Thompson NFA
+// which is lazily turned into a DFA while scanning, one state at a time. There is no
+// backtracking: every input byte costs either one table lookup or, the first time a transition
+// is taken, one step over the NFA. The cost per byte is therefore bounded by the size of the
+// patterns no matter what the input looks like. If the DFA grows too large the cache is thrown
+// away and rebuilt on demand.
+//
+// Supported syntax: literals, `.`, `[...]` / `[^...]` with ranges, `\d \D \w \W \s \S`,
+// `\t \n \r \xHH` and escaped metacharacters, groups `(...)` / `(?:...)`, alternation `|`,
+// quantifiers `* + ? {n} {n,} {n,m}`, `^` at the start of a pattern for line start and `$` at the
+// end of a pattern for line end. Matching is line oriented: `.` and negated classes never match
+// a newline.
+//
+// The state is carried across calls to `scan()`, so matches can span chunk boundaries.
+class RegexMatcher {
+public:
+    // Parsed pattern, only used while compiling
+    struct Node;
+
+    RegexMatcher();
+    ~RegexMatcher();
+
+    // Throws std::invalid_argument if one of the patterns can't be parsed
+    void setPatterns(const std::vector<std::string>& patterns);
+
+    [[nodiscard]] bool isEmpty() const { return patternCount == 0; }
+
+    // Resets the matcher to the start of a line
+    void reset();
+
+    // `onMatch(patternIndex, pos)` is called when a pattern matches ending at data[pos]
+    template <typename F>
+    void scan(const char* data, const size_t len, F&& onMatch);
+
+private:
+    struct NfaState;
+
+    static inline constexpr uint32_t MATCH_FLAG = 1u << 31;
+    static inline constexpr uint32_t STATE_MASK = ~MATCH_FLAG;
+    static inline constexpr uint32_t UNKNOWN = UINT32_MAX;
+    static inline constexpr size_t MAX_CACHED_STATES = 4096;
+    static inline constexpr size_t MAX_NFA_STATES = 64 * 1024;
+
+    size_t patternCount {};
+    std::vector<NfaState> nfa;
+    // Start states that are re-added after every byte and the ones only re-added after a newline
+    std::vector<uint32_t> unanchoredStarts {};
+    std::vector<uint32_t> lineStarts {};
+
+    // Lazily built DFA. transitions[state * 256 + byte], UNKNOWN if not computed yet.
+    std::vector<uint32_t> transitions {};
+    std::vector<std::vector<uint32_t>> dfaSets {};
+    std::vector<std::vector<uint32_t>> dfaMatches {};
+    std::map<std::vector<uint32_t>, uint32_t> dfaIndex {};
+
+    uint32_t state {};
+
+    // Scratch space for the subset construction
+    std::vector<uint32_t> closureStack {};
+    std::vector<uint32_t> closureMark {};
+    uint32_t closureGeneration {};
+
+    uint32_t computeTransition(const uint32_t from, const uint8_t byte);
+    uint32_t addDfaState(std::vector<uint32_t>&& set);
+    void clearDfa();
+    void addClosure(const uint32_t nfaState, std::vector<uint32_t>& set);
+    uint32_t startState();
+
+    std::unique_ptr<Node> parse(const std::string& pattern, bool& anchoredStart);
+    uint32_t compile(const Node& node, uint32_t next);
+    uint32_t addNfaState(NfaState&& nfaState);
+};
+
+template <typename F>
+void RegexMatcher::scan(const char* data, const size_t len, F&& onMatch)
+{
+    if (isEmpty()) {
+        return;
+    }
+
+    const auto* bytes = reinterpret_cast<const uint8_t*>(data);
+    auto s = state;
+
+    for (size_t i = 0; i < len; i++) {
+        auto next = transitions[(s & STATE_MASK) * 256 + bytes[i]];
+        if (next == UNKNOWN) [[unlikely]] {
+            next = computeTransition(s & STATE_MASK, bytes[i]);
+        }
+        s = next;
+        if (s & MATCH_FLAG) [[unlikely]] {
+            for (const auto pattern : dfaMatches[s & STATE_MASK]) {
+                onMatch(pattern, i);
+            }
+        }
+    }
+    state = s & STATE_MASK;
+}
+
+#endif // REGEXMATCHER_H
@@ -0,0 +1,76 @@
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+// Single producer, single consumer lock-free byte ring buffer. The storage is allocated once
+// up-front; the producer and consumer work directly on contiguous regions of it so that data can
+// be read into and out of the buffer without any intermediate copies or allocations.
+class RingBuffer {
+public:
+    explicit RingBuffer(const size_t minCapacity)
+    {
+        size_t cap = 1;
+        while (cap < minCapacity) {
+            cap <<= 1;
+        }
+        storage = std::make_unique<char[]>(cap);
+        mask = cap - 1;
+    }
+
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    // Producer side: largest contiguous free region. Length is 0 if the buffer is full.
+    [[nodiscard]] std::pair<char*, size_t> writeRegion() const
+    {
+        const auto h = head.load(std::memory_order_relaxed);
+        const auto t = tail.load(std::memory_order_acquire);
+        const auto free = capacity() - (h - t);
+        const auto offset = h & mask;
+        return { storage.get() + offset, std::min(free, capacity() - offset) };
+    }
+
+    void commitWrite(const size_t len)
+    {
+        head.store(head.load(std::memory_order_relaxed) + len, std::memory_order_release);
+    }
+
+    // Consumer side: largest contiguous filled region. Length is 0 if the buffer is empty.
+    // The consumer owns the region until commitRead() and may modify it in place.
+    [[nodiscard]] std::pair<char*, size_t> readRegion() const
+    {
+        const auto t = tail.load(std::memory_order_relaxed);
+        const auto h = head.load(std::memory_order_acquire);
+        const auto used = h - t;
+        const auto offset = t & mask;
+        return { storage.get() + offset, std::min(used, capacity() - offset) };
+    }
+
+    void commitRead(const size_t len)
+    {
+        tail.store(tail.load(std::memory_order_relaxed) + len, std::memory_order_release);
+    }
+
+    [[nodiscard]] size_t size() const
+    {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    [[nodiscard]] size_t capacity() const { return mask + 1; }
+
+private:
+    std::unique_ptr<char[]> storage {};
+    size_t mask {};
+
+    // Keep the indices on separate cache lines so that the producer and consumer don't keep
+    // invalidating each other's cache.
+    alignas(64) std::atomic<size_t> head {};
+    alignas(64) std::atomic<size_t> tail {};
+};
+
+#endif // RINGBUFFER_H
@@ -0,0 +1,67 @@
+#include "scrollbackdialog.h"
+
+#include "ui_scrollbackdialog.h"
+
+#include <QIntValidator>
+#include <QPushButton>
+
+ScrollbackDialog::ScrollbackDialog(QWidget* parent)
+    : QDialog(parent)
+    , ui(new Ui::ScrollbackDialog)
+{
+    ui->setupUi(this);
+
+    ui->linesLineEdit->setText(QString::number(maxLines));
+    ui->memoryLineEdit->setText(QString::number(maxMemoryInMiB));
+
+    connect(ui->linesLineEdit, &QLineEdit::textChanged, this, &ScrollbackDialog::onInputChanged);
+    connect(ui->memoryLineEdit, &QLineEdit::textChanged, this, &ScrollbackDialog::onInputChanged);
+
+    ui->linesLineEdit->setValidator(new QIntValidator(1000, 100 * 1000 * 1000, this));
+    ui->memoryLineEdit->setValidator(new QIntValidator(1, 4096, this));
+
+    onInputChanged();
+}
+
+ScrollbackDialog::~ScrollbackDialog()
+{
+    delete ui;
+}
+
+int ScrollbackDialog::getMaxLines() const
+{
+    return maxLines;
+}
+
+int ScrollbackDialog::getMaxMemory() const
+{
+    return maxMemoryInMiB;
+}
+
+bool ScrollbackDialog::isEnabled() const
+{
+    return ui->groupBox->isChecked();
+}
+
+bool ScrollbackDialog::archiveEvicted() const
+{
+    return ui->archiveCheckBox->isChecked();
+}
+
+void ScrollbackDialog::onInputChanged()
+{
+    bool linesOk {}, memoryOk {};
+
+    maxLines = ui->linesLineEdit->text().toInt(&linesOk);
+    maxMemoryInMiB = ui->memoryLineEdit->text().toInt(&memoryOk);
+
+    if (!linesOk || !memoryOk || !ui->linesLineEdit->hasAcceptableInput() || !ui->memoryLineEdit->hasAcceptableInput()) {
+        ui->buttonBox->button(QDialogButtonBox::StandardButton::Ok)->setEnabled(false);
+        return;
+    }
+    ui->buttonBox->button(QDialogButtonBox::StandardButton::Ok)->setEnabled(true);
+
+    ui->msgLabel->setText(QStringLiteral("yeTTY will keep at most %1 lines or %2 MiB"
+                                         " (whichever is smaller) and drop the oldest lines beyond that")
+                              .arg(QString::number(maxLines), QString::number(maxMemoryInMiB)));
+}
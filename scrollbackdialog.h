@@ -0,0 +1,31 @@
+#ifndef SCROLLBACKDIALOG_H
+#define SCROLLBACKDIALOG_H
+
+#include <QDialog>
+
+namespace Ui {
+class ScrollbackDialog;
+}
+
+class ScrollbackDialog : public QDialog {
+    Q_OBJECT
+
+public:
+    explicit ScrollbackDialog(QWidget* parent = nullptr);
+    ~ScrollbackDialog();
+
+    int getMaxLines() const;
+    int getMaxMemory() const;
+    bool isEnabled() const;
+    bool archiveEvicted() const;
+
+private slots:
+    void onInputChanged();
+
+private:
+    Ui::ScrollbackDialog* ui;
+    int maxLines = 1000 * 1000;
+    int maxMemoryInMiB = 64;
+};
+
+#endif // SCROLLBACKDIALOG_H
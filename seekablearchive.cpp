@@ -0,0 +1,112 @@
+#include "seekablearchive.h"
+#include "archivedictionary.h"
+
+#include <stdexcept>
+
+SeekableArchive::SeekableArchive(const QString& path)
+    : file(path)
+    , ctx(ZSTD_createDCtx(), &ZSTD_freeDCtx)
+{
+    if (!ctx) {
+        throw std::runtime_error("Failed to create zstd ctx");
+    }
+    if (!file.open(QIODevice::ReadOnly)) {
+        throw std::runtime_error(QString("Failed to open %1: %2").arg(path, file.errorString()).toStdString());
+    }
+    archiveIndex = ArchiveIndex::read(file);
+    if (archiveIndex.isEmpty()) {
+        throw std::runtime_error(QString("%1 is not seekable").arg(path).toStdString());
+    }
+    ArchiveDictionary::attach(ctx.get(), path);
+}
+
+QByteArray SeekableArchive::readFrame(const qsizetype frame)
+{
+    const auto& frames = archiveIndex.frames();
+    if (frame < 0 || frame >= static_cast<qsizetype>(frames.size())) {
+        throw std::out_of_range("Frame out of range");
+    }
+    const auto& info = frames[static_cast<size_t>(frame)];
+
+    if (!file.seek(info.offset)) {
+        throw std::runtime_error(file.errorString().toStdString());
+    }
+    const auto compressed = file.read(info.compressedSize);
+    if (compressed.size() != info.compressedSize) {
+        throw std::runtime_error(QString("Short read from %1").arg(file.fileName()).toStdString());
+    }
+
+    QByteArray decompressed(info.decompressedSize, Qt::Uninitialized);
+    const auto result = ZSTD_decompressDCtx(ctx.get(),
+        decompressed.data(), static_cast<size_t>(decompressed.size()),
+        compressed.constData(), static_cast<size_t>(compressed.size()));
+    if (ZSTD_isError(result)) {
+        throw std::runtime_error(ZSTD_getErrorName(result));
+    }
+    decompressed.truncate(static_cast<qsizetype>(result));
+    return decompressed;
+}
+
+QByteArray SeekableArchive::readLine(const qint64 line)
+{
+    auto frame = archiveIndex.frameForLine(line);
+    if (frame < 0) {
+        return {};
+    }
+
+    // Frames normally end on a line boundary. Only lines longer than the maximum frame size are
+    // split, and the frames after the one they start in begin with them. The frame that was
+    // found might only hold the end of the line, the earlier ones are read until the previous
+    // line ends. The continuation of the line is read from the following frames.
+    const auto& frames = archiveIndex.frames();
+    auto data = readFrame(frame);
+    auto next = frame + 1;
+    while (frame > 0 && frames[static_cast<size_t>(frame)].firstLine == line) {
+        const auto previous = readFrame(frame - 1);
+        if (previous.endsWith('\n')) {
+            break;
+        }
+        data.prepend(previous);
+        frame--;
+    }
+    qsizetype start {};
+    for (auto skip = line - frames[static_cast<size_t>(frame)].firstLine; skip > 0; skip--) {
+        start = data.indexOf('\n', start);
+        if (start < 0) {
+            return {};
+        }
+        start++;
+    }
+
+    auto end = data.indexOf('\n', start);
+    while (end < 0 && next < static_cast<qsizetype>(frames.size())) {
+        const auto tail = readFrame(next++);
+        const auto tailEnd = tail.indexOf('\n');
+        data.append(tailEnd < 0 ? tail : tail.left(tailEnd));
+        if (tailEnd >= 0) {
+            end = data.size();
+        }
+    }
+    if (end < 0) {
+        end = data.size();
+    }
+    if (end > start && data[end - 1] == '\r') {
+        end--;
+    }
+    return data.mid(start, end - start);
+}
+
+std::pair<uint64_t, LineTimestamps> SeekableArchive::readLineTimestamps()
+{
+    if (!archiveIndex.hasLineTimestamps()) {
+        return {};
+    }
+    if (!file.seek(archiveIndex.lineTimestampsFileOffset())) {
+        throw std::runtime_error(file.errorString().toStdString());
+    }
+    const auto data = file.read(archiveIndex.lineTimestampsFileSize());
+    if (data.size() != archiveIndex.lineTimestampsFileSize()) {
+        throw std::runtime_error(QString("Short read from %1").arg(file.fileName()).toStdString());
+    }
+    return LineTimestamps::deserialize(reinterpret_cast<const uint8_t*>(data.constData()), static_cast<size_t>(data.size()));
+}
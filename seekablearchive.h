@@ -0,0 +1,41 @@
+#ifndef SEEKABLEARCHIVE_H
+#define SEEKABLEARCHIVE_H
+
+#include "archiveindex.h"
+#include "linetimestamps.h"
+
+#include <QByteArray>
+#include <QFile>
+
+#include <zstd.h>
+
+#include <memory>
+
+// Random access to a seekable long term run mode archive. Looking up a line or a time only
+// decompresses the one frame that holds it.
+class SeekableArchive {
+public:
+    // Throws std::runtime_error if the file can't be opened, has no seek table or its dictionary
+    // is missing
+    explicit SeekableArchive(const QString& path);
+
+    [[nodiscard]] const ArchiveIndex& index() const { return archiveIndex; }
+
+    // Throws std::runtime_error if the frame can't be read or decompressed
+    [[nodiscard]] QByteArray readFrame(const qsizetype frame);
+
+    // The line with the given number, without the line terminator. Empty if the archive has no
+    // line index or the line doesn't exist. Throws like `readFrame()`.
+    [[nodiscard]] QByteArray readLine(const qint64 line);
+
+    // Receive time of every line in nanoseconds since the epoch, and the line number of the
+    // first of them. Empty if the archive has no line timestamps. Throws std::runtime_error.
+    [[nodiscard]] std::pair<uint64_t, LineTimestamps> readLineTimestamps();
+
+private:
+    QFile file;
+    ArchiveIndex archiveIndex {};
+    std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> ctx;
+};
+
+#endif // SEEKABLEARCHIVE_H
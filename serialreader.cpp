@@ -0,0 +1,348 @@
+#include "serialreader.h"
+#include "linetimestamps.h"
+#include "rawcapture.h"
+#include "stats.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QLocale>
+#include <QTimer>
+
+#include <cstring>
+
+#include <sys/ioctl.h>
+#include <termios.h>
+#if defined(TIOCGICOUNT) || defined(TIOCGSERIAL)
+#include <linux/serial.h>
+#endif
+
+QString SerialErrorCounts::toString() const
+{
+    QStringList parts;
+    const auto add = [&](const int count, const char* singular, const char* plural) {
+        if (count) {
+            parts.append(QString("%1 %2").arg(count).arg(count == 1 ? singular : plural));
+        }
+    };
+    add(overrun, "overrun", "overruns");
+    add(bufferOverrun, "buffer overrun", "buffer overruns");
+    add(frame, "framing error", "framing errors");
+    add(parity, "parity error", "parity errors");
+    add(breaks, "break", "breaks");
+    return parts.join(", ");
+}
+
+PortSettings PortSettings::lowestLatency()
+{
+    PortSettings settings;
+    settings.lowLatency = true;
+    settings.ftdiLatencyTimer = 1;
+    settings.vmin = 1;
+    settings.vtime = 0;
+    return settings;
+}
+
+QString PortSettings::toString() const
+{
+    QStringList parts;
+    if (lowLatency) {
+        parts.append("low latency");
+    }
+    if (ftdiLatencyTimer != UNCHANGED) {
+        parts.append(QString("FTDI timer %1 ms").arg(ftdiLatencyTimer));
+    }
+    if (vmin != UNCHANGED && vtime != UNCHANGED) {
+        parts.append(QString("VMIN %1 VTIME %2").arg(vmin).arg(vtime));
+    }
+    if (readBufferSize) {
+        parts.append(QString("read buffer %1").arg(QLocale().formattedDataSize(readBufferSize)));
+    }
+    return parts.join(" │ ");
+}
+
+SerialErrorCounts& SerialErrorCounts::operator+=(const SerialErrorCounts& other)
+{
+    overrun += other.overrun;
+    bufferOverrun += other.bufferOverrun;
+    frame += other.frame;
+    parity += other.parity;
+    breaks += other.breaks;
+    return *this;
+}
+
+SerialReader::SerialReader(RingBuffer& ringBuffer, QObject* parent)
+    : QObject(parent)
+    , ring(ringBuffer)
+    , serialPort(new QSerialPort(this))
+    , errorPollTimer(new QTimer(this))
+{
+    connect(serialPort, &QSerialPort::readyRead, this, &SerialReader::handleReadyRead);
+    connect(serialPort, &QSerialPort::errorOccurred, this, &SerialReader::handleError);
+    connect(errorPollTimer, &QTimer::timeout, this, &SerialReader::pollErrorCounters);
+}
+
+bool SerialReader::acknowledgeData()
+{
+    // acq_rel pairs with the exchange in handleReadyRead() so that everything committed to the
+    // ring buffer before the notification is visible to the consumer.
+    return notifyPending.exchange(false, std::memory_order_acq_rel);
+}
+
+bool SerialReader::isBackpressured() const
+{
+    // Pairs with the fence in handleReadyRead(), see there.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return backpressured.load(std::memory_order_relaxed);
+}
+
+bool SerialReader::takeArrival(Arrival& arrival)
+{
+    const auto [ptr, len] = arrivals.readRegion();
+    if (len < sizeof(Arrival)) {
+        return false;
+    }
+    memcpy(&arrival, ptr, sizeof(arrival));
+    arrivals.commitRead(sizeof(arrival));
+    return true;
+}
+
+int64_t SerialReader::arrivalTime(const uint64_t offset)
+{
+    // The arrival for a byte is the first one that ends after it
+    while (lastArrival.endOffset <= offset) {
+        if (!takeArrival(lastArrival)) {
+            // The record isn't there yet, this can only be off by a moment
+            return LineTimestamps::now();
+        }
+    }
+    return lastArrival.timestamp;
+}
+
+bool SerialReader::open(const QString& port, const int baud, const PortSettings& settings)
+{
+    if (serialPort->isOpen()) {
+        serialPort->close();
+    }
+    serialPort->setPortName(port);
+    serialPort->setBaudRate(baud);
+    serialPort->setReadBufferSize(settings.readBufferSize);
+    serialPort->clearError();
+    backpressured = false;
+    portBufferWarned = false;
+    if (!serialPort->open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    applySettings(port, settings);
+
+    // The counters are cumulative, only increases are of interest
+    if (readErrorCounters(lastErrorCounts)) {
+        errorPollTimer->start(ERROR_POLL_INTERVAL_MS);
+    } else {
+        qInfo() << "Serial error counters are not available for" << port;
+    }
+    return true;
+}
+
+void SerialReader::close()
+{
+    errorPollTimer->stop();
+    if (serialPort->isOpen()) {
+        pollErrorCounters();
+        serialPort->close();
+    }
+}
+
+// The sysfs attribute of an FTDI adapter's latency timer
+static QString latencyTimerPath(const QString& port)
+{
+    const auto device = QFileInfo(port.startsWith('/') ? port : "/dev/" + port).canonicalFilePath();
+    return QString("/sys/class/tty/%1/device/latency_timer").arg(QFileInfo(device).fileName());
+}
+
+void SerialReader::applySettings(const QString& port, const PortSettings& settings)
+{
+    const auto fd = static_cast<int>(serialPort->handle());
+    portSettings = {};
+    portSettings.readBufferSize = serialPort->readBufferSize();
+
+#ifdef TIOCGSERIAL
+    constexpr auto lowLatencyFlag = static_cast<int>(ASYNC_LOW_LATENCY);
+    serial_struct serial {};
+    if (ioctl(fd, TIOCGSERIAL, &serial) == 0) {
+        if (settings.lowLatency && !(serial.flags & lowLatencyFlag)) {
+            serial.flags |= lowLatencyFlag;
+            if (ioctl(fd, TIOCSSERIAL, &serial) != 0) {
+                qWarning() << "Failed to set ASYNC_LOW_LATENCY on" << port << strerror(errno);
+            }
+            ioctl(fd, TIOCGSERIAL, &serial);
+        }
+        portSettings.lowLatency = serial.flags & lowLatencyFlag;
+    } else if (settings.lowLatency) {
+        qWarning() << "ASYNC_LOW_LATENCY is not supported by" << port;
+    }
+#endif
+
+    QFile latencyTimer(latencyTimerPath(port));
+    if (settings.ftdiLatencyTimer != PortSettings::UNCHANGED) {
+        if (!latencyTimer.open(QIODevice::WriteOnly) || latencyTimer.write(QByteArray::number(settings.ftdiLatencyTimer)) < 0
+            || !latencyTimer.flush()) {
+            qWarning() << "Failed to set the latency timer of" << port << latencyTimer.errorString();
+        }
+        latencyTimer.close();
+    }
+    if (latencyTimer.open(QIODevice::ReadOnly)) {
+        bool ok {};
+        const auto value = latencyTimer.readAll().trimmed().toInt(&ok);
+        portSettings.ftdiLatencyTimer = ok ? value : PortSettings::UNCHANGED;
+    }
+
+    termios tio {};
+    if (tcgetattr(fd, &tio) == 0) {
+        if (settings.vmin != PortSettings::UNCHANGED || settings.vtime != PortSettings::UNCHANGED) {
+            if (settings.vmin != PortSettings::UNCHANGED) {
+                tio.c_cc[VMIN] = static_cast<cc_t>(settings.vmin);
+            }
+            if (settings.vtime != PortSettings::UNCHANGED) {
+                tio.c_cc[VTIME] = static_cast<cc_t>(settings.vtime);
+            }
+            if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+                qWarning() << "Failed to set VMIN/VTIME on" << port << strerror(errno);
+            }
+            tcgetattr(fd, &tio);
+        }
+        portSettings.vmin = tio.c_cc[VMIN];
+        portSettings.vtime = tio.c_cc[VTIME];
+    }
+
+    qInfo() << "Port settings of" << port << portSettings.toString();
+}
+
+bool SerialReader::readErrorCounters(SerialErrorCounts& counts)
+{
+#ifdef TIOCGICOUNT
+    serial_icounter_struct counters {};
+    if (ioctl(static_cast<int>(serialPort->handle()), TIOCGICOUNT, &counters) < 0) {
+        return false;
+    }
+    counts = { counters.overrun, counters.buf_overrun, counters.frame, counters.parity, counters.brk };
+    return true;
+#else
+    Q_UNUSED(counts);
+    return false;
+#endif
+}
+
+void SerialReader::pollErrorCounters()
+{
+    SerialErrorCounts counts;
+    if (!readErrorCounters(counts)) {
+        errorPollTimer->stop();
+        return;
+    }
+
+    const SerialErrorCounts delta {
+        counts.overrun - lastErrorCounts.overrun,
+        counts.bufferOverrun - lastErrorCounts.bufferOverrun,
+        counts.frame - lastErrorCounts.frame,
+        counts.parity - lastErrorCounts.parity,
+        counts.breaks - lastErrorCounts.breaks,
+    };
+    lastErrorCounts = counts;
+    if (delta.isEmpty()) {
+        return;
+    }
+
+    auto& stats = Stats::instance();
+    stats.overruns.add(static_cast<uint64_t>(delta.overrun));
+    stats.bufferOverruns.add(static_cast<uint64_t>(delta.bufferOverrun));
+    stats.framingErrors.add(static_cast<uint64_t>(delta.frame));
+    stats.parityErrors.add(static_cast<uint64_t>(delta.parity));
+    qWarning() << "Serial errors on" << serialPort->portName() << delta.toString();
+    emit serialErrors(delta);
+}
+
+void SerialReader::resume()
+{
+    if (backpressured.exchange(false)) {
+        handleReadyRead();
+    }
+}
+
+void SerialReader::setRawCapture(RawCaptureWriter* writer)
+{
+    rawCapture = writer;
+}
+
+void SerialReader::handleReadyRead()
+{
+    const auto timestamp = LineTimestamps::now();
+    qint64 totalRead {};
+
+    while (serialPort->bytesAvailable() > 0) {
+        const auto [ptr, space] = ring.writeRegion();
+        if (!space) {
+            // Leave the rest in QSerialPort's buffer. The consumer will call resume() once it has
+            // made some room.
+            const auto queued = serialPort->bytesAvailable();
+            Stats::instance().portBufferDepth.set(static_cast<uint64_t>(queued));
+            if (queued > PORT_BUFFER_WARNING && !portBufferWarned) {
+                portBufferWarned = true;
+                qWarning() << "Consumer is behind," << queued << "bytes queued in the serial port's read buffer";
+            }
+
+            backpressured.store(true, std::memory_order_relaxed);
+
+            // The consumer may have drained the buffer after we looked at it but before it could
+            // see the flag. Check again so that we never wait for a resume() that won't come.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!ring.writeRegion().second) {
+                break;
+            }
+            backpressured.store(false, std::memory_order_relaxed);
+            continue;
+        }
+
+        const auto bytesRead = serialPort->read(ptr, static_cast<qint64>(space));
+        if (bytesRead <= 0) {
+            break;
+        }
+        // Once committed the consumer may modify the bytes in place
+        if (rawCapture) {
+            rawCapture->append(ptr, static_cast<size_t>(bytesRead), timestamp);
+        }
+        ring.commitWrite(static_cast<size_t>(bytesRead));
+        totalRead += bytesRead;
+    }
+
+    auto& stats = Stats::instance();
+    stats.readyReadCalls.add();
+    if (totalRead) {
+        stats.bytesRead.add(static_cast<uint64_t>(totalRead));
+        stats.readSize.record(static_cast<uint64_t>(totalRead));
+
+        // Records are a power of two in size, so they never wrap around the end of the ring
+        bytesWritten += static_cast<uint64_t>(totalRead);
+        if (const auto [ptr, space] = arrivals.writeRegion(); space >= sizeof(Arrival)) {
+            const Arrival arrival { bytesWritten, timestamp };
+            memcpy(ptr, &arrival, sizeof(arrival));
+            arrivals.commitWrite(sizeof(arrival));
+        }
+    }
+
+    if (totalRead && !notifyPending.exchange(true, std::memory_order_acq_rel)) {
+        emit dataAvailable();
+    }
+}
+
+void SerialReader::handleError(const QSerialPort::SerialPortError error)
+{
+    if (error == QSerialPort::SerialPortError::NoError) {
+        return;
+    }
+
+    if (serialPort->isOpen()) {
+        serialPort->close();
+    }
+    emit errorOccurred(error);
+}
@@ -0,0 +1,146 @@
+#ifndef SERIALREADER_H
+#define SERIALREADER_H
+
+#include "ringbuffer.h"
+
+#include <QObject>
+#include <QtSerialPort/QSerialPort>
+
+#include <atomic>
+#include <cstdint>
+
+class QTimer;
+class RawCaptureWriter;
+
+// Errors the kernel counted on the line, as reported by TIOCGICOUNT. Each of these means that
+// one or more bytes were lost or corrupted.
+struct SerialErrorCounts {
+    int overrun {};
+    int bufferOverrun {};
+    int frame {};
+    int parity {};
+    int breaks {};
+
+    [[nodiscard]] bool isEmpty() const { return !overrun && !bufferOverrun && !frame && !parity && !breaks; }
+    SerialErrorCounts& operator+=(const SerialErrorCounts& other);
+    // E.g. "3 overruns, 1 framing error"
+    [[nodiscard]] QString toString() const;
+};
+
+// Latency related settings of a port. Whatever is left at "unchanged" keeps the driver's or
+// QSerialPort's setting. The lowest latency needs all of ASYNC_LOW_LATENCY, a 1 ms FTDI latency
+// timer (the default of 16 ms is usually what dominates) and VMIN 1 / VTIME 0.
+struct PortSettings {
+    static inline constexpr int UNCHANGED = -1;
+
+    // ASYNC_LOW_LATENCY through TIOCSSERIAL. It is only ever set, never cleared.
+    bool lowLatency {};
+    // In ms, through sysfs. Only FTDI adapters have it and writing it usually needs root or a
+    // udev rule.
+    int ftdiLatencyTimer = UNCHANGED;
+    // termios, the reader is only woken up once VMIN bytes are there or VTIME deciseconds have
+    // passed
+    int vmin = UNCHANGED;
+    int vtime = UNCHANGED;
+    // Bytes, 0 for unbounded. Bounding it pushes the backlog of a stalled consumer into the kernel
+    // where it overflows and is lost.
+    qint64 readBufferSize {};
+
+    // The settings for the lowest latency
+    [[nodiscard]] static PortSettings lowestLatency();
+    // E.g. "low latency │ FTDI timer 1 ms │ VMIN 1 VTIME 0"
+    [[nodiscard]] QString toString() const;
+};
+
+// Owns the serial port and lives on a dedicated thread. Incoming bytes are read straight into
+// a preallocated ring buffer and the consumer is notified asynchronously. If the consumer falls
+// behind and the ring buffer fills up, the remaining bytes stay queued in QSerialPort's own
+// (unbounded) read buffer until `resume()` is called, so a stalled consumer never loses data.
+//
+// Every read is also recorded as an `Arrival` so that the consumer can tell when each byte came
+// in, no matter how long it took to get around to processing it. If a raw capture is set, every
+// read is also handed to it before the consumer can see, and clean up, the bytes.
+//
+// The kernel's error counters of the port are polled every ERROR_POLL_INTERVAL_MS and any increase
+// is reported through `serialErrors()`. Drivers that don't keep these counters (ptys, some USB
+// adapters) are logged once and skipped.
+class SerialReader : public QObject {
+    Q_OBJECT
+
+public:
+    explicit SerialReader(RingBuffer& ringBuffer, QObject* parent = nullptr);
+
+    // Can be called from any thread. Returns true if a notification was pending, i.e. there might
+    // be data in the ring buffer. Must be called before draining the ring buffer.
+    bool acknowledgeData();
+
+    // Can be called from any thread
+    [[nodiscard]] bool isBackpressured() const;
+
+    // Consumer side. When the byte at `offset` in the stream of bytes taken from the ring buffer
+    // was read. Offsets must not decrease from one call to the next.
+    [[nodiscard]] int64_t arrivalTime(const uint64_t offset);
+
+    // The settings that are actually in effect after a successful open(), read back from the
+    // driver. Unknown values are UNCHANGED. Only to be called while the reader thread doesn't touch
+    // the port, e.g. right after a blocking open().
+    [[nodiscard]] const PortSettings& appliedSettings() const { return portSettings; }
+
+public slots:
+    bool open(const QString& port, const int baud, const PortSettings& settings = {});
+    void close();
+    void resume();
+    // nullptr to stop capturing. The writer must outlive the reader or the next call.
+    void setRawCapture(RawCaptureWriter* writer);
+
+signals:
+    void dataAvailable();
+    void errorOccurred(const QSerialPort::SerialPortError error);
+    // The affected bytes were read in the last ERROR_POLL_INTERVAL_MS, i.e. they are among the
+    // last ones in the ring buffer when this is received
+    void serialErrors(const SerialErrorCounts& counts);
+
+private slots:
+    void handleReadyRead();
+    void handleError(const QSerialPort::SerialPortError error);
+    void pollErrorCounters();
+
+private:
+    // Where a read ended in the stream of bytes written to the ring buffer and when it happened,
+    // as taken by LineTimestamps::now()
+    struct Arrival {
+        uint64_t endOffset {};
+        int64_t timestamp {};
+    };
+
+    RingBuffer& ring;
+    QSerialPort* serialPort {};
+    QTimer* errorPollTimer {};
+    RawCaptureWriter* rawCapture {};
+    PortSettings portSettings {};
+    SerialErrorCounts lastErrorCounts {};
+    bool portBufferWarned {};
+
+    std::atomic_bool notifyPending {};
+    std::atomic_bool backpressured {};
+
+    static inline constexpr size_t MAX_ARRIVALS = 4096;
+    static inline constexpr int ERROR_POLL_INTERVAL_MS = 250;
+    // QSerialPort's read buffer is unbounded so that a stalled consumer never loses data, but it
+    // is worth knowing when it gets this large
+    static inline constexpr qint64 PORT_BUFFER_WARNING = 64 * 1024 * 1024;
+
+    // Arrival records. If the consumer doesn't keep up, new ones are dropped and the affected
+    // bytes get the time of the next recorded read.
+    RingBuffer arrivals { MAX_ARRIVALS * sizeof(Arrival) };
+    uint64_t bytesWritten {};
+    // Consumer side
+    Arrival lastArrival {};
+
+    bool takeArrival(Arrival& arrival);
+    // Returns false if the driver doesn't support TIOCGICOUNT
+    bool readErrorCounters(SerialErrorCounts& counts);
+    void applySettings(const QString& port, const PortSettings& settings);
+};
+
+#endif // SERIALREADER_H
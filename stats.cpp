@@ -0,0 +1,239 @@
+#include "stats.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLocale>
+#include <QStandardPaths>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+static void updateMax(std::atomic<uint64_t>& maxValue, const uint64_t value)
+{
+    auto current = maxValue.load(std::memory_order_relaxed);
+    while (value > current && !maxValue.compare_exchange_weak(current, value, std::memory_order_relaxed)) { }
+}
+
+void StatGauge::set(const uint64_t newValue)
+{
+    value.store(newValue, std::memory_order_relaxed);
+    updateMax(maxValue, newValue);
+}
+
+void StatHistogram::record(const uint64_t value)
+{
+    const auto bucket = value ? 64 - __builtin_clzll(value) : 0;
+    buckets[static_cast<size_t>(bucket)].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+    sumValue.fetch_add(value, std::memory_order_relaxed);
+    updateMax(maxValue, value);
+}
+
+uint64_t StatHistogram::mean() const
+{
+    const auto n = count();
+    return n ? sum() / n : 0;
+}
+
+uint64_t StatHistogram::percentile(const double p) const
+{
+    const auto n = count();
+    if (!n) {
+        return 0;
+    }
+
+    const auto rank = static_cast<uint64_t>(p / 100 * static_cast<double>(n - 1)) + 1;
+    uint64_t seen {};
+    for (size_t i = 0; i < buckets.size(); i++) {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            const auto upperBound = i == 0 ? 0 : i == 64 ? UINT64_MAX : (uint64_t { 1 } << i) - 1;
+            return std::min(upperBound, max());
+        }
+    }
+    return max();
+}
+
+Stats& Stats::instance()
+{
+    static Stats stats;
+    return stats;
+}
+
+static QJsonObject histogramToJson(const StatHistogram& histogram)
+{
+    return {
+        { "count", static_cast<qint64>(histogram.count()) },
+        { "mean", static_cast<qint64>(histogram.mean()) },
+        { "p50", static_cast<qint64>(histogram.percentile(50)) },
+        { "p90", static_cast<qint64>(histogram.percentile(90)) },
+        { "p99", static_cast<qint64>(histogram.percentile(99)) },
+        { "max", static_cast<qint64>(histogram.max()) },
+    };
+}
+
+static QJsonObject gaugeToJson(const StatGauge& gauge)
+{
+    return {
+        { "current", static_cast<qint64>(gauge.get()) },
+        { "max", static_cast<qint64>(gauge.max()) },
+    };
+}
+
+static double compressionRatio(const Stats& stats)
+{
+    const auto output = stats.compressedOutput.get();
+    return output ? static_cast<double>(stats.compressedInput.get()) / static_cast<double>(output) : 0;
+}
+
+QByteArray Stats::toJson() const
+{
+    const QJsonObject reader {
+        { "bytesRead", static_cast<qint64>(bytesRead.get()) },
+        { "readyReadCalls", static_cast<qint64>(readyReadCalls.get()) },
+        { "readSize", histogramToJson(readSize) },
+        { "ringBufferDepth", gaugeToJson(ringBufferDepth) },
+        { "portBufferDepth", gaugeToJson(portBufferDepth) },
+        { "overruns", static_cast<qint64>(overruns.get()) },
+        { "bufferOverruns", static_cast<qint64>(bufferOverruns.get()) },
+        { "framingErrors", static_cast<qint64>(framingErrors.get()) },
+        { "parityErrors", static_cast<qint64>(parityErrors.get()) },
+    };
+    const QJsonObject consumer {
+        { "chunkSize", histogramToJson(chunkSize) },
+        { "frameTimeNs", histogramToJson(frameTime) },
+        { "triggerScanTimeNs", histogramToJson(triggerScanTime) },
+        { "decodeTimeNs", histogramToJson(decodeTime) },
+        { "insertTextTimeNs", histogramToJson(insertTextTime) },
+        { "invalidUtf8Bytes", static_cast<qint64>(invalidUtf8Bytes.get()) },
+        { "pendingBytes", gaugeToJson(pendingBytes) },
+        { "highlightingChanges", static_cast<qint64>(highlightingChanges.get()) },
+    };
+    const QJsonObject archive {
+        { "compressedInput", static_cast<qint64>(compressedInput.get()) },
+        { "compressedOutput", static_cast<qint64>(compressedOutput.get()) },
+        { "compressionRatio", compressionRatio(*this) },
+        { "compressTimeNs", histogramToJson(compressTime) },
+        { "rotationTimeNs", histogramToJson(rotationTime) },
+        { "backlog", gaugeToJson(archiveBacklog) },
+    };
+    const QJsonObject rawCapture {
+        { "bytesWritten", static_cast<qint64>(rawCaptureBytes.get()) },
+        { "writeTimeNs", histogramToJson(rawCaptureWriteTime) },
+        { "backlog", gaugeToJson(rawCaptureBacklog) },
+    };
+    const QJsonObject root {
+        { "timestamp", QDateTime::currentDateTime().toString(Qt::ISODateWithMs) },
+        { "pid", static_cast<qint64>(getpid()) },
+        { "reader", reader },
+        { "consumer", consumer },
+        { "archive", archive },
+        { "rawCapture", rawCapture },
+    };
+    return QJsonDocument(root).toJson();
+}
+
+static QString formatTime(const uint64_t ns)
+{
+    if (ns < 10'000) {
+        return QString("%1 ns").arg(ns);
+    }
+    if (ns < 10'000'000) {
+        return QString("%1 µs").arg(static_cast<double>(ns) / 1e3, 0, 'f', 1);
+    }
+    return QString("%1 ms").arg(static_cast<double>(ns) / 1e6, 0, 'f', 1);
+}
+
+static QString formatSize(const uint64_t bytes)
+{
+    return QLocale().formattedDataSize(static_cast<qint64>(bytes));
+}
+
+template <typename Format>
+static QString histogramToText(const QString& name, const StatHistogram& histogram, Format format)
+{
+    return QString("%1 %2 × │ mean %3 │ p50 %4 │ p99 %5 │ max %6\n")
+        .arg(name, -22)
+        .arg(histogram.count())
+        .arg(format(histogram.mean()), format(histogram.percentile(50)), format(histogram.percentile(99)), format(histogram.max()));
+}
+
+static QString gaugeToText(const QString& name, const StatGauge& gauge)
+{
+    return QString("%1 %2 │ max %3\n").arg(name, -22).arg(formatSize(gauge.get()), formatSize(gauge.max()));
+}
+
+QString Stats::toText() const
+{
+    QString text;
+    text += "Serial reader\n";
+    text += QString("%1 %2\n").arg("  Bytes read", -22).arg(formatSize(bytesRead.get()));
+    text += QString("%1 %2\n").arg("  readyRead calls", -22).arg(readyReadCalls.get());
+    text += histogramToText("  Read size", readSize, formatSize);
+    text += gaugeToText("  Ring buffer", ringBufferDepth);
+    text += gaugeToText("  Port read buffer", portBufferDepth);
+    text += QString("%1 %2 overruns │ %3 buffer overruns │ %4 framing │ %5 parity\n")
+                .arg("  Line errors", -22)
+                .arg(overruns.get())
+                .arg(bufferOverruns.get())
+                .arg(framingErrors.get())
+                .arg(parityErrors.get());
+
+    text += "\nProcessing\n";
+    text += histogramToText("  Chunk size", chunkSize, formatSize);
+    text += histogramToText("  NUL scrub, framing", frameTime, formatTime);
+    text += histogramToText("  Trigger scan", triggerScanTime, formatTime);
+    text += histogramToText("  UTF-8 decode", decodeTime, formatTime);
+    text += histogramToText("  insertText", insertTextTime, formatTime);
+    text += QString("%1 %2\n").arg("  Invalid UTF-8", -22).arg(formatSize(invalidUtf8Bytes.get()));
+    text += gaugeToText("  Pending insert", pendingBytes);
+    text += QString("%1 %2\n").arg("  Highlighting changes", -22).arg(highlightingChanges.get());
+
+    text += "\nArchive\n";
+    text += QString("%1 %2 → %3 (%4:1)\n")
+                .arg("  Compressed", -22)
+                .arg(formatSize(compressedInput.get()), formatSize(compressedOutput.get()))
+                .arg(compressionRatio(*this), 0, 'f', 1);
+    text += histogramToText("  Compress", compressTime, formatTime);
+    text += histogramToText("  Rotation", rotationTime, formatTime);
+    text += gaugeToText("  Backlog", archiveBacklog);
+
+    text += "\nRaw capture\n";
+    text += QString("%1 %2\n").arg("  Bytes written", -22).arg(formatSize(rawCaptureBytes.get()));
+    text += histogramToText("  Write", rawCaptureWriteTime, formatTime);
+    text += gaugeToText("  Backlog", rawCaptureBacklog);
+    return text;
+}
+
+QString Stats::dump() const
+{
+    // The runtime directory is private to the user, and O_NOFOLLOW refuses a symlink planted at
+    // the name in case it isn't
+    const auto directory = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation);
+    if (directory.isEmpty()) {
+        throw std::runtime_error("No runtime directory to write the stats to");
+    }
+    const auto filename = QDir(directory).filePath(QString("%1-%2-stats.json").arg(QCoreApplication::applicationName()).arg(getpid()));
+    const auto fd = ::open(QFile::encodeName(filename).constData(), O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        throw std::runtime_error(QString("Failed to open %1: %2").arg(filename, strerror(errno)).toStdString());
+    }
+    QFile file;
+    if (!file.open(fd, QIODevice::WriteOnly, QFileDevice::AutoCloseHandle)) {
+        ::close(fd);
+        throw std::runtime_error(QString("Failed to open %1: %2").arg(filename, file.errorString()).toStdString());
+    }
+    if (file.write(toJson()) < 0 || !file.flush()) {
+        throw std::runtime_error(QString("Failed to write %1: %2").arg(filename, file.errorString()).toStdString());
+    }
+    return filename;
+}
@@ -0,0 +1,130 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <QByteArray>
+#include <QString>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Hot path instrumentation. Everything is updated with relaxed atomics so that it can be done on
+// every read and every chunk, from whichever thread does the work, and read at any time by the
+// stats panel or a dump.
+class StatCounter {
+public:
+    void add(const uint64_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+    [[nodiscard]] uint64_t get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value {};
+};
+
+// The current value of something like a queue depth, and the highest it has been
+class StatGauge {
+public:
+    void set(const uint64_t newValue);
+    [[nodiscard]] uint64_t get() const { return value.load(std::memory_order_relaxed); }
+    [[nodiscard]] uint64_t max() const { return maxValue.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value {};
+    std::atomic<uint64_t> maxValue {};
+};
+
+// Histogram with power of two buckets: bucket i counts the values that are i bits wide
+class StatHistogram {
+public:
+    void record(const uint64_t value);
+
+    [[nodiscard]] uint64_t count() const { return total.load(std::memory_order_relaxed); }
+    [[nodiscard]] uint64_t sum() const { return sumValue.load(std::memory_order_relaxed); }
+    [[nodiscard]] uint64_t max() const { return maxValue.load(std::memory_order_relaxed); }
+    [[nodiscard]] uint64_t mean() const;
+    // Upper bound of the bucket that the `p`th percentile falls into
+    [[nodiscard]] uint64_t percentile(const double p) const;
+
+private:
+    std::array<std::atomic<uint64_t>, 65> buckets {};
+    std::atomic<uint64_t> total {};
+    std::atomic<uint64_t> sumValue {};
+    std::atomic<uint64_t> maxValue {};
+};
+
+// Records the nanoseconds from construction to destruction
+class StatTimer {
+public:
+    explicit StatTimer(StatHistogram& timeHistogram)
+        : histogram(timeHistogram)
+        , start(std::chrono::steady_clock::now())
+    {
+    }
+    ~StatTimer()
+    {
+        histogram.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()));
+    }
+    StatTimer(const StatTimer&) = delete;
+    StatTimer& operator=(const StatTimer&) = delete;
+
+private:
+    StatHistogram& histogram;
+    const std::chrono::steady_clock::time_point start;
+};
+
+// All statistics of the process. With several ports the counters and histograms add up over all
+// of them while a gauge shows whichever port updated it last. Times are in nanoseconds, sizes in
+// bytes.
+struct Stats {
+    // Serial reader thread
+    StatCounter bytesRead {};
+    StatCounter readyReadCalls {};
+    StatHistogram readSize {};
+    // Bytes waiting in the ring buffer when the consumer gets to them
+    StatGauge ringBufferDepth {};
+    // Bytes left in QSerialPort's read buffer while the ring buffer is full
+    StatGauge portBufferDepth {};
+    // From the kernel's counters, every one of these means lost or corrupted bytes
+    StatCounter overruns {};
+    StatCounter bufferOverruns {};
+    StatCounter framingErrors {};
+    StatCounter parityErrors {};
+
+    // Consumer, i.e. the GUI thread
+    StatHistogram chunkSize {};
+    StatHistogram frameTime {};
+    StatHistogram triggerScanTime {};
+    StatHistogram decodeTime {};
+    StatHistogram insertTextTime {};
+    // Bytes that weren't valid UTF-8, see Utf8Decoder
+    StatCounter invalidUtf8Bytes {};
+    // Bytes inserted into the document at once
+    StatGauge pendingBytes {};
+    // Switches between full, simple and no highlighting, see AdaptiveHighlighting
+    StatCounter highlightingChanges {};
+
+    // Archive writer thread
+    StatCounter compressedInput {};
+    StatCounter compressedOutput {};
+    StatHistogram compressTime {};
+    // Ending the frame, writing the seek table and the fsync when an archive is closed
+    StatHistogram rotationTime {};
+    StatGauge archiveBacklog {};
+
+    // Raw capture writer thread
+    StatCounter rawCaptureBytes {};
+    // Synchronous writes, or waiting for io_uring to finish one
+    StatHistogram rawCaptureWriteTime {};
+    StatGauge rawCaptureBacklog {};
+
+    [[nodiscard]] static Stats& instance();
+
+    [[nodiscard]] QByteArray toJson() const;
+    // Human readable, for the stats panel
+    [[nodiscard]] QString toText() const;
+    // Writes toJson() to a file in the user's runtime directory and returns its name. Throws
+    // std::runtime_error on failure.
+    QString dump() const;
+};
+
+#endif // STATS_H
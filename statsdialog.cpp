@@ -0,0 +1,53 @@
+#include "statsdialog.h"
+#include "stats.h"
+
+#include "ui_statsdialog.h"
+
+#include <QFontDatabase>
+#include <QTimer>
+
+#include <stdexcept>
+
+StatsDialog::StatsDialog(QWidget* parent)
+    : QDialog(parent)
+    , ui(new Ui::StatsDialog)
+    , refreshTimer(new QTimer(this))
+{
+    ui->setupUi(this);
+    ui->statsTextEdit->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+
+    connect(refreshTimer, &QTimer::timeout, this, &StatsDialog::refresh);
+    connect(ui->dumpButton, &QPushButton::clicked, this, &StatsDialog::onDumpButton);
+}
+
+StatsDialog::~StatsDialog()
+{
+    delete ui;
+}
+
+void StatsDialog::showEvent(QShowEvent* event)
+{
+    refresh();
+    refreshTimer->start(REFRESH_INTERVAL_MS);
+    QDialog::showEvent(event);
+}
+
+void StatsDialog::hideEvent(QHideEvent* event)
+{
+    refreshTimer->stop();
+    QDialog::hideEvent(event);
+}
+
+void StatsDialog::refresh()
+{
+    ui->statsTextEdit->setPlainText(Stats::instance().toText());
+}
+
+void StatsDialog::onDumpButton()
+{
+    try {
+        ui->msgLabel->setText(tr("Written to %1").arg(Stats::instance().dump()));
+    } catch (const std::runtime_error& e) {
+        ui->msgLabel->setText(e.what());
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef STATSDIALOG_H
+#define STATSDIALOG_H
+
+#include <QDialog>
+
+namespace Ui {
+class StatsDialog;
+}
+
+class QTimer;
+
+// Shows the hot path instrumentation from Stats, refreshed every REFRESH_INTERVAL_MS while the
+// dialog is visible
+class StatsDialog : public QDialog {
+    Q_OBJECT
+
+public:
+    explicit StatsDialog(QWidget* parent = nullptr);
+    ~StatsDialog();
+
+protected:
+    void showEvent(QShowEvent* event) override;
+    void hideEvent(QHideEvent* event) override;
+
+private slots:
+    void refresh();
+    void onDumpButton();
+
+private:
+    Ui::StatsDialog* ui;
+    QTimer* refreshTimer {};
+
+    static inline constexpr int REFRESH_INTERVAL_MS = 1000;
+};
+
+#endif // STATSDIALOG_H
@@ -0,0 +1,145 @@
+#include "triggerengine.h"
+
+#include <algorithm>
+#include <queue>
+
+void TriggerEngine::setTriggers(const std::vector<TriggerPattern>& triggers)
+{
+    std::vector<std::string> keywords;
+    std::vector<std::string> regexes;
+    std::vector<uint32_t> newKeywordTriggers;
+    std::vector<uint32_t> newRegexTriggers;
+
+    for (size_t i = 0; i < triggers.size(); i++) {
+        if (triggers[i].isRegex) {
+            regexes.push_back(triggers[i].pattern);
+            newRegexTriggers.push_back(static_cast<uint32_t>(i));
+        } else {
+            keywords.push_back(triggers[i].pattern);
+            newKeywordTriggers.push_back(static_cast<uint32_t>(i));
+        }
+    }
+
+    // Throws on invalid patterns, do it before touching anything else
+    regexMatcher.setPatterns(regexes);
+
+    keywordTriggers = std::move(newKeywordTriggers);
+    regexTriggers = std::move(newRegexTriggers);
+    buildKeywordDfa(keywords);
+
+    triggerCount = triggers.size();
+    matchCounts.assign(triggerCount, 0);
+    lastMatchOffsets.assign(triggerCount, UINT64_MAX);
+}
+
+void TriggerEngine::buildKeywordDfa(const std::vector<std::string>& keywords)
+{
+    state = 0;
+
+    std::fill(std::begin(byteClass), std::end(byteClass), 0);
+    classCount = 1;
+    for (const auto& keyword : keywords) {
+        for (const auto c : keyword) {
+            auto& cls = byteClass[static_cast<uint8_t>(c)];
+            if (!cls) {
+                cls = static_cast<uint8_t>(classCount++);
+            }
+        }
+    }
+
+    // Build the trie. -1 marks a missing edge, filled in below.
+    std::vector<std::vector<int64_t>> trie(1, std::vector<int64_t>(classCount, -1));
+    std::vector<std::vector<uint32_t>> stateOutputs(1);
+
+    for (size_t k = 0; k < keywords.size(); k++) {
+        if (keywords[k].empty()) {
+            continue;
+        }
+        size_t node = 0;
+        for (const auto c : keywords[k]) {
+            const auto cls = byteClass[static_cast<uint8_t>(c)];
+            if (trie[node][cls] < 0) {
+                trie[node][cls] = static_cast<int64_t>(trie.size());
+                trie.emplace_back(classCount, -1);
+                stateOutputs.emplace_back();
+            }
+            node = static_cast<size_t>(trie[node][cls]);
+        }
+        stateOutputs[node].push_back(static_cast<uint32_t>(k));
+    }
+
+    // Breadth first walk to compute failure links and turn the trie into a complete DFA
+    std::vector<size_t> fail(trie.size(), 0);
+    std::queue<size_t> queue;
+    for (uint32_t cls = 0; cls < classCount; cls++) {
+        if (trie[0][cls] < 0) {
+            trie[0][cls] = 0;
+        } else {
+            queue.push(static_cast<size_t>(trie[0][cls]));
+        }
+    }
+
+    while (!queue.empty()) {
+        const auto node = queue.front();
+        queue.pop();
+
+        const auto& inherited = stateOutputs[fail[node]];
+        stateOutputs[node].insert(stateOutputs[node].end(), inherited.begin(), inherited.end());
+
+        for (uint32_t cls = 0; cls < classCount; cls++) {
+            const auto next = trie[node][cls];
+            const auto failNext = trie[fail[node]][cls];
+            if (next < 0) {
+                trie[node][cls] = failNext;
+            } else {
+                fail[static_cast<size_t>(next)] = static_cast<size_t>(failNext);
+                queue.push(static_cast<size_t>(next));
+            }
+        }
+    }
+
+    transitions.resize(trie.size() * classCount);
+    outputOffsets.resize(trie.size() + 1);
+    outputs.clear();
+
+    for (size_t node = 0; node < trie.size(); node++) {
+        outputOffsets[node] = static_cast<uint32_t>(outputs.size());
+        outputs.insert(outputs.end(), stateOutputs[node].begin(), stateOutputs[node].end());
+
+        for (uint32_t cls = 0; cls < classCount; cls++) {
+            const auto next = static_cast<size_t>(trie[node][cls]);
+            auto value = static_cast<uint32_t>(next);
+            if (!stateOutputs[next].empty()) {
+                value |= OUTPUT_FLAG;
+            }
+            transitions[node * classCount + cls] = value;
+        }
+    }
+    outputOffsets[trie.size()] = static_cast<uint32_t>(outputs.size());
+}
+
+void TriggerEngine::resetCounts()
+{
+    std::fill(matchCounts.begin(), matchCounts.end(), 0);
+    std::fill(lastMatchOffsets.begin(), lastMatchOffsets.end(), UINT64_MAX);
+}
+
+void TriggerEngine::countMatch(const uint32_t trigger, const std::vector<uint32_t>& newlines, const size_t pos)
+{
+    // Matches are rare, so finding the start of the current line is done only here instead of
+    // tracking newlines in the hot loop. A match that ends on a newline belongs to the line
+    // it terminates.
+    auto lineStart = lineStartOffset;
+    const auto it = std::lower_bound(newlines.begin(), newlines.end(), static_cast<uint32_t>(pos));
+    if (it != newlines.begin()) {
+        lineStart = streamOffset + *std::prev(it) + 1;
+    }
+
+    auto& lastMatch = lastMatchOffsets[trigger];
+    if (lastMatch != UINT64_MAX && lastMatch >= lineStart) {
+        return;
+    }
+    lastMatch = streamOffset + pos;
+    matchCounts[trigger]++;
+    matchedTriggers.push_back(trigger);
+}
@@ -0,0 +1,118 @@
+#ifndef TRIGGERENGINE_H
+#define TRIGGERENGINE_H
+
+#include "regexmatcher.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct TriggerPattern {
+    std::string pattern {};
+    bool isRegex {};
+};
+
+// Multi trigger matcher. Literal keywords are matched with Aho-Corasick: they are all compiled
+// into a single DFA, so every byte of input costs one table lookup no matter how many keywords
+// are being watched. Regular expressions are handed to RegexMatcher which is linear time as well.
+// The state is carried across calls to `scan()`, so triggers split across chunk boundaries are
+// matched too. Like the original single keyword trigger, a trigger is counted at most once per
+// line.
+class TriggerEngine {
+public:
+    // Throws std::invalid_argument if one of the regular expressions is invalid
+    void setTriggers(const std::vector<TriggerPattern>& triggers);
+
+    [[nodiscard]] bool isEmpty() const { return triggerCount == 0; }
+    [[nodiscard]] size_t size() const { return triggerCount; }
+    [[nodiscard]] uint64_t matchCount(const size_t trigger) const { return matchCounts[trigger]; }
+    void resetCounts();
+
+    // Scans a chunk in place. `newlines` is the chunk's newline index from LineFramer.
+    // `onMatch(triggerIndex)` is called for every new match.
+    template <typename F>
+    void scan(const char* data, const size_t len, const std::vector<uint32_t>& newlines, F&& onMatch);
+
+private:
+    static inline constexpr uint32_t OUTPUT_FLAG = 1u << 31;
+    static inline constexpr uint32_t STATE_MASK = ~OUTPUT_FLAG;
+
+    // Bytes which do not occur in any of the keywords share class 0
+    uint8_t byteClass[256] {};
+    uint32_t classCount {};
+
+    // transitions[state * classCount + class]. The OUTPUT_FLAG bit is set if the next state
+    // completes at least one keyword.
+    std::vector<uint32_t> transitions {};
+
+    // Keywords completed in each state, including the ones reached through suffix links
+    std::vector<uint32_t> outputOffsets {};
+    std::vector<uint32_t> outputs {};
+
+    // Maps keyword and regex indices to trigger indices
+    std::vector<uint32_t> keywordTriggers {};
+    std::vector<uint32_t> regexTriggers {};
+    RegexMatcher regexMatcher {};
+
+    size_t triggerCount {};
+    std::vector<uint64_t> matchCounts {};
+    // Stream offset of the last counted match of each trigger, used to count once per line
+    std::vector<uint64_t> lastMatchOffsets {};
+
+    uint32_t state {};
+    uint64_t streamOffset {};
+    // Stream offset of the first byte of the current line
+    uint64_t lineStartOffset {};
+
+    // Triggers matched in the chunk currently being scanned
+    std::vector<uint32_t> matchedTriggers {};
+
+    void buildKeywordDfa(const std::vector<std::string>& keywords);
+    void countMatch(const uint32_t trigger, const std::vector<uint32_t>& newlines, const size_t pos);
+};
+
+template <typename F>
+void TriggerEngine::scan(const char* data, const size_t len, const std::vector<uint32_t>& newlines, F&& onMatch)
+{
+    if (isEmpty() || !len) {
+        streamOffset += len;
+        return;
+    }
+
+    matchedTriggers.clear();
+
+    if (!keywordTriggers.empty()) {
+        const auto* bytes = reinterpret_cast<const uint8_t*>(data);
+        const auto* table = transitions.data();
+        const auto classes = classCount;
+        auto s = state;
+
+        for (size_t i = 0; i < len; i++) {
+            s = table[(s & STATE_MASK) * classes + byteClass[bytes[i]]];
+            if (s & OUTPUT_FLAG) [[unlikely]] {
+                const auto matchState = s & STATE_MASK;
+                for (auto o = outputOffsets[matchState]; o < outputOffsets[matchState + 1]; o++) {
+                    countMatch(keywordTriggers[outputs[o]], newlines, i);
+                }
+            }
+        }
+        state = s & STATE_MASK;
+    }
+
+    if (!regexMatcher.isEmpty()) {
+        regexMatcher.scan(data, len, [&](const size_t regex, const size_t pos) {
+            countMatch(regexTriggers[regex], newlines, pos);
+        });
+    }
+
+    if (!newlines.empty()) {
+        lineStartOffset = streamOffset + newlines.back() + 1;
+    }
+    streamOffset += len;
+
+    for (const auto trigger : matchedTriggers) {
+        onMatch(trigger);
+    }
+}
+
+#endif // TRIGGERENGINE_H
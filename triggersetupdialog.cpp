@@ -1,11 +1,27 @@
 #include "triggersetupdialog.h"
 #include "ui_triggersetupdialog.h"
 
+#include <QApplication>
+#include <QPushButton>
+
 TriggerSetupDialog::TriggerSetupDialog(QWidget* parent)
     : QDialog(parent)
     , ui(new Ui::TriggerSetupDialog)
 {
     ui->setupUi(this);
+
+    ui->keywordTable->horizontalHeader()->setSectionResizeMode(KeywordColumn, QHeaderView::Stretch);
+    ui->keywordTable->horizontalHeader()->setSectionResizeMode(RegexColumn, QHeaderView::ResizeToContents);
+    ui->keywordTable->horizontalHeader()->setSectionResizeMode(SoundColumn, QHeaderView::ResizeToContents);
+
+    connect(ui->addButton, &QPushButton::pressed, this, &TriggerSetupDialog::onAddButton);
+    // Enter in the keyword field adds the keyword rather than accepting the dialog
+    connect(qApp, &QApplication::focusChanged, this, [this](QWidget*, QWidget* now) {
+        const auto editing = now == ui->lineEdit;
+        ui->buttonBox->button(QDialogButtonBox::Ok)->setDefault(!editing);
+        ui->addButton->setDefault(editing);
+    });
+    connect(ui->removeButton, &QPushButton::pressed, this, &TriggerSetupDialog::onRemoveButton);
 }
 
 TriggerSetupDialog::~TriggerSetupDialog()
@@ -13,7 +29,50 @@ TriggerSetupDialog::~TriggerSetupDialog()
     delete ui;
 }
 
-const QString TriggerSetupDialog::getKeyword() const
+void TriggerSetupDialog::onAddButton()
+{
+    const auto keyword = ui->lineEdit->text();
+    if (keyword.isEmpty()) {
+        return;
+    }
+
+    const auto row = ui->keywordTable->rowCount();
+    ui->keywordTable->insertRow(row);
+
+    ui->keywordTable->setItem(row, KeywordColumn, new QTableWidgetItem(keyword));
+
+    auto regexItem = new QTableWidgetItem();
+    regexItem->setFlags(Qt::ItemIsEnabled | Qt::ItemIsUserCheckable);
+    regexItem->setCheckState(ui->regexCheckBox->isChecked() ? Qt::Checked : Qt::Unchecked);
+    ui->keywordTable->setItem(row, RegexColumn, regexItem);
+
+    auto soundItem = new QTableWidgetItem();
+    soundItem->setFlags(Qt::ItemIsEnabled | Qt::ItemIsUserCheckable);
+    soundItem->setCheckState(Qt::Checked);
+    ui->keywordTable->setItem(row, SoundColumn, soundItem);
+
+    ui->lineEdit->clear();
+}
+
+void TriggerSetupDialog::onRemoveButton()
+{
+    const auto row = ui->keywordTable->currentRow();
+    if (row >= 0) {
+        ui->keywordTable->removeRow(row);
+    }
+}
+
+QList<TriggerKeyword> TriggerSetupDialog::getKeywords() const
 {
-    return ui->lineEdit->text();
+    QList<TriggerKeyword> keywords;
+    for (int row = 0; row < ui->keywordTable->rowCount(); row++) {
+        const auto keyword = ui->keywordTable->item(row, KeywordColumn)->text();
+        if (keyword.isEmpty()) {
+            continue;
+        }
+        keywords.append({ keyword,
+            ui->keywordTable->item(row, RegexColumn)->checkState() == Qt::Checked,
+            ui->keywordTable->item(row, SoundColumn)->checkState() == Qt::Checked });
+    }
+    return keywords;
 }
@@ -7,6 +7,12 @@ namespace Ui {
 class TriggerSetupDialog;
 }
 
+struct TriggerKeyword {
+    QString keyword {};
+    bool isRegex {};
+    bool playSound {};
+};
+
 class TriggerSetupDialog : public QDialog {
     Q_OBJECT
 
@@ -14,10 +20,20 @@ public:
     explicit TriggerSetupDialog(QWidget* parent = nullptr);
     ~TriggerSetupDialog();
 
-    const QString getKeyword() const;
+    QList<TriggerKeyword> getKeywords() const;
+
+private slots:
+    void onAddButton();
+    void onRemoveButton();
 
 private:
     Ui::TriggerSetupDialog* ui {};
+
+    enum Column {
+        KeywordColumn,
+        RegexColumn,
+        SoundColumn
+    };
 };
 
 #endif // TRIGGERSETUPDIALOG_H
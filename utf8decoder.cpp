@@ -0,0 +1,249 @@
+#include "utf8decoder.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define UTF8DECODER_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+constexpr size_t INVALID = 0;
+// A valid start of a sequence that is cut off by the end of the input
+constexpr size_t INCOMPLETE = 5;
+
+struct Sequence {
+    size_t length {};
+    uint32_t codePoint {};
+};
+
+// Decodes the multibyte sequence at the start of `in`. Only the shortest form of a code point
+// is valid and surrogates and anything above U+10FFFF are rejected, which is all decided by the
+// lead byte and the range of the second byte.
+Sequence decodeSequence(const uint8_t* in, const size_t len)
+{
+    const auto lead = in[0];
+    size_t length {};
+    uint32_t codePoint {};
+    uint8_t secondMin = 0x80;
+    uint8_t secondMax = 0xbf;
+
+    if (lead >= 0xc2 && lead <= 0xdf) {
+        length = 2;
+        codePoint = lead & 0x1fu;
+    } else if (lead >= 0xe0 && lead <= 0xef) {
+        length = 3;
+        codePoint = lead & 0x0fu;
+        if (lead == 0xe0) {
+            secondMin = 0xa0;
+        } else if (lead == 0xed) {
+            secondMax = 0x9f;
+        }
+    } else if (lead >= 0xf0 && lead <= 0xf4) {
+        length = 4;
+        codePoint = lead & 0x07u;
+        if (lead == 0xf0) {
+            secondMin = 0x90;
+        } else if (lead == 0xf4) {
+            secondMax = 0x8f;
+        }
+    } else {
+        return { INVALID, 0 };
+    }
+
+    for (size_t i = 1; i < length; i++) {
+        if (i == len) {
+            return { INCOMPLETE, 0 };
+        }
+        const auto byte = in[i];
+        const auto low = i == 1 ? secondMin : uint8_t { 0x80 };
+        const auto high = i == 1 ? secondMax : uint8_t { 0xbf };
+        if (byte < low || byte > high) {
+            return { INVALID, 0 };
+        }
+        codePoint = (codePoint << 6) | (byte & 0x3fu);
+    }
+    return { length, codePoint };
+}
+
+size_t widenAsciiScalar(const uint8_t* in, const size_t len, char16_t* out)
+{
+    size_t i = 0;
+    for (; i < len && in[i] < 0x80; i++) {
+        out[i] = static_cast<char16_t>(in[i]);
+    }
+    return i;
+}
+
+#ifdef UTF8DECODER_X86
+
+__attribute__((target("sse2"))) size_t widenAsciiSse2(const uint8_t* in, const size_t len, char16_t* out)
+{
+    const auto zero = _mm_setzero_si128();
+
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        // The top bit is only set in bytes that aren't ASCII
+        if (const auto mask = static_cast<uint32_t>(_mm_movemask_epi8(v))) {
+            return i + widenAsciiScalar(in + i, static_cast<size_t>(__builtin_ctz(mask)), out + i);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_unpacklo_epi8(v, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 8), _mm_unpackhi_epi8(v, zero));
+    }
+    return i + widenAsciiScalar(in + i, len - i, out + i);
+}
+
+__attribute__((target("avx2"))) size_t widenAsciiAvx2(const uint8_t* in, const size_t len, char16_t* out)
+{
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        const auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        if (const auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(v))) {
+            return i + widenAsciiScalar(in + i, static_cast<size_t>(__builtin_ctz(mask)), out + i);
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_cvtepu8_epi16(_mm256_castsi256_si128(v)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i + 16), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(v, 1)));
+    }
+    return i + widenAsciiSse2(in + i, len - i, out + i);
+}
+
+#endif
+
+}
+
+Utf8Decoder::Utf8Decoder()
+    : asciiFunc(widenAsciiScalar)
+{
+#ifdef UTF8DECODER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        asciiFunc = widenAsciiAvx2;
+    } else if (__builtin_cpu_supports("sse2")) {
+        asciiFunc = widenAsciiSse2;
+    }
+#endif
+}
+
+const QString& Utf8Decoder::decode(const char* data, const size_t len)
+{
+    const auto* in = reinterpret_cast<const uint8_t*>(data);
+    lastSizeDifference = 0;
+    lastInvalidBytes = 0;
+
+    // Every byte is at most one UTF-16 unit, a four byte sequence is two. Hex escapes are four.
+    const size_t unitsPerByte = policy == InvalidPolicy::HexEscape ? 4 : 1;
+    // Shrinking keeps the capacity, so this only allocates when the chunks get larger
+    text.resize(static_cast<qsizetype>((carryLength + len) * unitsPerByte));
+    auto* out = reinterpret_cast<char16_t*>(text.data());
+    size_t written {};
+    size_t offset {};
+
+    // The sequence held back from the last call is finished first, with just enough of the new
+    // bytes to complete it
+    if (carryLength) {
+        std::array<uint8_t, 8> joined {};
+        std::copy_n(carry.begin(), carryLength, joined.begin());
+        const auto take = std::min<size_t>(len, carry.size());
+        std::copy_n(in, take, joined.begin() + static_cast<std::ptrdiff_t>(carryLength));
+        const auto joinedLength = carryLength + take;
+
+        size_t consumed {};
+        written += decodeBytes(joined.data(), joinedLength, out, consumed);
+        if (consumed >= carryLength) {
+            offset = consumed - carryLength;
+            carryLength = 0;
+        } else {
+            // Still not complete, which means that all of the new bytes were used up
+            std::copy(joined.begin() + static_cast<std::ptrdiff_t>(consumed), joined.begin() + static_cast<std::ptrdiff_t>(joinedLength), carry.begin());
+            carryLength = joinedLength - consumed;
+            offset = len;
+        }
+    }
+
+    if (offset < len) {
+        size_t consumed {};
+        written += decodeBytes(in + offset, len - offset, out + written, consumed);
+        offset += consumed;
+        std::copy(in + offset, in + len, carry.begin());
+        carryLength = len - offset;
+    }
+
+    text.resize(static_cast<qsizetype>(written));
+    return text;
+}
+
+size_t Utf8Decoder::decodeBytes(const uint8_t* in, const size_t len, char16_t* out, size_t& consumed)
+{
+    size_t i {};
+    size_t written {};
+    while (i < len) {
+        const auto ascii = asciiFunc(in + i, len - i, out + written);
+        i += ascii;
+        written += ascii;
+        if (i == len) {
+            break;
+        }
+
+        const auto sequence = decodeSequence(in + i, len - i);
+        if (sequence.length == INCOMPLETE) {
+            break;
+        }
+        if (sequence.length == INVALID) {
+            written += writeInvalid(in[i], out + written);
+            i++;
+            continue;
+        }
+
+        if (sequence.codePoint >= 0x10000) {
+            out[written++] = static_cast<char16_t>(0xd800 + ((sequence.codePoint - 0x10000) >> 10));
+            out[written++] = static_cast<char16_t>(0xdc00 + ((sequence.codePoint - 0x10000) & 0x3ff));
+        } else {
+            out[written++] = static_cast<char16_t>(sequence.codePoint);
+        }
+        i += sequence.length;
+    }
+    consumed = i;
+    return written;
+}
+
+size_t Utf8Decoder::writeInvalid(const uint8_t byte, char16_t* out)
+{
+    static constexpr char HEX_DIGITS[] = "0123456789abcdef";
+
+    lastInvalidBytes++;
+    // The differences are the UTF-8 size of the replacement minus the one byte it replaces
+    switch (policy) {
+    case InvalidPolicy::Replace:
+        out[0] = u'\ufffd';
+        lastSizeDifference += 2;
+        return 1;
+    case InvalidPolicy::HexEscape:
+        out[0] = u'\\';
+        out[1] = u'x';
+        out[2] = static_cast<char16_t>(HEX_DIGITS[byte >> 4]);
+        out[3] = static_cast<char16_t>(HEX_DIGITS[byte & 0xf]);
+        lastSizeDifference += 3;
+        return 4;
+    case InvalidPolicy::Latin1:
+    default:
+        // Invalid bytes are never ASCII, so they are two bytes in UTF-8
+        out[0] = static_cast<char16_t>(byte);
+        lastSizeDifference += 1;
+        return 1;
+    }
+}
+
+const char* Utf8Decoder::implementation() const
+{
+#ifdef UTF8DECODER_X86
+    if (asciiFunc == widenAsciiAvx2) {
+        return "avx2";
+    }
+    if (asciiFunc == widenAsciiSse2) {
+        return "sse2";
+    }
+#endif
+    return "scalar";
+}
@@ -0,0 +1,70 @@
+#ifndef UTF8DECODER_H
+#define UTF8DECODER_H
+
+#include <QString>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Turns the received bytes into text for the document. Unlike QString::fromUtf8() on every chunk
+// it keeps an incomplete sequence at the end of a chunk and finishes it with the next one, so that
+// a character split between two reads isn't shown as two replacement characters. The text is
+// decoded into the same buffer every time, which doesn't allocate once it has grown to the
+// largest chunk.
+//
+// Runs of ASCII, which is most of what serial devices send, are validated and widened with AVX2
+// or SSE2 when available. Everything else goes through a scalar decoder that rejects overlong
+// forms, surrogates and code points above U+10FFFF. Every byte that isn't part of a valid
+// sequence is handled according to the InvalidPolicy.
+class Utf8Decoder {
+public:
+    enum class InvalidPolicy {
+        // U+FFFD, like QString::fromUtf8()
+        Replace,
+        // "\xNN", so that binary data can be read back
+        HexEscape,
+        // The byte as a Latin-1 character, for devices that don't send UTF-8 at all
+        Latin1
+    };
+
+    Utf8Decoder();
+
+    void setPolicy(const InvalidPolicy newPolicy) { policy = newPolicy; }
+    [[nodiscard]] InvalidPolicy invalidPolicy() const { return policy; }
+
+    // Decodes `len` bytes following whatever was left over from the previous call. The text stays
+    // valid until the next call.
+    const QString& decode(const char* data, const size_t len);
+    // Drops the incomplete sequence that is being held back
+    void reset() { carryLength = 0; }
+
+    // Bytes of an incomplete sequence that is held back for the next call
+    [[nodiscard]] size_t pendingBytes() const { return carryLength; }
+    // How much larger the text of the last call is in UTF-8 than the bytes it was decoded from.
+    // Only invalid bytes make a difference, each takes the size of what it was replaced with.
+    [[nodiscard]] qint64 sizeDifference() const { return lastSizeDifference; }
+    // Bytes of the last call that weren't part of a valid sequence
+    [[nodiscard]] size_t invalidBytes() const { return lastInvalidBytes; }
+
+    [[nodiscard]] const char* implementation() const;
+
+private:
+    // Widens the ASCII bytes at the start of `in`, returns how many there were
+    using AsciiFunc = size_t (*)(const uint8_t* in, const size_t len, char16_t* out);
+
+    AsciiFunc asciiFunc {};
+    InvalidPolicy policy = InvalidPolicy::Replace;
+    QString text {};
+    // A sequence is at most four bytes, so at most three are ever held back
+    std::array<uint8_t, 4> carry {};
+    size_t carryLength {};
+    qint64 lastSizeDifference {};
+    size_t lastInvalidBytes {};
+
+    // Returns the number of UTF-16 units written
+    size_t decodeBytes(const uint8_t* in, const size_t len, char16_t* out, size_t& consumed);
+    size_t writeInvalid(const uint8_t byte, char16_t* out);
+};
+
+#endif // UTF8DECODER_H